@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <chrono>
+
+#include "AnimationSystem.h"
+#include "AssimpMesh.h"
+#include "ThreadPool.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static float elapsedMs( const Clock::time_point& start, const Clock::time_point& end )
+{
+    return std::chrono::duration<float, std::milli>( end - start ).count();
+}
+
+// static class instance
+AnimationSystem AnimationSystem::sInstance;
+AnimationSystem::AnimationSystem() :
+    mViewerPos( 0.0f ),
+    mFrame( 0 ),
+    mNextPhase( 0 )
+{
+    mTimings.poseMs = 0.0f;
+    mTimings.mapMs = 0.0f;
+    mTimings.skinMs = 0.0f;
+    mTimings.uploadMs = 0.0f;
+    mTimings.numPosed = 0;
+    mTimings.numSkinnedVerts = 0;
+    mTimings.numSkippedLod = 0;
+    mTimings.numSkippedBudget = 0;
+    mTimings.numSkippedHidden = 0;
+
+    mLodSettings.distances[0] = 10.0f;
+    mLodSettings.distances[1] = 25.0f;
+    mLodSettings.distances[2] = 50.0f;
+    mLodSettings.skipLeafBonesLod = NUM_LODS - 1;
+    mLodSettings.maxUpdatesPerFrame = 0;
+}
+
+void AnimationSystem::Add( AssimpMesh* mesh )
+{
+    for ( const Instance& inst : mInstances ) {
+        if ( inst.mesh == mesh ) { return; }
+    }
+    Instance inst;
+    inst.mesh = mesh;
+    inst.pendingDt = 0.0f;
+    // past every LOD's period, so it's posed on the next Update
+    inst.framesSinceUpdate = 1u << NUM_LODS;
+    inst.phase = mNextPhase++;
+    inst.lod = 0;
+    mInstances.push_back( inst );
+}
+
+void AnimationSystem::Remove( AssimpMesh* mesh )
+{
+    for ( size_t i=0; i<mInstances.size(); ++i ) {
+        if ( mInstances[i].mesh == mesh ) {
+            // update order doesn't matter
+            mInstances[i] = mInstances.back();
+            mInstances.pop_back();
+            return;
+        }
+    }
+}
+
+size_t AnimationSystem::CullInstances( const Frustum& frustum, const OcclusionCuller* occlusion )
+{
+    mCullSpheres.resize( mInstances.size() );
+    mCullVisible.resize( mInstances.size() );
+    for ( size_t i=0; i<mInstances.size(); ++i ) {
+        const BoundingSphere sphere = mInstances[i].mesh->GetWorldBoundingSphere();
+        mCullSpheres[i] = glm::vec4( sphere.center, sphere.radius );
+    }
+    size_t numVisible = frustum.CullSpheres( mCullSpheres.data(), mCullSpheres.size(), mCullVisible.data() );
+
+    if ( occlusion != nullptr ) {
+        mOcclusionBoxes.clear();
+        mOcclusionInstances.clear();
+        for ( size_t i=0; i<mInstances.size(); ++i ) {
+            if ( !mCullVisible[i] ) { continue; }
+            mOcclusionBoxes.push_back( mInstances[i].mesh->GetWorldBounds() );
+            mOcclusionInstances.push_back( uint32_t( i ));
+        }
+        mOcclusionVisible.resize( mOcclusionBoxes.size() );
+        numVisible = occlusion->CullBoxes( mOcclusionBoxes.data(), mOcclusionBoxes.size(), mOcclusionVisible.data() );
+        for ( size_t i=0; i<mOcclusionInstances.size(); ++i ) {
+            mCullVisible[mOcclusionInstances[i]] = mOcclusionVisible[i];
+        }
+    }
+
+    for ( size_t i=0; i<mInstances.size(); ++i ) {
+        mInstances[i].mesh->SetVisible( mCullVisible[i] != 0 );
+    }
+    return numVisible;
+}
+
+void AnimationSystem::Update( const float dt )
+{
+    ThreadPool& pool = *ThreadPool::GetInstance();
+    const Clock::time_point poseStart = Clock::now();
+
+    // pick the instances due this frame
+    ++mFrame;
+    mDue.clear();
+    size_t numSkippedLod = 0;
+    size_t numSkippedHidden = 0;
+    for ( size_t i=0; i<mInstances.size(); ++i )
+    {
+        Instance& inst = mInstances[i];
+        inst.pendingDt += dt;
+        ++inst.framesSinceUpdate;
+
+        // hidden; only the clock runs. Still counts frames, so it's due
+        // as soon as it's visible again
+        if ( !inst.mesh->IsVisible() ) {
+            inst.mesh->advanceTime( inst.pendingDt );
+            inst.pendingDt = 0.0f;
+            ++numSkippedHidden;
+            continue;
+        }
+
+        const float dist = glm::length( inst.mesh->GetPosition() - mViewerPos );
+        inst.lod = 0;
+        while ( inst.lod < NUM_LODS - 1 && dist >= mLodSettings.distances[inst.lod] ) {
+            ++inst.lod;
+        }
+
+        // due on its own frame of the period, or if the budget made it
+        // miss that frame
+        const uint32_t period = 1u << inst.lod;
+        if ( (mFrame + inst.phase) % period == 0 || inst.framesSinceUpdate > period ) {
+            mDue.push_back( uint32_t( i ) );
+        } else {
+            ++numSkippedLod;
+        }
+    }
+
+    // over budget; the most overdue relative to their rate go first, so
+    // far instances can't be starved by near ones
+    size_t numSkippedBudget = 0;
+    const size_t maxUpdates = mLodSettings.maxUpdatesPerFrame;
+    if ( maxUpdates > 0 && mDue.size() > maxUpdates ) {
+        std::nth_element(
+            mDue.begin(),
+            mDue.begin() + maxUpdates,
+            mDue.end(),
+            [this]( uint32_t a, uint32_t b ) {
+                const Instance& instA = mInstances[a];
+                const Instance& instB = mInstances[b];
+                // framesSinceUpdate / period, cross multiplied
+                return (uint64_t(instA.framesSinceUpdate) << instB.lod) >
+                       (uint64_t(instB.framesSinceUpdate) << instA.lod);
+            }
+        );
+        numSkippedBudget = mDue.size() - maxUpdates;
+        mDue.resize( maxUpdates );
+    }
+
+    // Pose phase; instances differ a lot in cost (bones, clips, sub
+    // meshes), so hand them out one at a time
+    mPosed.resize( mDue.size() );
+    pool.ParallelForDynamic(
+        mDue.size(),
+        1,
+        [this]( size_t begin, size_t end ) {
+            for ( size_t i=begin; i<end; ++i ) {
+                Instance& inst = mInstances[mDue[i]];
+                const bool skipLeafBones = inst.lod >= mLodSettings.skipLeafBonesLod;
+                inst.mesh->advanceTime( inst.pendingDt );
+                mPosed[i] = inst.mesh->updatePose( skipLeafBones ) ? 1 : 0;
+                inst.pendingDt = 0.0f;
+                inst.framesSinceUpdate = 0;
+            }
+        }
+    );
+    const Clock::time_point mapStart = Clock::now();
+
+    // Map phase; may wait on fences so it stays on the GL thread. Every
+    // mesh is split into chunks so the skin phase balances across all
+    // instances instead of one mesh at a time
+    mSkinTargets.clear();
+    mSkinChunks.clear();
+    size_t numPosed = 0;
+    size_t numSkinnedVerts = 0;
+    for ( size_t i=0; i<mDue.size(); ++i )
+    {
+        if ( !mPosed[i] ) { continue; }
+        ++numPosed;
+
+        AssimpMesh& mesh = *mInstances[mDue[i]].mesh;
+        const std::vector<AssimpMesh::Mesh>& meshes = mesh.mAsset->GetMeshes();
+        for ( size_t mshIdx=0; mshIdx<meshes.size(); ++mshIdx )
+        {
+            if ( !mesh.needsCpuSkinning( mshIdx ) ) { continue; }
+            glm::vec3* positions = static_cast<glm::vec3*>(
+                mesh.mSkinnedVertBufs[mshIdx]->BeginStreamWrite( VertexBuffer::STREAM_POSITION )
+            );
+            if ( positions == nullptr ) { continue; }
+
+            const SkinTarget target = { &mesh, mshIdx, positions };
+            const uint32_t targetIdx = (uint32_t)mSkinTargets.size();
+            mSkinTargets.push_back( target );
+
+            const size_t numVerts = meshes[mshIdx].GetVertices().size();
+            for ( size_t begin=0; begin<numVerts; begin+=SKIN_CHUNK_SIZE ) {
+                const SkinChunk chunk = {
+                    targetIdx,
+                    (uint32_t)begin,
+                    (uint32_t)std::min( begin + SKIN_CHUNK_SIZE, numVerts )
+                };
+                mSkinChunks.push_back( chunk );
+            }
+            numSkinnedVerts += numVerts;
+        }
+    }
+    const Clock::time_point skinStart = Clock::now();
+
+    // Skin phase
+    pool.ParallelForDynamic(
+        mSkinChunks.size(),
+        1,
+        [this]( size_t begin, size_t end ) {
+            for ( size_t i=begin; i<end; ++i ) {
+                const SkinChunk& chunk = mSkinChunks[i];
+                const SkinTarget& target = mSkinTargets[chunk.target];
+                target.mesh->skinVertices( target.mshIdx, target.positions, chunk.begin, chunk.end );
+            }
+        }
+    );
+    const Clock::time_point uploadStart = Clock::now();
+
+    // Upload phase; every stream is complete, release them all to GL
+    for ( const SkinTarget& target : mSkinTargets ) {
+        target.mesh->mSkinnedVertBufs[target.mshIdx]->EndStreamWrite( VertexBuffer::STREAM_POSITION );
+        target.mesh->mSkinValid = true;
+    }
+    const Clock::time_point uploadEnd = Clock::now();
+
+    mTimings.poseMs = elapsedMs( poseStart, mapStart );
+    mTimings.mapMs = elapsedMs( mapStart, skinStart );
+    mTimings.skinMs = elapsedMs( skinStart, uploadStart );
+    mTimings.uploadMs = elapsedMs( uploadStart, uploadEnd );
+    mTimings.numPosed = numPosed;
+    mTimings.numSkinnedVerts = numSkinnedVerts;
+    mTimings.numSkippedLod = numSkippedLod;
+    mTimings.numSkippedBudget = numSkippedBudget;
+    mTimings.numSkippedHidden = numSkippedHidden;
+}
@@ -0,0 +1,130 @@
+#ifndef ANIMATION_SYSTEM_H_INCLUDED
+#define ANIMATION_SYSTEM_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+#include "OcclusionCuller.h"
+
+class AssimpMesh;
+
+/* Updates every registered AssimpMesh once per frame, Singleton Class.
+ * Instead of each instance posing and skinning itself in turn, the work
+ * of all instances is done in phases:
+ *  pose:   sample animations and build palettes, one job per instance
+ *  map:    map every skinned position stream (GL thread)
+ *  skin:   skin vertex chunks of every instance together
+ *  upload: release the streams to GL (GL thread)
+ * The pose and skin phases are spread across the ThreadPool.
+ * Distant instances update at a lower rate (see LodSettings), and hidden
+ * ones (AssimpMesh::SetVisible) only advance their clock */
+class AnimationSystem
+{
+public:
+
+    static AnimationSystem* GetInstance() { return &sInstance; }
+
+    // Registered instances are updated by Update instead of their own
+    // AssimpMesh::Update. Instances remove themselves when destroyed
+    void Add( AssimpMesh* mesh );
+    void Remove( AssimpMesh* mesh );
+    size_t GetNumInstances() const { return mInstances.size(); }
+
+    // Set the visibility of every registered instance from its bounds,
+    // tested in one batch, then against the occluders if given. Call
+    // before Update so hidden instances skip their pose. Returns the
+    // number visible
+    size_t CullInstances( const Frustum& frustum, const OcclusionCuller* occlusion = nullptr );
+
+    // Advance and skin the registered instances due this frame; call
+    // from the GL thread
+    void Update( const float dt );
+
+    // Update rate LODs: full, 1/2, 1/4 and 1/8 rate
+    static const size_t NUM_LODS = 4;
+    // Instances at LOD n update every 2^n frames and catch up on the time
+    // they skipped. Updates of one rate are staggered so each frame does
+    // about the same share of them
+    struct LodSettings
+    {
+        float distances[NUM_LODS - 1]; // viewer distance where LOD 1,2,3 start; ascending
+        size_t skipLeafBonesLod; // from this LOD on leaf bones stay at their bind pose
+        size_t maxUpdatesPerFrame; // instance updates per frame, most overdue first; 0 = no limit
+    };
+    void SetLodSettings( const LodSettings& settings ) { mLodSettings = settings; }
+    const LodSettings& GetLodSettings() const { return mLodSettings; }
+    // LOD distances are measured from here
+    void SetViewerPosition( const glm::vec3& pos ) { mViewerPos = pos; }
+
+    struct Timings
+    {
+        float poseMs;
+        float mapMs;
+        float skinMs;
+        float uploadMs;
+        size_t numPosed; // instances with an animation playing
+        size_t numSkinnedVerts; // vertices skinned on the CPU
+        size_t numSkippedLod; // instances not due at their LOD's rate
+        size_t numSkippedBudget; // due instances deferred by maxUpdatesPerFrame
+        size_t numSkippedHidden; // instances not visible; only their clock advanced
+    };
+    // timings of the most recent Update
+    const Timings& GetTimings() const { return mTimings; }
+
+private:
+
+    // min number of vertices skinned per worker thread job
+    static const size_t SKIN_CHUNK_SIZE = 2048;
+
+    struct Instance
+    {
+        AssimpMesh* mesh;
+        float pendingDt; // time since its last update
+        uint32_t framesSinceUpdate;
+        uint32_t phase; // staggers instances of the same rate across frames
+        uint32_t lod;
+    };
+
+    // one CPU skinned mesh of an instance, mapped for this frame
+    struct SkinTarget
+    {
+        AssimpMesh* mesh;
+        size_t mshIdx;
+        glm::vec3* positions;
+    };
+    // vertices [begin,end) of a SkinTarget
+    struct SkinChunk
+    {
+        uint32_t target;
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    std::vector<Instance> mInstances;
+    std::vector<uint32_t> mDue; // instances updated this frame
+    std::vector<uint8_t> mPosed; // per mDue entry, set by the pose phase
+    std::vector<SkinTarget> mSkinTargets;
+    std::vector<SkinChunk> mSkinChunks;
+    std::vector<glm::vec4> mCullSpheres; // per instance, world space bounds
+    std::vector<uint8_t> mCullVisible;
+    std::vector<Aabb> mOcclusionBoxes; // world bounds of frustum visible instances
+    std::vector<uint32_t> mOcclusionInstances; // their mInstances index
+    std::vector<uint8_t> mOcclusionVisible;
+    Timings mTimings;
+    LodSettings mLodSettings;
+    glm::vec3 mViewerPos;
+    uint32_t mFrame;
+    uint32_t mNextPhase;
+
+    // singleton instance and enforced private ctor/copy/assignment
+    static AnimationSystem sInstance;
+    AnimationSystem();
+    AnimationSystem(const AnimationSystem& other) = delete;
+    AnimationSystem& operator=(const AnimationSystem& other) = delete;
+};
+
+#endif // ANIMATION_SYSTEM_H_INCLUDED
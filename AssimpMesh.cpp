@@ -1,106 +1,126 @@
 #include "AssimpMesh.h"
 #include "Renderer.h"
+#include "ThreadPool.h"
+#include "AnimationSystem.h"
 
 #include <cassert>
-
-static inline glm::mat4 aiMatToMat4( const aiMatrix4x4& mat )
+#include <cmath>
+#include <algorithm>
+
+AssimpMesh::AssimpMesh(
+    const std::string& fileName,
+    SkinningMode skinningMode,
+    const AnimCompression& animCompression ) :
+    mAsset(ModelAsset::Get( fileName, skinningMode, animCompression )),
+    mAnimation(nullptr),
+    mAnimIdx(0),
+    mSkinningBlend(BLEND_LINEAR),
+    mVisible(true),
+    mPoseValid(false),
+    mSkinValid(false),
+    mWorldBoundsValid(false)
+{
+    init();
+}
+AssimpMesh::AssimpMesh( const std::shared_ptr<const ModelAsset>& asset ) :
+    mAsset(asset),
+    mAnimation(nullptr),
+    mAnimIdx(0),
+    mSkinningBlend(BLEND_LINEAR),
+    mVisible(true),
+    mPoseValid(false),
+    mSkinValid(false),
+    mWorldBoundsValid(false)
+{
+    init();
+}
+AssimpMesh::~AssimpMesh()
 {
-    // a,b,c,d = row; 1,2,3,4 = col
-    float vals[16] = {
-        mat.a1, mat.b1, mat.c1, mat.d1,
-        mat.a2, mat.b2, mat.c2, mat.d2,
-        mat.a3, mat.b3, mat.c3, mat.d3,
-        mat.a4, mat.b4, mat.c4, mat.d4
-    };
-    return glm::make_mat4( vals );
+    AnimationSystem::GetInstance()->Remove( this );
 }
 
-AssimpMesh::AssimpMesh( const std::string& fileName ) :
-    mAnimation(nullptr)
+void AssimpMesh::init()
 {
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(
-        fileName.c_str(),
-        aiProcess_Triangulate |
-        aiProcess_GenSmoothNormals
-    );
-    if ( !scene ||
-            (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) ||
-            !scene->mRootNode ) {
-        std::cerr << "AssimpMesh::Load readfile failed: " <<
-            importer.GetErrorString() << std::endl;
-        exit( EXIT_FAILURE );
-    }
-    mMeshes.resize( scene->mNumMeshes );
-    mSkeletons.resize( scene->mNumMeshes );
-    mPalette.resize( scene->mNumMeshes );
-    mCurrentPoses.resize( scene->mNumMeshes );
-    size_t curMesh = 0;
-    if ( !processNode( scene->mRootNode, scene, curMesh )) {
-        std::cerr << "AssimpMesh::Load failed to load meshes" << std::endl;
-        exit( EXIT_FAILURE );
-    }
-    
-    mAnimations.resize( scene->mNumAnimations );
-    mAnimNames.resize( scene->mNumAnimations );
-    for ( size_t i=0; i<scene->mNumAnimations; ++i ) {
-        mAnimNames[i] = std::string( scene->mAnimations[i]->mName.C_Str() );
-        if ( !mAnimations[i].Load( scene->mAnimations[i], scene, &mSkeletons[0] )) {
-            std::cerr << "AssimpMesh::Load failed to process animation" << std::endl;
-            exit( EXIT_FAILURE );
+    const std::vector<Mesh>& meshes = mAsset->GetMeshes();
+    const std::vector<MeshSkin>& meshSkins = mAsset->GetMeshSkins();
+    const size_t numSkeletons = mAsset->GetSkeletons().size();
+
+    mCurrentPoses.resize( numSkeletons );
+    mAnimCursors.resize( numSkeletons );
+    mPalette.resize( meshes.size() );
+    mDualQuatPalette.resize( meshes.size() );
+    mSkinnedVertBufs.resize( meshes.size() );
+    mMeshBounds.resize( meshes.size() );
+    // identity palette == bind pose until the first Update
+    for ( size_t mshIdx=0; mshIdx<mPalette.size(); ++mshIdx ) {
+        DualQuat identityDq;
+        identityDq.real = glm::quat( 1.0f, 0.0f, 0.0f, 0.0f );
+        identityDq.dual = glm::quat( 0.0f, 0.0f, 0.0f, 0.0f );
+        const size_t numBones = meshSkins[mshIdx].boneMap.size();
+        mPalette[mshIdx].mEntry.assign( numBones, glm::mat4( 1.0f ));
+        mDualQuatPalette[mshIdx].mEntry.assign( numBones, identityDq );
+        mMeshBounds[mshIdx] = meshes[mshIdx].GetBounds();
+
+        // CPU skinned positions are per instance; the other streams aren't
+        const Mesh& mesh = meshes[mshIdx];
+        if ( numBones > 0 && !mesh.IsGpuSkinned() ) {
+            VertexBuffer::Usage streamUsage[VertexBuffer::NUM_STREAMS];
+            streamUsage[VertexBuffer::STREAM_POSITION] = VertexBuffer::USAGE_DYNAMIC;
+            streamUsage[VertexBuffer::STREAM_NORMAL] = VertexBuffer::USAGE_STATIC;
+            streamUsage[VertexBuffer::STREAM_TEXCOORD] = VertexBuffer::USAGE_STATIC;
+            streamUsage[VertexBuffer::STREAM_SKIN] = VertexBuffer::USAGE_STATIC;
+            mSkinnedVertBufs[mshIdx] = std::make_shared<VertexBuffer>( mesh.GetVertexBufferPtr(), streamUsage );
         }
     }
-    if ( mAnimations.size() == 1 && mAnimations[0].GetName().empty() ) {
-        mAnimNames[0] = "animation0";
-        mAnimations[0].SetName("animation0");
+
+    mAnimIdx = 0;
+    const std::vector<std::vector<Animation>>& animations = mAsset->GetAnimations();
+    if ( !animations.empty() && !animations[0].empty() ) {
+        mAnimation = &animations[0][0];
     }
-    
-    mAnimation = &mAnimations[0];
     mAnimTime = 0.0f;
     mAnimPlayRate = 1.0f;
 
-    std::cout << "Loaded Assimp Mesh " << fileName << std::endl;
-    std::cout << "  Num Meshes: " << mMeshes.size() << std::endl;
-    std::cout << "  Animations: " << mAnimations.size() << std::endl;
-    for (std::string& name : mAnimNames) {
-        std::cout << "    " << name << std::endl;
-    }
+    mSceneGraph = SceneGraph();
+    mSceneGraph.AddNode( SceneGraph::NO_PARENT, mTransform.ToAffine() );
+    mSceneGraph.Append( mAsset->GetSceneGraph(), int( ROOT_NODE ));
+    updateBounds();
 }
-AssimpMesh::~AssimpMesh()
+
+void AssimpMesh::computePoses( const bool skipLeafBones )
 {
+    const std::vector<Skeleton>& skeletons = mAsset->GetSkeletons();
+    const std::vector<std::vector<Animation>>& animations = mAsset->GetAnimations();
+    for ( size_t skelIdx=0; skelIdx<skeletons.size(); ++skelIdx ) {
+        animations[skelIdx][mAnimIdx].GetGlobalPoseAtTime(
+            mCurrentPoses[skelIdx],
+            &skeletons[skelIdx],
+            mAnimTime,
+            &mAnimCursors[skelIdx],
+            skipLeafBones
+        );
+    }
 }
 
-bool AssimpMesh::processNode(
-    const aiNode* node,
-    const aiScene* scene,
-    size_t& curMesh
-)
+void AssimpMesh::Update( const float dt )
 {
-    // process all the node's meshes (if any)
-    for ( size_t i=0; i<node->mNumMeshes; ++i ) {
-        const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        assert( curMesh < mMeshes.size() );
-        if ( !mMeshes[curMesh].Load(mesh, scene) ) {
-            return false;
-        }
-        assert( curMesh < mSkeletons.size() );
-        if ( !mSkeletons[curMesh].Load( mesh, scene )) {
-            return false;
-        }
-        ++curMesh;
+    advanceTime( dt );
+    // hidden instances only keep their clock running; the pose catches
+    // up once they're drawn or asked for it
+    if ( mVisible ) {
+        refresh();
     }
+}
 
-    // process the node's children
-    for ( size_t i=0; i<node->mNumChildren; ++i ) {
-        if ( !processNode( node->mChildren[i], scene, curMesh )) {
-            return false;
-        }
+const std::vector<glm::mat4>& AssimpMesh::GetBonePoses( const size_t skelIdx )
+{
+    if ( mAnimation && !mPoseValid ) {
+        updatePose();
     }
-
-    return true;
+    return mCurrentPoses[skelIdx];
 }
 
-void AssimpMesh::Update( const float dt )
+void AssimpMesh::advanceTime( const float dt )
 {
     if ( !mAnimation ) {
         return;
@@ -110,58 +130,119 @@ void AssimpMesh::Update( const float dt )
     while ( mAnimTime > mAnimation->GetDuration() ) {
         mAnimTime -= mAnimation->GetDuration();
     }
+    mPoseValid = false;
+}
 
-    for ( size_t mshIdx = 0; mshIdx < mMeshes.size(); ++mshIdx )
-    {
-        Mesh& mMesh = mMeshes[mshIdx];
-        Skeleton* mSkeleton = &mSkeletons[mshIdx];
-        if ( mSkeleton->GetNumBones() == 0 ) { continue; }
+bool AssimpMesh::updatePose( const bool skipLeafBones )
+{
+    if ( !mAnimation ) {
+        return false;
+    }
 
-        // Update matrices
+    // pose each rig once; the sub meshes only remap into it
+    computePoses( skipLeafBones );
+
+    const std::vector<MeshSkin>& meshSkins = mAsset->GetMeshSkins();
+    for ( size_t mshIdx = 0; mshIdx < meshSkins.size(); ++mshIdx ) {
+        if ( meshSkins[mshIdx].skeletonIdx == NO_SKELETON ) { continue; }
         ComputeMatrixPalette( mshIdx );
+    }
+    updateBounds();
+    mPoseValid = true;
+    mSkinValid = false;
+    return true;
+}
 
-        // Update vertex buffer
-        const std::vector<VertexTextured>&        vertices        = mMesh.GetVertices();
-        std::vector<VertexTextured>&              frameVertices   = mMesh.GetFrameVertices();
-        const std::vector<Mesh::VertBoneIndices>& vertBoneIdxs    = mMesh.GetBoneIndices();
-        const std::vector<Mesh::VertBoneWeights>& vertBoneWeights = mMesh.GetBoneWeights();
-
-        for ( size_t i=0; i<vertices.size(); ++i )
-        {
-            const VertexTextured& inVert = vertices[i];
-            VertexTextured& outVert = frameVertices[i];
-            const Mesh::VertBoneIndices& boneIdxs = vertBoneIdxs[i];
-            const Mesh::VertBoneWeights& boneWeights = vertBoneWeights[i];
-
-            glm::vec4 skinnedPos =
-                mPalette[mshIdx].mEntry[boneIdxs.idx0] *
-                glm::vec4( inVert.x, inVert.y, inVert.z, 1.0f ) *
-                boneWeights.weight0;
-            skinnedPos +=
-                mPalette[mshIdx].mEntry[boneIdxs.idx1] *
-                glm::vec4( inVert.x, inVert.y, inVert.z, 1.0f ) *
-                boneWeights.weight1;
-            skinnedPos +=
-                mPalette[mshIdx].mEntry[boneIdxs.idx2] *
-                glm::vec4( inVert.x, inVert.y, inVert.z, 1.0f ) *
-                boneWeights.weight2;
-            skinnedPos +=
-                mPalette[mshIdx].mEntry[boneIdxs.idx3] *
-                glm::vec4( inVert.x, inVert.y, inVert.z, 1.0f ) *
-                boneWeights.weight3;
-
-            outVert.x = skinnedPos.x;
-            outVert.y = skinnedPos.y;
-            outVert.z = skinnedPos.z;
-
-            //printf("Skinned xyz: %f,%f,%f\n", outVert.x*0.001f,outVert.y*0.001f,outVert.z*0.001f);
-
-            // TODO - transform normals?
-        }
-        mMesh.GetVertexBuffer().UpdateVertices(
-            frameVertices.data(),
-            frameVertices.size()
+void AssimpMesh::refresh()
+{
+    if ( !mAnimation ) {
+        return;
+    }
+    if ( !mPoseValid ) {
+        updatePose();
+    }
+    if ( mSkinValid ) {
+        return;
+    }
+
+    const std::vector<Mesh>& meshes = mAsset->GetMeshes();
+    for ( size_t mshIdx = 0; mshIdx < meshes.size(); ++mshIdx )
+    {
+        if ( !needsCpuSkinning( mshIdx ) ) { continue; }
+
+        // Skin straight into the mapped position stream; the normals and
+        // texcoords live in their own static streams and never change
+        VertexBuffer& vertBuf = *mSkinnedVertBufs[mshIdx];
+        glm::vec3* framePositions = static_cast<glm::vec3*>(
+            vertBuf.BeginStreamWrite( VertexBuffer::STREAM_POSITION )
+        );
+        if ( framePositions == nullptr ) { continue; }
+
+        // Chunks are skinned in parallel; ParallelFor returns once all
+        // are done so the buffer is complete before it is released to GL
+        ThreadPool::GetInstance()->ParallelFor(
+            meshes[mshIdx].GetVertices().size(),
+            SKINNING_CHUNK_SIZE,
+            [&]( size_t begin, size_t end ) {
+                skinVertices( mshIdx, framePositions, begin, end );
+            }
         );
+        // TODO - transform normals?
+
+        vertBuf.EndStreamWrite( VertexBuffer::STREAM_POSITION );
+    }
+    mSkinValid = true;
+}
+
+bool AssimpMesh::needsCpuSkinning( const size_t mshIdx ) const
+{
+    // GPU skinned palettes are sent to the vertex shader in Draw instead
+    return mSkinnedVertBufs[mshIdx] != nullptr;
+}
+
+void AssimpMesh::skinVertices(
+    const size_t mshIdx,
+    glm::vec3* outPositions,
+    const size_t begin,
+    const size_t end ) const
+{
+    const Mesh& mesh = mAsset->GetMeshes()[mshIdx];
+    const std::vector<VertexTextured>&        vertices        = mesh.GetVertices();
+    const std::vector<VertBoneIndices>&       vertBoneIdxs    = mesh.GetBoneIndices();
+    const std::vector<VertBoneWeights>&       vertBoneWeights = mesh.GetBoneWeights();
+
+    const glm::mat4* palette = mPalette[mshIdx].mEntry.data();
+    const DualQuat* dualQuats = mDualQuatPalette[mshIdx].mEntry.data();
+    const bool dualQuatBlend = (mSkinningBlend == BLEND_DUAL_QUAT);
+
+    // the range may span several influence groups; run each part
+    // through the kernel for its influence count
+    for ( int n=1; n<=MAX_BONE_INFLUENCES; ++n ) {
+        const Mesh::InfluenceGroup& group = mesh.GetInfluenceGroup( n );
+        const size_t first = std::max( begin, group.begin );
+        const size_t last = std::min( end, group.end );
+        if ( first >= last ) { continue; }
+        if ( dualQuatBlend ) {
+            Skinning::SkinPositionsDualQuat(
+                vertices.data() + first,
+                outPositions + first,
+                vertBoneIdxs.data() + first,
+                vertBoneWeights.data() + first,
+                last - first,
+                dualQuats,
+                n
+            );
+        } else {
+            Skinning::SkinPositions(
+                vertices.data() + first,
+                outPositions + first,
+                vertBoneIdxs.data() + first,
+                vertBoneWeights.data() + first,
+                last - first,
+                palette,
+                n
+            );
+        }
     }
 }
 
@@ -169,10 +250,15 @@ void AssimpMesh::SetAnim(const std::string& name, bool loop)
 {
     // TODO - handle no looping
     (void)loop;
-    for ( size_t i=0; i<mAnimNames.size(); ++i ) {
-        if ( name == mAnimNames[i] ) {
-            mAnimation = &mAnimations[i];
+    const std::vector<std::string>& animNames = mAsset->GetAnimNames();
+    const std::vector<std::vector<Animation>>& animations = mAsset->GetAnimations();
+    for ( size_t i=0; i<animNames.size(); ++i ) {
+        if ( name == animNames[i] ) {
+            // a file can name clips without having a rig to play them on
+            mAnimIdx = i;
+            mAnimation = ( !animations.empty() && i < animations[0].size() ) ? &animations[0][i] : nullptr;
             mAnimTime = 0.0f;
+            mPoseValid = false;
             break;
         }
     }
@@ -182,6 +268,7 @@ void AssimpMesh::SetAnimTime( const float time ) {
     if ( !mAnimation ) { return; }
     if ( time >= 0.0f && time < mAnimation->GetDuration() ) {
         mAnimTime = time;
+        mPoseValid = false;
     }
 }
 
@@ -193,20 +280,190 @@ void AssimpMesh::SetTexture( const Texture* tex, size_t meshIdx )
     mTextures[meshIdx] = tex;
 }
 
-void AssimpMesh::SetPosition( const glm::vec3& pos ) { mTransform.position = pos; }
-void AssimpMesh::SetRotation( const glm::quat& rot ) { mTransform.rotation = rot; }
-void AssimpMesh::SetScale( const glm::vec3& scl ) { mTransform.scale = scl; }
+void AssimpMesh::SetPosition( const glm::vec3& pos )
+{
+    mTransform.position = pos;
+    mSceneGraph.SetLocal( ROOT_NODE, mTransform );
+}
+void AssimpMesh::SetRotation( const glm::quat& rot )
+{
+    mTransform.rotation = rot;
+    mSceneGraph.SetLocal( ROOT_NODE, mTransform );
+}
+void AssimpMesh::SetScale( const glm::vec3& scl )
+{
+    mTransform.scale = scl;
+    mSceneGraph.SetLocal( ROOT_NODE, mTransform );
+}
+
+int AssimpMesh::FindNode( const std::string& name ) const
+{
+    return mAsset->GetSceneGraph().FindNode( name );
+}
+
+void AssimpMesh::SetNodeTransform( const int node, const Transform& local )
+{
+    assert( node >= 0 && size_t( node ) < mAsset->GetSceneGraph().GetNumNodes() );
+    mSceneGraph.SetLocal( ROOT_NODE + 1 + size_t( node ), local );
+}
 
 void AssimpMesh::Draw(void)
 {
-    glm::mat4 modelMat = mTransform.ToMat4();
+    // culled; the pose isn't built until the instance is visible again
+    // or GetBonePoses asks for it
+    if ( !mVisible ) {
+        return;
+    }
+    // no-op unless the pose went stale while hidden
+    refresh();
+    updateTransforms();
 
     Renderer* rndr = Renderer::GetInstance();
-    for (size_t i=0; i<mMeshes.size(); ++i) {
+    const std::vector<Mesh>& meshes = mAsset->GetMeshes();
+    const std::vector<MeshSkin>& meshSkins = mAsset->GetMeshSkins();
+    for (size_t i=0; i<meshes.size(); ++i) {
         if (mTextures.size() > i && mTextures[i]) {
             rndr->SetTexture(*((Texture*)mTextures[i]));
         }
-        rndr->DrawVertexBuffer( modelMat, mMeshes[i].GetVertexBuffer() );
+        const BoundingSphere bounds( mMeshBounds[i] );
+        const glm::mat4 modelMat = getMeshWorld( i ).ToMat4();
+        if ( meshes[i].IsGpuSkinned() && mSkinningBlend == BLEND_DUAL_QUAT ) {
+            rndr->DrawSkinnedVertexBuffer(
+                modelMat,
+                meshes[i].GetVertexBuffer(),
+                mDualQuatPalette[i].mEntry.data(),
+                meshSkins[i].boneMap.size(),
+                &bounds
+            );
+        } else if ( meshes[i].IsGpuSkinned() ) {
+            rndr->DrawSkinnedVertexBuffer(
+                modelMat,
+                meshes[i].GetVertexBuffer(),
+                mPalette[i].mEntry.data(),
+                meshSkins[i].boneMap.size(),
+                &bounds
+            );
+        } else {
+            rndr->DrawVertexBuffer( modelMat, getVertexBuffer( i ), &bounds );
+        }
+    }
+}
+
+void AssimpMesh::DrawCrowd( const CrowdInstance* instances, const size_t numInstances )
+{
+    if ( numInstances == 0 ) { return; }
+
+    mCrowdModelMats.resize( numInstances );
+    for ( size_t i=0; i<numInstances; ++i ) {
+        mCrowdModelMats[i] = instances[i].modelMat;
+    }
+
+    // pose every rig of every instance once; each instance is independent
+    // so spread them across the worker threads
+    const std::vector<Skeleton>& skeletons = mAsset->GetSkeletons();
+    const std::vector<std::vector<Animation>>& animations = mAsset->GetAnimations();
+    mCrowdPoses.resize( skeletons.size() );
+    for ( size_t skelIdx=0; skelIdx<skeletons.size(); ++skelIdx ) {
+        mCrowdPoses[skelIdx].resize( numInstances * skeletons[skelIdx].GetNumBones() );
+    }
+    ThreadPool::GetInstance()->ParallelFor(
+        numInstances,
+        CROWD_CHUNK_SIZE,
+        [&]( size_t begin, size_t end ) {
+            std::vector<glm::mat4> poses;
+            for ( size_t skelIdx=0; skelIdx<skeletons.size(); ++skelIdx ) {
+                const Skeleton& skeleton = skeletons[skelIdx];
+                const size_t numBones = skeleton.GetNumBones();
+                const Animation* anim = animations[skelIdx].empty() ? nullptr : &animations[skelIdx][mAnimIdx];
+                for ( size_t inst=begin; inst<end; ++inst ) {
+                    if ( anim && anim->GetDuration() > 0.0f ) {
+                        float time = fmodf( instances[inst].animTime, anim->GetDuration() );
+                        if ( time < 0.0f ) { time += anim->GetDuration(); }
+                        anim->GetGlobalPoseAtTime( poses, &skeleton, time );
+                    } else {
+                        poses.assign( numBones, glm::mat4( 1.0f ));
+                    }
+                    std::copy( poses.begin(), poses.begin() + numBones,
+                        mCrowdPoses[skelIdx].begin() + inst * numBones );
+                }
+            }
+        }
+    );
+
+    Renderer* rndr = Renderer::GetInstance();
+    const std::vector<Mesh>& meshes = mAsset->GetMeshes();
+    const std::vector<MeshSkin>& meshSkins = mAsset->GetMeshSkins();
+    for ( size_t mshIdx=0; mshIdx<meshes.size(); ++mshIdx )
+    {
+        const Mesh& mesh = meshes[mshIdx];
+        const MeshSkin& skin = meshSkins[mshIdx];
+        if ( !mesh.IsGpuSkinned() ) {
+            std::cerr << "AssimpMesh::DrawCrowd: mesh " << mshIdx
+                      << " was not loaded with SKINNING_GPU" << std::endl;
+            continue;
+        }
+
+        // remap the rig poses into this mesh's palette order, and bound
+        // each instance's pose as updateBounds does
+        const size_t numBones = skin.boneMap.size();
+        const size_t numRigBones = skeletons[skin.skeletonIdx].GetNumBones();
+        const std::vector<glm::mat4>& rigPoses = mCrowdPoses[skin.skeletonIdx];
+        const std::vector<Aabb>& boneBounds = mesh.GetBoneBounds();
+        const bool dualQuatBlend = (mSkinningBlend == BLEND_DUAL_QUAT);
+        mCrowdPalettes.resize( numInstances * numBones );
+        mCrowdBounds.resize( numInstances );
+        if ( dualQuatBlend ) {
+            mCrowdDualQuats.resize( numInstances * numBones );
+        }
+        ThreadPool::GetInstance()->ParallelFor(
+            numInstances,
+            CROWD_CHUNK_SIZE,
+            [&]( size_t begin, size_t end ) {
+                for ( size_t inst=begin; inst<end; ++inst ) {
+                    const glm::mat4* poses = &rigPoses[inst * numRigBones];
+                    glm::mat4* palette = &mCrowdPalettes[inst * numBones];
+                    Aabb& bounds = mCrowdBounds[inst];
+                    bounds = Aabb();
+                    for ( size_t i=0; i<numBones; ++i ) {
+                        palette[i] = poses[skin.boneMap[i]] * skin.invBindPoses[i];
+                        if ( i < boneBounds.size() ) {
+                            bounds.Add( boneBounds[i].Transformed( palette[i] ));
+                        }
+                    }
+                    if ( dualQuatBlend ) {
+                        Skinning::PaletteToDualQuats( palette, &mCrowdDualQuats[inst * numBones], numBones );
+                    }
+                }
+            }
+        );
+        Aabb crowdBounds;
+        for ( const Aabb& bounds : mCrowdBounds ) {
+            crowdBounds.Add( bounds );
+        }
+        const BoundingSphere bounds( crowdBounds );
+
+        if ( mTextures.size() > mshIdx && mTextures[mshIdx] ) {
+            rndr->SetTexture( *mTextures[mshIdx] );
+        }
+        if ( dualQuatBlend ) {
+            rndr->DrawSkinnedVertexBufferInstanced(
+                mCrowdModelMats.data(),
+                mCrowdDualQuats.data(),
+                numInstances,
+                numBones,
+                mesh.GetVertexBuffer(),
+                &bounds
+            );
+        } else {
+            rndr->DrawSkinnedVertexBufferInstanced(
+                mCrowdModelMats.data(),
+                mCrowdPalettes.data(),
+                numInstances,
+                numBones,
+                mesh.GetVertexBuffer(),
+                &bounds
+            );
+        }
     }
 }
 
@@ -219,315 +476,100 @@ float AssimpMesh::GetCurAnimLength() const {
 
 void AssimpMesh::ComputeMatrixPalette( const size_t mshIdx )
 {
-    Skeleton* mSkeleton = &mSkeletons[mshIdx];
-    const std::vector<glm::mat4>& globalInvBindPoses =
-        mSkeleton->GetGlobalInvBindPoses();
-    mAnimation->GetGlobalPoseAtTime( mCurrentPoses[mshIdx], mSkeleton, mAnimTime );
+    const MeshSkin& skin = mAsset->GetMeshSkins()[mshIdx];
+    const std::vector<glm::mat4>& rigPoses = mCurrentPoses[skin.skeletonIdx];
 
     // setup the palette for each bone
-    for ( size_t i=0; i<mSkeleton->GetNumBones(); ++i ) {
+    for ( size_t i=0; i<skin.boneMap.size(); ++i ) {
         // Global inverse bind pose matrix times current pose matrix
-        mPalette[mshIdx].mEntry[i] = mCurrentPoses[mshIdx][i] * globalInvBindPoses[i];
+        mPalette[mshIdx].mEntry[i] = rigPoses[skin.boneMap[i]] * skin.invBindPoses[i];
     }
-}
 
-// Mesh functions
-AssimpMesh::Mesh::Mesh()
-{}
-AssimpMesh::Mesh::~Mesh()
-{}
-
-bool AssimpMesh::Mesh::Load( const aiMesh* mesh, const aiScene* scene )
-{
-    const aiMesh* assimpMesh = mesh;
-
-    mVertices.resize( assimpMesh->mNumVertices );
-    mFrameVertices.resize( assimpMesh->mNumVertices );
-    mBoneIndices.resize( assimpMesh->mNumVertices );
-    mBoneWeights.resize( assimpMesh->mNumVertices );
-    std::vector<unsigned int> boneWeightCounters( assimpMesh->mNumVertices, 0 );
-
-    for (size_t i=0; i<assimpMesh->mNumVertices; ++i) {
-        mVertices[i].x = assimpMesh->mVertices[i].x;
-        mVertices[i].y = assimpMesh->mVertices[i].y;
-        mVertices[i].z = assimpMesh->mVertices[i].z;
-        mVertices[i].nx = assimpMesh->mNormals[i].x;
-        mVertices[i].ny = assimpMesh->mNormals[i].y;
-        mVertices[i].nz = assimpMesh->mNormals[i].z;
-        if ( assimpMesh->mTextureCoords[0] ) {
-            mVertices[i].u = assimpMesh->mTextureCoords[0][i].x;
-            mVertices[i].v = assimpMesh->mTextureCoords[0][i].y;
-        } else {
-            mVertices[i].u = mVertices[i].v = 0.0f;
-        }
-
-        // default all bone indices to 0
-        mBoneIndices[i].idx0 = 0;
-        mBoneIndices[i].idx1 = 0;
-        mBoneIndices[i].idx2 = 0;
-        mBoneIndices[i].idx3 = 0;
-
-        // default all weights to 0
-        mBoneWeights[i].weight0 = 0.0f;
-        mBoneWeights[i].weight1 = 0.0f;
-        mBoneWeights[i].weight2 = 0.0f;
-        mBoneWeights[i].weight3 = 0.0f;
-    }
-
-    for ( size_t i=0; i<assimpMesh->mNumBones; ++i ) {
-        const aiBone* bone = assimpMesh->mBones[i];
-        //std::string boneName(bone->mName.C_Str());
-
-        // get weights/indices
-        for ( size_t j=0; j<bone->mNumWeights; ++j ) {
-            const aiVertexWeight& weight = bone->mWeights[j];
-            // index of the vertex which is influenced by the bone
-            const unsigned int vertIndex = weight.mVertexId;
-            assert( vertIndex < mVertices.size() );
-            switch ( boneWeightCounters[vertIndex] )
-            {
-            case 0:
-                mBoneWeights[vertIndex].weight0 = weight.mWeight;
-                mBoneIndices[vertIndex].idx0 = uint32_t(i);
-                break;
-            case 1:
-                mBoneWeights[vertIndex].weight1 = weight.mWeight;
-                mBoneIndices[vertIndex].idx1 = uint32_t(i);
-                break;
-            case 2:
-                mBoneWeights[vertIndex].weight2 = weight.mWeight;
-                mBoneIndices[vertIndex].idx2 = uint32_t(i);
-                break;
-            case 3:
-                mBoneWeights[vertIndex].weight3 = weight.mWeight;
-                mBoneIndices[vertIndex].idx3 = uint32_t(i);
-                break;
-            default:
-                std::cout << "AssimpMesh unhandled weight number " <<
-                    boneWeightCounters[vertIndex] << std::endl;
-                break;
-            }
-            ++boneWeightCounters[vertIndex];
-        }
-    }
-    // possibly todo - normalize weights?
-
-    // copy of original vertices to be updated each frame
-    mFrameVertices = mVertices;
-
-    std::vector<uint32_t> indices( assimpMesh->mNumFaces*3 );
-    for ( size_t i=0; i<assimpMesh->mNumFaces; ++i ) {
-        aiFace& face = assimpMesh->mFaces[i];
-        assert( face.mNumIndices == 3 );
-        indices[i*3 + 0] = face.mIndices[0];
-        indices[i*3 + 1] = face.mIndices[1];
-        indices[i*3 + 2] = face.mIndices[2];
+    if ( mSkinningBlend == BLEND_DUAL_QUAT ) {
+        Skinning::PaletteToDualQuats(
+            mPalette[mshIdx].mEntry.data(),
+            mDualQuatPalette[mshIdx].mEntry.data(),
+            skin.boneMap.size()
+        );
     }
-
-    mVertBuf = std::make_shared<VertexBuffer>(
-        VertexBuffer::POS_TEXCOORD,
-        mVertices.data(), mVertices.size(),
-        indices.data(), indices.size(),
-        VertexBuffer::USAGE_DYNAMIC
-    );
-
-    return true;
 }
 
-static const aiNode* getBoneNode(
-    const std::string& name,
-    const aiNode* node
-)
+const Aabb& AssimpMesh::GetWorldBounds()
 {
-    if ( node != nullptr &&
-            std::string(node->mName.C_Str()) == name) {
-        return node;
-    }
-    
-    for ( size_t i=0; i<node->mNumChildren; ++i ) {
-        const aiNode* childNode = getBoneNode( name, node->mChildren[i] );
-        if ( childNode != nullptr ) {
-            return childNode;
+    updateTransforms();
+    if ( !mWorldBoundsValid ) {
+        mWorldBounds = Aabb();
+        for ( size_t mshIdx=0; mshIdx<mMeshBounds.size(); ++mshIdx ) {
+            mWorldBounds.Add( mMeshBounds[mshIdx].Transformed( getMeshWorld( mshIdx ).ToMat4() ));
         }
+        mWorldBoundsValid = true;
     }
-    
-    return nullptr;
+    return mWorldBounds;
 }
-static std::string getParentName(
-    const std::string& boneName,
-    const aiScene* scene
-)
+
+void AssimpMesh::AddOccluders( OcclusionCuller& culler )
 {
-    const aiNode* rootNode = scene->mRootNode;
-    const aiNode* boneNode = getBoneNode( boneName, rootNode );
-    assert( boneNode != nullptr );
-    if ( boneNode->mParent != nullptr ) {
-        const aiNode* parent = boneNode->mParent;
-        return std::string( parent->mName.C_Str() );
+    updateTransforms();
+    const std::vector<Mesh>& meshes = mAsset->GetMeshes();
+    const std::vector<MeshSkin>& meshSkins = mAsset->GetMeshSkins();
+    for ( size_t mshIdx=0; mshIdx<meshes.size(); ++mshIdx )
+    {
+        if ( meshSkins[mshIdx].skeletonIdx != NO_SKELETON ) { continue; }
+        const Mesh& mesh = meshes[mshIdx];
+        const std::vector<VertexTextured>& vertices = mesh.GetVertices();
+        const std::vector<uint32_t>& indices = mesh.GetIndices();
+        if ( vertices.empty() ) { continue; }
+        culler.AddOccluder(
+            getMeshWorld( mshIdx ).ToMat4(),
+            &vertices[0].x,
+            sizeof( VertexTextured ),
+            vertices.size(),
+            indices.data(),
+            indices.size()
+        );
     }
-    return "";
 }
 
-// Skeleton functions
-bool AssimpMesh::Skeleton::Load(
-    const aiMesh* mesh,
-    const aiScene* scene
-)
+void AssimpMesh::updateBounds()
 {
-    mBones.resize( mesh->mNumBones );
-    for ( size_t i=0; i<mesh->mNumBones; ++i ) {
-        const aiBone* bone = mesh->mBones[i];
-        mBones[i].mLocalBindPose = aiMatToMat4( bone->mOffsetMatrix );
-        mBones[i].mName = std::string( bone->mName.C_Str() );
-        mBones[i].mParent = -1;
-    }
-    // Get parent indices
-    for ( size_t i=0; i<mBones.size(); ++i ) {
-        std::string parentName = getParentName( mBones[i].mName, scene );
-        if ( !parentName.empty() ) {
-            for ( size_t j=0; j<mBones.size(); ++j ) {
-                if ( mBones[j].mName == parentName ) {
-                    mBones[i].mParent = j;
-                }
+    const std::vector<Mesh>& meshes = mAsset->GetMeshes();
+    const std::vector<MeshSkin>& meshSkins = mAsset->GetMeshSkins();
+    for ( size_t mshIdx=0; mshIdx<meshes.size(); ++mshIdx )
+    {
+        if ( meshSkins[mshIdx].skeletonIdx != NO_SKELETON ) {
+            // conservative; each bone's box moved by its palette entry
+            const std::vector<Aabb>& boneBounds = meshes[mshIdx].GetBoneBounds();
+            const std::vector<glm::mat4>& palette = mPalette[mshIdx].mEntry;
+            Aabb& bounds = mMeshBounds[mshIdx];
+            bounds = Aabb();
+            for ( size_t i=0; i<boneBounds.size() && i<palette.size(); ++i ) {
+                bounds.Add( boneBounds[i].Transformed( palette[i] ));
             }
         }
     }
-    // Get the root index
-    mRootBoneIdx = 0;
-    for ( size_t i=0; i<mBones.size(); ++i ) {
-        if ( mBones[i].mParent == -1 ) {
-            mRootBoneIdx = i;
-            break;
-        }
-    }
-    ComputeGlobalInvBindPose();
-    return true;
+    mWorldBoundsValid = false;
 }
 
-void AssimpMesh::Skeleton::ComputeGlobalInvBindPose()
+void AssimpMesh::updateTransforms()
 {
-    // resize to number of bones, which auto fills identity
-    mGlobalInvBindPoses.resize( GetNumBones() );
-    if ( GetNumBones() == 0 ) { return; }
-    
-    // Assimp already calculates the global inverse bind poses for us
-    mGlobalInvBindPoses[0] = mBones[0].mLocalBindPose;
-    for ( size_t i=1; i<mGlobalInvBindPoses.size(); ++i ) {
-        const glm::mat4 localMat = mBones[i].mLocalBindPose;
-        mGlobalInvBindPoses[i] = localMat;
+    if ( mSceneGraph.UpdateWorldTransforms() > 0 ) {
+        mWorldBoundsValid = false;
     }
 }
 
-// Animation functions
-bool AssimpMesh::Animation::Load(
-    const aiAnimation* assimpAnim,
-    const aiScene* scene,
-    const Skeleton* skeleton
-)
+const Affine& AssimpMesh::getMeshWorld( const size_t mshIdx ) const
 {
-    const std::vector<Skeleton::Bone>& bones = skeleton->GetBones();
-    mName = std::string( assimpAnim->mName.C_Str() );
-    mTracks.resize( bones.size() );
-    mNumBones = mTracks.size();
-    mNumFrames = assimpAnim->mChannels[0]->mNumPositionKeys;
-    // possibly TODO - properly convert these?
-    //mDuration = assimpAnim->mDuration / assimpAnim->mTicksPerSecond;
-    //mFrameDuration = mDuration / float(mNumFrames);
-    mFrameDuration = 1.0f/24.0f; // default 24 fps
-    mDuration = (mNumFrames-1) * mFrameDuration;
-    for ( size_t i=0; i<mTracks.size(); ++i ) {
-        mTracks[i].resize(mNumFrames);
-    }
-    for ( size_t i=0; i<assimpAnim->mNumChannels; ++i ) {
-        const aiNodeAnim* channel = assimpAnim->mChannels[i];
-        std::string name = std::string( channel->mNodeName.C_Str() );
-        size_t boneIdx = 0;
-        for ( size_t j=0; j<bones.size(); ++j ) {
-            if ( bones[j].mName == name ) {
-                boneIdx = j;
-            }
-        }
-        
-        assert( mNumFrames == channel->mNumPositionKeys );
-        assert(
-            (channel->mNumPositionKeys == channel->mNumRotationKeys) &&
-            (channel->mNumPositionKeys == channel->mNumScalingKeys)
-        );
-        //mTracks[boneIdx].resize(channel->mNumPositionKeys);
-        for ( size_t j=0; j<channel->mNumPositionKeys; ++j ) {
-            const aiVectorKey& keyFrame = channel->mPositionKeys[j];
-            mTracks[boneIdx][j].position = glm::vec3(
-                keyFrame.mValue.x,
-                keyFrame.mValue.y,
-                keyFrame.mValue.z
-            );
-        }
-        for ( size_t j=0; j<channel->mNumRotationKeys; ++j ) {
-            const aiQuatKey& keyFrame = channel->mRotationKeys[j];
-            mTracks[boneIdx][j].rotation = glm::quat(
-                keyFrame.mValue.w,
-                keyFrame.mValue.x,
-                keyFrame.mValue.y,
-                keyFrame.mValue.z
-            );
-        }
-        for ( size_t j=0; j<channel->mNumScalingKeys; ++j ) {
-            const aiVectorKey& keyFrame = channel->mScalingKeys[j];
-            mTracks[boneIdx][j].scale = glm::vec3(
-                keyFrame.mValue.x,
-                keyFrame.mValue.y,
-                keyFrame.mValue.z
-            );
-        }
+    // bone poses already place skinned meshes in model space
+    if ( mAsset->GetMeshSkins()[mshIdx].skeletonIdx != NO_SKELETON ) {
+        return mSceneGraph.GetWorld( ROOT_NODE );
     }
-    return true;
+    return mSceneGraph.GetWorld( ROOT_NODE + 1 + mAsset->GetMeshNodes()[mshIdx] );
 }
 
-void AssimpMesh::Animation::GetGlobalPoseAtTime(
-    std::vector<glm::mat4>& outPoses,
-    const Skeleton* inSkeleton,
-    float inTime ) const
+const VertexBuffer& AssimpMesh::getVertexBuffer( const size_t mshIdx ) const
 {
-    if ( outPoses.size() != mNumBones ) {
-        outPoses.resize( mNumBones );
-    }
-
-    // Figure out the current frame idx and next.
-    // Assumes inTime is in range [0,mDuration]
-    size_t frame = static_cast<size_t>( inTime/mFrameDuration );
-    size_t nextFrame = frame+1;
-    // Calculate percentage between this and next frame
-    float pct = inTime / mFrameDuration - frame;
-
-    // setup root pose
-    size_t rootIdx = inSkeleton->GetRootBoneIdx();
-    if ( mTracks.size() > 0 ) {
-        Transform interp = Lerp(
-            mTracks[rootIdx][frame],
-            mTracks[rootIdx][nextFrame],
-            pct
-        );
-        outPoses[rootIdx] = interp.ToMat4();
-    } else {
-        outPoses[rootIdx] = glm::mat4(1.0f); // identity
-    }
-
-    // setup remaining poses
-    const std::vector<Skeleton::Bone>& bones = inSkeleton->GetBones();
-    for ( size_t bone=0; bone<mNumBones; ++bone ) {
-        glm::mat4 localMat(1.0f);
-        if ( mTracks[bone].size() > 0 ) {
-            Transform interp = Lerp(
-                mTracks[bone][frame],
-                mTracks[bone][nextFrame],
-                pct
-            );
-            localMat = interp.ToMat4();
-        }
-        if ( bones[bone].mParent >= 0 ) {
-            outPoses[bone] = outPoses[bones[bone].mParent] * localMat;
-        }
+    if ( mSkinnedVertBufs[mshIdx] ) {
+        return *mSkinnedVertBufs[mshIdx];
     }
+    return mAsset->GetMeshes()[mshIdx].GetVertexBuffer();
 }
-
-
@@ -5,10 +5,6 @@
 #include <vector>
 #include <memory>
 
-#include <assimp/scene.h>
-#include <assimp/Importer.hpp>
-#include <assimp/postprocess.h>
-
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/transform.hpp>
@@ -19,14 +15,42 @@
 #include "VertexBuffer.h"
 #include "Texture.h"
 #include "Transform.h"
-
+#include "Skinning.h"
+#include "ModelAsset.h"
+#include "Bounds.h"
+#include "SceneGraph.h"
+#include "OcclusionCuller.h"
+
+// One posable, drawable copy of a model. The loaded data is a shared
+// ModelAsset; this only holds the transform, animation state and
+// skinned output
 class AssimpMesh
 {
 public:
 
-    AssimpMesh( const std::string& fileName );
+    typedef ModelAsset::SkinningMode SkinningMode;
+    static const SkinningMode SKINNING_CPU = ModelAsset::SKINNING_CPU;
+    static const SkinningMode SKINNING_GPU = ModelAsset::SKINNING_GPU;
+    typedef ModelAsset::AnimCompression AnimCompression;
+
+    enum SkinningBlend
+    {
+        BLEND_LINEAR, // weighted sum of bone matrices
+        BLEND_DUAL_QUAT // weighted sum of bone dual quaternions; keeps volume at twisting joints
+    };
+
+    // uses the cached asset of the file if one is loaded (see ModelAsset::Get)
+    AssimpMesh(
+        const std::string& fileName,
+        SkinningMode skinningMode = SKINNING_CPU,
+        const AnimCompression& animCompression = AnimCompression()
+    );
+    explicit AssimpMesh( const std::shared_ptr<const ModelAsset>& asset );
     ~AssimpMesh();
 
+    // Advance the animation and skin on the calling thread. Hidden
+    // instances only advance their clock. To update many instances
+    // together, register them with AnimationSystem instead
     void Update     ( const float dt );
     void SetAnim    ( const std::string& name, bool loop = true );
     void SetAnimTime( const float time );
@@ -34,159 +58,141 @@ public:
     void SetPosition( const glm::vec3& pos );
     void SetRotation( const glm::quat& rot );
     void SetScale   ( const glm::vec3& scl );
+    const glm::vec3& GetPosition(void) const { return mTransform.position; }
+    void SetSkinningBlend( SkinningBlend blend ) { mSkinningBlend = blend; mPoseValid = false; }
+    // Set by culling each frame; while false Update skips pose sampling
+    // and skinning, and Draw does nothing
+    void SetVisible( bool visible ) { mVisible = visible; }
+    bool IsVisible(void) const { return mVisible; }
 
     void Draw(void);
 
-    const std::vector<std::string>& GetAnimNames(void) const { return mAnimNames; }
+    // One character of a crowd drawn with DrawCrowd
+    struct CrowdInstance
+    {
+        glm::mat4 modelMat;
+        float animTime; // seconds into the current animation; wrapped to its length
+    };
+    // Draw many copies of a SKINNING_GPU mesh, each posed at its own time
+    // in the current animation, with one instanced draw per sub mesh,
+    // blended as set by SetSkinningBlend. Palettes and bounds are
+    // evaluated here, so Update isn't needed for crowds
+    void DrawCrowd( const CrowdInstance* instances, const size_t numInstances );
+
+    const std::vector<std::string>& GetAnimNames(void) const { return mAsset->GetAnimNames(); }
     float GetCurAnimLength(void) const;
     float GetCurAnimTime  (void) const { return mAnimTime; }
+    SkinningMode GetSkinningMode(void) const { return mAsset->GetSkinningMode(); }
+    SkinningBlend GetSkinningBlend(void) const { return mSkinningBlend; }
+    const std::shared_ptr<const ModelAsset>& GetAsset(void) const { return mAsset; }
+    // world space bounds of the current pose; conservative for skinned
+    // meshes. Not updated while hidden
+    const Aabb& GetWorldBounds(void);
+    BoundingSphere GetWorldBoundingSphere(void) { return BoundingSphere( GetWorldBounds() ); }
+
+    // Nodes of the model's hierarchy, to move parts of this instance on
+    // their own. Unskinned meshes follow their node; skinned meshes only
+    // follow the instance transform
+    int FindNode( const std::string& name ) const;
+    void SetNodeTransform( const int node, const Transform& local );
+
+    // Add the unskinned meshes to this frame's occluders; skinned ones
+    // move too much to hide anything reliably
+    void AddOccluders( OcclusionCuller& culler );
+    // global pose of every bone of a rig at the current time; posed here
+    // if Update skipped it
+    const std::vector<glm::mat4>& GetBonePoses( const size_t skelIdx = 0 );
 
 private:
 
-    class Mesh
-    {
-    public:
-
-        struct VertBoneIndices
-        {
-            uint32_t idx0;
-            uint32_t idx1;
-            uint32_t idx2;
-            uint32_t idx3;
-        };
-        struct VertBoneWeights
-        {
-            float weight0;
-            float weight1;
-            float weight2;
-            float weight3;
-        };
-
-        Mesh();
-        ~Mesh();
-
-        bool Load( const aiMesh* mesh, const aiScene* scene );
-        void Unload(void);
-
-        VertexBuffer&                       GetVertexBuffer() { return *mVertBuf; }
-        const std::string&                  GetFileName() const { return mFileName; }
-        const std::vector<VertexTextured>&  GetVertices() const { return mVertices; }
-        std::vector<VertexTextured>&        GetFrameVertices() { return mFrameVertices; }
-        const std::vector<VertBoneIndices>& GetBoneIndices() const { return mBoneIndices; }
-        const std::vector<VertBoneWeights>& GetBoneWeights() const { return mBoneWeights; }
-
-    private:
-
-        std::shared_ptr<VertexBuffer> mVertBuf;
-        std::vector<VertexTextured> mVertices;
-        std::vector<VertexTextured> mFrameVertices; // copy of mVertices, to be modified each frame for animation
-        std::vector<VertBoneIndices> mBoneIndices;
-        std::vector<VertBoneWeights> mBoneWeights;
-        std::string mFileName;
-    };
+    // updates registered instances in phases across threads
+    friend class AnimationSystem;
 
-    static const size_t MAX_SKELETON_BONES = 96;
-    struct MatrixPalette
-    {
-        glm::mat4 mEntry[MAX_SKELETON_BONES];
-    };
+    typedef ModelAsset::Mesh Mesh;
+    typedef ModelAsset::Skeleton Skeleton;
+    typedef ModelAsset::Animation Animation;
+    typedef ModelAsset::MeshSkin MeshSkin;
+    static const size_t NO_SKELETON = ModelAsset::NO_SKELETON;
+
+    // scene graph node holding mTransform; the asset's nodes follow it
+    static const size_t ROOT_NODE = 0;
 
-    class Skeleton
+    // min number of vertices skinned per worker thread job
+    static const size_t SKINNING_CHUNK_SIZE = 2048;
+    // min number of crowd instances posed per worker thread job
+    static const size_t CROWD_CHUNK_SIZE = 16;
+    // one entry per skeleton bone
+    struct MatrixPalette
     {
-    public:
-
-        struct Bone
-        {
-            glm::mat4 mLocalBindPose;
-            std::string mName;
-            int mParent;
-        };
-
-        bool Load( const aiMesh* assimpMesh, const aiScene* scene );
-
-        size_t                        GetNumBones(void)           const { return mBones.size(); }
-        size_t                        GetRootBoneIdx(void)        const { return mRootBoneIdx; }
-        const Bone&                   GetBone( size_t idx )       const { return mBones[idx]; }
-        const std::vector<Bone>&      GetBones(void)              const { return mBones; }
-        const std::vector<glm::mat4>& GetGlobalInvBindPoses(void) const { return mGlobalInvBindPoses; }
-        const std::string&            GetFileName(void)           const { return mFileName; }
-
-    protected:
-        // Called automatically when the skeleton is loaded
-        // Computes the global inverse bind pose for each bone
-        void ComputeGlobalInvBindPose();
-    private:
-        // The bones in the skeleton
-        std::vector<Bone> mBones;
-        // The global inverse bind poses for each bone
-        std::vector<glm::mat4> mGlobalInvBindPoses;
-        // The file this was loaded from
-        std::string mFileName;
-        // which index into mBones is the root node
-        size_t mRootBoneIdx;
+        std::vector<glm::mat4> mEntry;
     };
-
-    class Animation
+    // MatrixPalette converted for BLEND_DUAL_QUAT
+    struct DualQuatPalette
     {
-    public:
-
-        bool Load( const aiAnimation* assimpAnim, const aiScene* scene, const Skeleton* skeleton );
-
-        size_t GetNumBones() const { return mNumBones; }
-        size_t GetNumFrames() const { return mNumFrames; }
-        float GetDuration() const { return mDuration; }
-        float GetFrameDuration() const { return mFrameDuration; }
-        const std::string& GetName() const { return mName; }
-        void SetName( const std::string& newName ) { mName = newName; }
-
-        // Fills the provided vector with the global (current) pose matrices
-        // for each bone at the specified time in the anim.
-        // Time must be >= 0.0f && <= mDuration.
-        void GetGlobalPoseAtTime(
-            std::vector<glm::mat4>& outPoses,
-            const Skeleton* inSkeleton,
-            float inTime
-        ) const;
-
-    private:
-        size_t mNumBones;
-        size_t mNumFrames;
-
-        float mDuration; // total anim length in seconds
-        float mFrameDuration; // length of 1 frame in seconds
-
-        // transform info for each frame on the track.
-        // each index in the outer vector is a bone,
-        // inner vector is a frame
-        std::vector<std::vector<Transform>> mTracks;
-
-        // file this was loaded from
-        std::string mName;
+        std::vector<DualQuat> mEntry;
     };
 
+    std::shared_ptr<const ModelAsset> mAsset;
+    // per mesh; own position stream for CPU skinned meshes, sharing the
+    // asset's static streams. Null for meshes drawn from the asset as is
+    std::vector<std::shared_ptr<VertexBuffer>> mSkinnedVertBufs;
     std::vector<MatrixPalette> mPalette;
-    std::vector<Mesh> mMeshes;
+    std::vector<DualQuatPalette> mDualQuatPalette;
     std::vector<const Texture*> mTextures;
-    std::vector<Skeleton> mSkeletons;
-    std::vector<Animation> mAnimations;
-    std::vector<std::string> mAnimNames;
-    Animation* mAnimation;
+    std::vector<Aabb> mMeshBounds; // per mesh, in the space of getMeshWorld
+    Aabb mWorldBounds; // all meshes
+    const Animation* mAnimation; // current clip of the first rig, for timing
+    size_t mAnimIdx; // current clip index
     float mAnimPlayRate;
     float mAnimTime;
-    std::vector<std::vector<glm::mat4>> mCurrentPoses;
+    std::vector<std::vector<glm::mat4>> mCurrentPoses; // global pose per rig
+    std::vector<Animation::Cursor> mAnimCursors; // key lookup hints per rig
     Transform mTransform;
-
-    bool processNode(
-        const aiNode* node,
-        const aiScene* scene,
-        size_t& curMesh
-    );
-    bool processAnimation(
-        const aiAnimation* assimpAnim,
-        const aiScene* scene,
-        Animation& anim
-    );
+    SceneGraph mSceneGraph; // mTransform at ROOT_NODE, then the asset's nodes
+    SkinningBlend mSkinningBlend;
+    bool mVisible;
+    bool mPoseValid; // poses and palettes are at mAnimTime
+    bool mSkinValid; // CPU skinned streams match the palettes
+    bool mWorldBoundsValid;
+
+    // DrawCrowd scratch: palettes of every instance back to back, and
+    // the instance model matrices
+    std::vector<glm::mat4> mCrowdPalettes;
+    std::vector<DualQuat> mCrowdDualQuats; // BLEND_DUAL_QUAT only
+    std::vector<Aabb> mCrowdBounds; // per instance, model space
+    std::vector<glm::mat4> mCrowdModelMats;
+    std::vector<std::vector<glm::mat4>> mCrowdPoses; // per rig, every instance's global pose
+
+    // size the per instance state for mAsset
+    void init();
+    // pose every rig at mAnimTime
+    void computePoses( const bool skipLeafBones = false );
+    // palette of a mesh from the pose of its rig
     void ComputeMatrixPalette( const size_t mshIdx );
+    // advance the animation time; the pose goes stale
+    void advanceTime( const float dt );
+    // pose every rig and build every palette at mAnimTime. No GL calls,
+    // so instances can run on any thread. Returns false if there is no
+    // animation to play
+    bool updatePose( const bool skipLeafBones = false );
+    // bring a stale pose and skinned streams up to date
+    void refresh();
+    // bounds of the skinned meshes from their palettes
+    void updateBounds();
+    // bring the cached world transforms up to date after any move
+    void updateTransforms();
+    // model to world of a mesh; as of the last updateTransforms
+    const Affine& getMeshWorld( const size_t mshIdx ) const;
+    // true if the mesh has its own position stream skinned on the CPU
+    bool needsCpuSkinning( const size_t mshIdx ) const;
+    // skin vertices [begin,end) of a mesh with its current palette
+    void skinVertices(
+        const size_t mshIdx,
+        glm::vec3* outPositions,
+        const size_t begin,
+        const size_t end
+    ) const;
+    const VertexBuffer& getVertexBuffer( const size_t mshIdx ) const;
 };
 
 #endif
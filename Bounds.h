@@ -0,0 +1,81 @@
+#ifndef BOUNDS_H_INCLUDED
+#define BOUNDS_H_INCLUDED
+
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+// Axis aligned bounding box; starts out empty (min > max)
+struct Aabb
+{
+    glm::vec3 min;
+    glm::vec3 max;
+
+    inline Aabb() :
+        min(FLT_MAX,FLT_MAX,FLT_MAX),
+        max(-FLT_MAX,-FLT_MAX,-FLT_MAX)
+    {}
+
+    inline bool IsEmpty() const { return min.x > max.x; }
+    inline glm::vec3 GetCenter() const { return (min + max) * 0.5f; }
+    inline glm::vec3 GetExtents() const { return (max - min) * 0.5f; }
+
+    inline void Add( const glm::vec3& p ) {
+        min = glm::min( min, p );
+        max = glm::max( max, p );
+    }
+    inline void Add( const Aabb& other ) {
+        min = glm::min( min, other.min );
+        max = glm::max( max, other.max );
+    }
+
+    // box around this one after an affine transform
+    inline Aabb Transformed( const glm::mat4& mat ) const {
+        if ( IsEmpty() ) { return *this; }
+        const glm::vec3 center = glm::vec3( mat * glm::vec4( GetCenter(), 1.0f ));
+        const glm::vec3 extents = GetExtents();
+        glm::vec3 newExtents( 0.0f );
+        for ( int col=0; col<3; ++col ) {
+            newExtents += glm::abs( glm::vec3( mat[col] )) * extents[col];
+        }
+        Aabb result;
+        result.min = center - newExtents;
+        result.max = center + newExtents;
+        return result;
+    }
+};
+
+struct BoundingSphere
+{
+    glm::vec3 center;
+    float radius; // < 0 for an empty sphere
+
+    inline BoundingSphere() :
+        center(0.0f,0.0f,0.0f),
+        radius(-1.0f)
+    {}
+    inline BoundingSphere( const glm::vec3& c, const float r ) :
+        center(c),
+        radius(r)
+    {}
+    // sphere around a box; not the tightest, but free to build
+    inline explicit BoundingSphere( const Aabb& box ) :
+        center(box.GetCenter()),
+        radius(box.IsEmpty() ? -1.0f : glm::length( box.GetExtents() ))
+    {}
+
+    // sphere around this one after an affine transform; the radius is
+    // scaled by the largest axis scale
+    inline BoundingSphere Transformed( const glm::mat4& mat ) const {
+        const float scale = std::sqrt( std::max(
+            glm::dot( glm::vec3( mat[0] ), glm::vec3( mat[0] )), std::max(
+            glm::dot( glm::vec3( mat[1] ), glm::vec3( mat[1] )),
+            glm::dot( glm::vec3( mat[2] ), glm::vec3( mat[2] )))
+        ));
+        return BoundingSphere( glm::vec3( mat * glm::vec4( center, 1.0f )), radius * scale );
+    }
+};
+
+#endif // BOUNDS_H_INCLUDED
@@ -0,0 +1,328 @@
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+#include "EntityStore.h"
+#include "Renderer.h"
+#include "ThreadPool.h"
+
+const Entity EntityStore::INVALID_ENTITY = { 0xFFFFFFFF, 0 };
+
+EntityStore::EntityStore() :
+    mAnyTransformDirty(false)
+{
+    const AnimMesh noMesh = { nullptr, 0, 0.0f };
+    mAnimMeshes.push_back( noMesh ); // NO_ANIM_MESH
+}
+
+Entity EntityStore::Create( const Transform& transform, const Aabb& localBounds, const RenderHandle& render )
+{
+    assert( render.vertBuf == nullptr || render.crowdMesh == nullptr );
+
+    uint32_t slotIdx;
+    if ( !mFreeSlots.empty() ) {
+        slotIdx = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    } else {
+        slotIdx = (uint32_t)mSlots.size();
+        Slot slot = { NO_DENSE_INDEX, 0 };
+        mSlots.push_back( slot );
+    }
+    const uint32_t dense = (uint32_t)mDenseToSlot.size();
+    mSlots[slotIdx].dense = dense;
+    mDenseToSlot.push_back( slotIdx );
+
+    mPositions.push_back( transform.position );
+    mRotations.push_back( transform.rotation );
+    mScales.push_back( transform.scale );
+    mTransformDirty.push_back( 0 );
+    mLocalBounds.push_back( localBounds );
+    mWorldMats.push_back( glm::mat4( 1.0f ));
+    mWorldSpheres.push_back( glm::vec4( 0.0f, 0.0f, 0.0f, -1.0f ));
+    mVisible.push_back( 1 );
+    mAnimTimes.push_back( 0.0f );
+    mAnimPlayRates.push_back( 1.0f );
+    mAnimMeshIdxs.push_back( render.crowdMesh ? addAnimMeshRef( render.crowdMesh ) : NO_ANIM_MESH );
+    mRenders.push_back( render );
+    // world bounds right away, so it can be culled before the next
+    // UpdateTransforms
+    updateWorld( dense );
+
+    const Entity entity = { slotIdx, mSlots[slotIdx].generation };
+    return entity;
+}
+
+void EntityStore::Destroy( const Entity entity )
+{
+    const uint32_t dense = denseIndex( entity );
+    if ( dense == NO_DENSE_INDEX ) { return; }
+
+    // last entity of its crowd mesh; don't query the mesh after it's gone
+    const uint32_t animMeshIdx = mAnimMeshIdxs[dense];
+    if ( animMeshIdx != NO_ANIM_MESH && --mAnimMeshes[animMeshIdx].numEntities == 0 ) {
+        mAnimMeshes[animMeshIdx].mesh = nullptr;
+    }
+
+    // move the last entity into the hole so the arrays stay packed
+    const uint32_t last = (uint32_t)mDenseToSlot.size() - 1;
+    if ( dense != last ) {
+        mDenseToSlot[dense] = mDenseToSlot[last];
+        mSlots[mDenseToSlot[dense]].dense = dense;
+        mPositions[dense] = mPositions[last];
+        mRotations[dense] = mRotations[last];
+        mScales[dense] = mScales[last];
+        mTransformDirty[dense] = mTransformDirty[last];
+        mLocalBounds[dense] = mLocalBounds[last];
+        mWorldMats[dense] = mWorldMats[last];
+        mWorldSpheres[dense] = mWorldSpheres[last];
+        mVisible[dense] = mVisible[last];
+        mAnimTimes[dense] = mAnimTimes[last];
+        mAnimPlayRates[dense] = mAnimPlayRates[last];
+        mAnimMeshIdxs[dense] = mAnimMeshIdxs[last];
+        mRenders[dense] = mRenders[last];
+    }
+    mDenseToSlot.pop_back();
+    mPositions.pop_back();
+    mRotations.pop_back();
+    mScales.pop_back();
+    mTransformDirty.pop_back();
+    mLocalBounds.pop_back();
+    mWorldMats.pop_back();
+    mWorldSpheres.pop_back();
+    mVisible.pop_back();
+    mAnimTimes.pop_back();
+    mAnimPlayRates.pop_back();
+    mAnimMeshIdxs.pop_back();
+    mRenders.pop_back();
+
+    // new generation, so existing handles to the slot go stale
+    Slot& slot = mSlots[entity.index];
+    slot.dense = NO_DENSE_INDEX;
+    ++slot.generation;
+    mFreeSlots.push_back( entity.index );
+}
+
+bool EntityStore::IsAlive( const Entity entity ) const
+{
+    return denseIndex( entity ) != NO_DENSE_INDEX;
+}
+
+void EntityStore::SetPosition( const Entity entity, const glm::vec3& pos )
+{
+    const uint32_t dense = denseIndex( entity );
+    if ( dense == NO_DENSE_INDEX ) { return; }
+    mPositions[dense] = pos;
+    markMoved( dense );
+}
+void EntityStore::SetRotation( const Entity entity, const glm::quat& rot )
+{
+    const uint32_t dense = denseIndex( entity );
+    if ( dense == NO_DENSE_INDEX ) { return; }
+    mRotations[dense] = rot;
+    markMoved( dense );
+}
+void EntityStore::SetScale( const Entity entity, const glm::vec3& scl )
+{
+    const uint32_t dense = denseIndex( entity );
+    if ( dense == NO_DENSE_INDEX ) { return; }
+    mScales[dense] = scl;
+    markMoved( dense );
+}
+void EntityStore::SetTransform( const Entity entity, const Transform& transform )
+{
+    const uint32_t dense = denseIndex( entity );
+    if ( dense == NO_DENSE_INDEX ) { return; }
+    mPositions[dense] = transform.position;
+    mRotations[dense] = transform.rotation;
+    mScales[dense] = transform.scale;
+    markMoved( dense );
+}
+
+Transform EntityStore::GetTransform( const Entity entity ) const
+{
+    Transform transform;
+    const uint32_t dense = denseIndex( entity );
+    if ( dense == NO_DENSE_INDEX ) { return transform; }
+    transform.position = mPositions[dense];
+    transform.rotation = mRotations[dense];
+    transform.scale = mScales[dense];
+    return transform;
+}
+
+void EntityStore::SetAnimation( const Entity entity, const float time, const float playRate )
+{
+    const uint32_t dense = denseIndex( entity );
+    if ( dense == NO_DENSE_INDEX ) { return; }
+    mAnimTimes[dense] = time;
+    mAnimPlayRates[dense] = playRate;
+}
+
+bool EntityStore::IsVisible( const Entity entity ) const
+{
+    const uint32_t dense = denseIndex( entity );
+    return dense != NO_DENSE_INDEX && mVisible[dense] != 0;
+}
+
+void EntityStore::UpdateTransforms()
+{
+    if ( !mAnyTransformDirty ) { return; }
+    ThreadPool::GetInstance()->ParallelFor(
+        mDenseToSlot.size(),
+        TRANSFORM_CHUNK_SIZE,
+        [this]( size_t begin, size_t end ) {
+            for ( size_t i=begin; i<end; ++i ) {
+                if ( !mTransformDirty[i] ) { continue; }
+                updateWorld( i );
+                mTransformDirty[i] = 0;
+            }
+        }
+    );
+    mAnyTransformDirty = false;
+}
+
+size_t EntityStore::Cull( const Frustum& frustum, const OcclusionCuller* occlusion )
+{
+    // moved entities would be tested at their old place
+    assert( !mAnyTransformDirty );
+    size_t numVisible = frustum.CullSpheres( mWorldSpheres.data(), mWorldSpheres.size(), mVisible.data() );
+    if ( occlusion == nullptr ) { return numVisible; }
+
+    mOcclusionBoxes.clear();
+    mOcclusionEntities.clear();
+    for ( size_t i=0; i<mVisible.size(); ++i ) {
+        if ( !mVisible[i] ) { continue; }
+        mOcclusionBoxes.push_back( mLocalBounds[i].Transformed( mWorldMats[i] ));
+        mOcclusionEntities.push_back( uint32_t( i ));
+    }
+    mOcclusionVisible.resize( mOcclusionBoxes.size() );
+    numVisible = occlusion->CullBoxes( mOcclusionBoxes.data(), mOcclusionBoxes.size(), mOcclusionVisible.data() );
+    for ( size_t i=0; i<mOcclusionEntities.size(); ++i ) {
+        mVisible[mOcclusionEntities[i]] = mOcclusionVisible[i];
+    }
+    return numVisible;
+}
+
+void EntityStore::UpdateAnimation( const float dt )
+{
+    // the clip may have changed since the last update (AssimpMesh::SetAnim)
+    for ( AnimMesh& animMesh : mAnimMeshes ) {
+        animMesh.animLength = animMesh.mesh ? animMesh.mesh->GetCurAnimLength() : 0.0f;
+    }
+
+    for ( size_t i=0; i<mAnimTimes.size(); ++i ) {
+        const float length = mAnimMeshes[mAnimMeshIdxs[i]].animLength;
+        float time = mAnimTimes[i] + dt * mAnimPlayRates[i];
+        // keep the clock small so it doesn't lose precision over time
+        if ( length > 0.0f && (time >= length || time < 0.0f) ) {
+            time = fmodf( time, length );
+            if ( time < 0.0f ) { time += length; }
+        }
+        mAnimTimes[i] = time;
+    }
+}
+
+void EntityStore::Draw()
+{
+    // group the visible entities by what they draw
+    mDrawOrder.clear();
+    for ( size_t i=0; i<mVisible.size(); ++i ) {
+        const bool drawn = mRenders[i].vertBuf || mRenders[i].crowdMesh;
+        if ( mVisible[i] && drawn ) { mDrawOrder.push_back( uint32_t( i )); }
+    }
+    std::sort(
+        mDrawOrder.begin(),
+        mDrawOrder.end(),
+        [this]( uint32_t a, uint32_t b ) {
+            const RenderHandle& renderA = mRenders[a];
+            const RenderHandle& renderB = mRenders[b];
+            if ( renderA.crowdMesh != renderB.crowdMesh ) { return renderA.crowdMesh < renderB.crowdMesh; }
+            if ( renderA.vertBuf != renderB.vertBuf ) { return renderA.vertBuf < renderB.vertBuf; }
+            if ( renderA.texture != renderB.texture ) { return renderA.texture < renderB.texture; }
+            return a < b;
+        }
+    );
+
+    // one draw per run of equal render handles
+    Renderer* rndr = Renderer::GetInstance();
+    size_t runStart = 0;
+    while ( runStart < mDrawOrder.size() )
+    {
+        const RenderHandle& render = mRenders[mDrawOrder[runStart]];
+        size_t runEnd = runStart + 1;
+        while ( runEnd < mDrawOrder.size() ) {
+            const RenderHandle& other = mRenders[mDrawOrder[runEnd]];
+            if ( other.crowdMesh != render.crowdMesh ||
+                 other.vertBuf != render.vertBuf ||
+                 other.texture != render.texture ) {
+                break;
+            }
+            ++runEnd;
+        }
+
+        if ( render.crowdMesh ) {
+            mDrawCrowdInstances.resize( runEnd - runStart );
+            for ( size_t i=runStart; i<runEnd; ++i ) {
+                AssimpMesh::CrowdInstance& inst = mDrawCrowdInstances[i - runStart];
+                inst.modelMat = mWorldMats[mDrawOrder[i]];
+                inst.animTime = mAnimTimes[mDrawOrder[i]];
+            }
+            render.crowdMesh->DrawCrowd( mDrawCrowdInstances.data(), mDrawCrowdInstances.size() );
+        } else {
+            mDrawModelMats.resize( runEnd - runStart );
+            for ( size_t i=runStart; i<runEnd; ++i ) {
+                mDrawModelMats[i - runStart] = mWorldMats[mDrawOrder[i]];
+            }
+            if ( render.texture ) {
+                rndr->SetTexture( *render.texture );
+            }
+            rndr->DrawVertexBufferInstanced( mDrawModelMats.data(), mDrawModelMats.size(), *render.vertBuf );
+        }
+        runStart = runEnd;
+    }
+}
+
+uint32_t EntityStore::denseIndex( const Entity entity ) const
+{
+    if ( entity.index >= mSlots.size() ) { return NO_DENSE_INDEX; }
+    const Slot& slot = mSlots[entity.index];
+    if ( slot.generation != entity.generation ) { return NO_DENSE_INDEX; }
+    return slot.dense;
+}
+
+void EntityStore::markMoved( const uint32_t dense )
+{
+    mTransformDirty[dense] = 1;
+    mAnyTransformDirty = true;
+}
+
+void EntityStore::updateWorld( const size_t dense )
+{
+    Transform transform;
+    transform.position = mPositions[dense];
+    transform.rotation = mRotations[dense];
+    transform.scale = mScales[dense];
+    mWorldMats[dense] = transform.ToMat4();
+    const BoundingSphere sphere = BoundingSphere( mLocalBounds[dense] ).Transformed( mWorldMats[dense] );
+    mWorldSpheres[dense] = glm::vec4( sphere.center, sphere.radius );
+}
+
+uint32_t EntityStore::addAnimMeshRef( AssimpMesh* mesh )
+{
+    uint32_t freeIdx = NO_ANIM_MESH;
+    for ( uint32_t i=NO_ANIM_MESH + 1; i<mAnimMeshes.size(); ++i ) {
+        if ( mAnimMeshes[i].mesh == mesh ) {
+            ++mAnimMeshes[i].numEntities;
+            return i;
+        }
+        if ( mAnimMeshes[i].mesh == nullptr && freeIdx == NO_ANIM_MESH ) {
+            freeIdx = i;
+        }
+    }
+    const AnimMesh animMesh = { mesh, 1, mesh->GetCurAnimLength() };
+    if ( freeIdx != NO_ANIM_MESH ) {
+        mAnimMeshes[freeIdx] = animMesh;
+        return freeIdx;
+    }
+    mAnimMeshes.push_back( animMesh );
+    return uint32_t( mAnimMeshes.size() - 1 );
+}
@@ -0,0 +1,143 @@
+#ifndef ENTITY_STORE_H_INCLUDED
+#define ENTITY_STORE_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Transform.h"
+#include "Bounds.h"
+#include "Frustum.h"
+#include "OcclusionCuller.h"
+#include "VertexBuffer.h"
+#include "Texture.h"
+#include "AssimpMesh.h"
+
+// Handle to an entity of an EntityStore. Goes stale when the entity is
+// destroyed, even if its slot is reused by a newer entity
+struct Entity
+{
+    uint32_t index; // slot in the store
+    uint32_t generation; // of the slot when the entity was created
+};
+
+/* Lightweight renderables for scenes of thousands of instances. Instead
+ * of one object per instance, every component lives in its own densely
+ * packed array, and each system streams through only the arrays it
+ * needs:
+ *  UpdateTransforms: transforms -> world matrices and bounds
+ *  Cull:             world bounds -> visibility, in one batch
+ *  UpdateAnimation:  animation clocks
+ *  Draw:             visible entities -> one instanced draw per mesh
+ * Entities are swapped to keep the arrays dense when one is destroyed,
+ * so they are referred to by generational handles rather than index */
+class EntityStore
+{
+public:
+
+    // What an entity draws; at most one of vertBuf and crowdMesh is set,
+    // neither for entities that aren't drawn
+    struct RenderHandle
+    {
+        const VertexBuffer* vertBuf; // static POS_TEXCOORD mesh
+        const Texture* texture; // for vertBuf; may be null
+        AssimpMesh* crowdMesh; // SKINNING_GPU mesh, drawn with AssimpMesh::DrawCrowd
+    };
+
+    static const Entity INVALID_ENTITY;
+
+    EntityStore();
+
+    // localBounds are in model space; for crowd meshes they should cover
+    // every pose
+    Entity Create( const Transform& transform, const Aabb& localBounds, const RenderHandle& render );
+    void Destroy( const Entity entity );
+    bool IsAlive( const Entity entity ) const;
+    size_t GetNumEntities() const { return mDenseToSlot.size(); }
+
+    void SetPosition( const Entity entity, const glm::vec3& pos );
+    void SetRotation( const Entity entity, const glm::quat& rot );
+    void SetScale   ( const Entity entity, const glm::vec3& scl );
+    void SetTransform( const Entity entity, const Transform& transform );
+    Transform GetTransform( const Entity entity ) const;
+    // time is seconds into the crowd mesh's current animation
+    void SetAnimation( const Entity entity, const float time, const float playRate = 1.0f );
+    // as of the last Cull
+    bool IsVisible( const Entity entity ) const;
+
+    // Rebuild the world matrix and bounds of every moved entity
+    void UpdateTransforms();
+    // Test the world bounds of every entity against the frustum, then the
+    // visible ones against the occluders if given. Entities moved since
+    // the last UpdateTransforms aren't allowed. Returns the number visible
+    size_t Cull( const Frustum& frustum, const OcclusionCuller* occlusion = nullptr );
+    // Advance the animation clocks of every entity, wrapped to the length
+    // of its crowd mesh's current clip
+    void UpdateAnimation( const float dt );
+    // Queue the visible entities; one instanced draw per vertex buffer and
+    // texture, and one DrawCrowd per crowd mesh. Call from the GL thread
+    void Draw();
+
+private:
+
+    // min number of entities per worker thread job
+    static const size_t TRANSFORM_CHUNK_SIZE = 256;
+    static const uint32_t NO_DENSE_INDEX = 0xFFFFFFFF;
+    // mAnimMeshes entry of entities without a crowd mesh
+    static const uint32_t NO_ANIM_MESH = 0;
+
+    struct Slot
+    {
+        uint32_t dense; // index into the component arrays; NO_DENSE_INDEX if free
+        uint32_t generation;
+    };
+    std::vector<Slot> mSlots;
+    std::vector<uint32_t> mFreeSlots;
+    std::vector<uint32_t> mDenseToSlot;
+
+    // components, one entry per entity
+    std::vector<glm::vec3> mPositions;
+    std::vector<glm::quat> mRotations;
+    std::vector<glm::vec3> mScales;
+    std::vector<uint8_t> mTransformDirty;
+    std::vector<Aabb> mLocalBounds;
+    std::vector<glm::mat4> mWorldMats;
+    std::vector<glm::vec4> mWorldSpheres; // center, radius; what Frustum::CullSpheres takes
+    std::vector<uint8_t> mVisible;
+    std::vector<float> mAnimTimes;
+    std::vector<float> mAnimPlayRates;
+    std::vector<uint32_t> mAnimMeshIdxs; // into mAnimMeshes
+    std::vector<RenderHandle> mRenders;
+    bool mAnyTransformDirty;
+
+    // crowd meshes in use, so each clip length is read once per update
+    // however many entities share the mesh
+    struct AnimMesh
+    {
+        AssimpMesh* mesh; // null once no entity uses it
+        size_t numEntities;
+        float animLength; // as of the last UpdateAnimation
+    };
+    std::vector<AnimMesh> mAnimMeshes;
+
+    // per frame scratch
+    std::vector<Aabb> mOcclusionBoxes; // world bounds of frustum visible entities
+    std::vector<uint32_t> mOcclusionEntities; // their dense index
+    std::vector<uint8_t> mOcclusionVisible;
+    std::vector<uint32_t> mDrawOrder; // visible dense indices grouped by render handle
+    std::vector<glm::mat4> mDrawModelMats;
+    std::vector<AssimpMesh::CrowdInstance> mDrawCrowdInstances;
+
+    // dense index of a live entity; NO_DENSE_INDEX for a stale handle
+    uint32_t denseIndex( const Entity entity ) const;
+    // mark the transform of a dense index changed
+    void markMoved( const uint32_t dense );
+    // world matrix and sphere of a dense index from its transform
+    void updateWorld( const size_t dense );
+    // mAnimMeshes entry of a crowd mesh, added if new
+    uint32_t addAnimMeshRef( AssimpMesh* mesh );
+};
+
+#endif // ENTITY_STORE_H_INCLUDED
@@ -0,0 +1,87 @@
+#include "Frustum.h"
+#include "Simd.h"
+
+Frustum::Frustum()
+{
+    for ( int i=0; i<NUM_PLANES; ++i ) {
+        mPlanes[i] = glm::vec4( 0.0f, 0.0f, 0.0f, 1.0f );
+    }
+}
+
+Frustum::Frustum( const glm::mat4& viewProj )
+{
+    // Gribb/Hartmann: each plane is the w row of the matrix plus or
+    // minus one of the others (glm matrices are column major)
+    glm::vec4 rows[4];
+    for ( int i=0; i<4; ++i ) {
+        rows[i] = glm::vec4( viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i] );
+    }
+    mPlanes[PLANE_LEFT]   = rows[3] + rows[0];
+    mPlanes[PLANE_RIGHT]  = rows[3] - rows[0];
+    mPlanes[PLANE_BOTTOM] = rows[3] + rows[1];
+    mPlanes[PLANE_TOP]    = rows[3] - rows[1];
+    mPlanes[PLANE_NEAR]   = rows[3] + rows[2];
+    mPlanes[PLANE_FAR]    = rows[3] - rows[2];
+    // unit normals so plane distances compare to sphere radii
+    for ( int i=0; i<NUM_PLANES; ++i ) {
+        mPlanes[i] /= glm::length( glm::vec3( mPlanes[i] ));
+    }
+}
+
+bool Frustum::IsVisible( const BoundingSphere& sphere ) const
+{
+    for ( int i=0; i<NUM_PLANES; ++i ) {
+        const float dist = glm::dot( glm::vec3( mPlanes[i] ), sphere.center ) + mPlanes[i].w;
+        if ( dist < -sphere.radius ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t Frustum::CullSpheres( const glm::vec4* spheres, const size_t count, uint8_t* outVisible ) const
+{
+    size_t numVisible = 0;
+    size_t i = 0;
+#ifdef SIMD_SSE2
+    __m128 planeX[NUM_PLANES], planeY[NUM_PLANES], planeZ[NUM_PLANES], planeW[NUM_PLANES];
+    for ( int p=0; p<NUM_PLANES; ++p ) {
+        planeX[p] = _mm_set1_ps( mPlanes[p].x );
+        planeY[p] = _mm_set1_ps( mPlanes[p].y );
+        planeZ[p] = _mm_set1_ps( mPlanes[p].z );
+        planeW[p] = _mm_set1_ps( mPlanes[p].w );
+    }
+    const __m128 signBit = _mm_set1_ps( -0.0f );
+    for ( ; i + 4 <= count; i += 4 )
+    {
+        // 4 spheres to x,y,z,radius vectors
+        __m128 x = _mm_loadu_ps( &spheres[i + 0].x );
+        __m128 y = _mm_loadu_ps( &spheres[i + 1].x );
+        __m128 z = _mm_loadu_ps( &spheres[i + 2].x );
+        __m128 r = _mm_loadu_ps( &spheres[i + 3].x );
+        _MM_TRANSPOSE4_PS( x, y, z, r );
+        const __m128 negR = _mm_xor_ps( r, signBit );
+
+        __m128 inside = _mm_castsi128_ps( _mm_set1_epi32( -1 ));
+        for ( int p=0; p<NUM_PLANES; ++p ) {
+            __m128 dist = _mm_add_ps( _mm_mul_ps( x, planeX[p] ), planeW[p] );
+            dist = _mm_add_ps( dist, _mm_mul_ps( y, planeY[p] ));
+            dist = _mm_add_ps( dist, _mm_mul_ps( z, planeZ[p] ));
+            inside = _mm_and_ps( inside, _mm_cmpge_ps( dist, negR ));
+        }
+
+        const int mask = _mm_movemask_ps( inside );
+        for ( int lane=0; lane<4; ++lane ) {
+            const uint8_t visible = (mask >> lane) & 1;
+            outVisible[i + lane] = visible;
+            numVisible += visible;
+        }
+    }
+#endif
+    for ( ; i<count; ++i ) {
+        const BoundingSphere sphere( glm::vec3( spheres[i] ), spheres[i].w );
+        outVisible[i] = IsVisible( sphere ) ? 1 : 0;
+        numVisible += outVisible[i];
+    }
+    return numVisible;
+}
@@ -0,0 +1,42 @@
+#ifndef FRUSTUM_H_INCLUDED
+#define FRUSTUM_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+// The 6 clip planes of a camera, for culling bounding spheres
+class Frustum
+{
+public:
+
+    // planes that contain everything
+    Frustum();
+    // planes of a projection * view matrix, in world space
+    explicit Frustum( const glm::mat4& viewProj );
+
+    bool IsVisible( const BoundingSphere& sphere ) const;
+
+    /**
+     * @brief Test many spheres at once, 4 per SIMD step
+     *
+     * @param spheres center in xyz and radius in w; an infinite radius
+     *      is never culled
+     * @param count number of spheres
+     * @param outVisible set to 1 for each sphere that intersects the
+     *      frustum, 0 for culled ones
+     * @return the number of visible spheres
+     */
+    size_t CullSpheres( const glm::vec4* spheres, const size_t count, uint8_t* outVisible ) const;
+
+private:
+
+    enum Plane { PLANE_LEFT, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR, NUM_PLANES };
+    // xyz = unit normal pointing inside, w = distance
+    glm::vec4 mPlanes[NUM_PLANES];
+};
+
+#endif // FRUSTUM_H_INCLUDED
@@ -0,0 +1,1443 @@
+#include "ModelAsset.h"
+#include "Simd.h"
+
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+static inline glm::mat4 aiMatToMat4( const aiMatrix4x4& mat )
+{
+    // a,b,c,d = row; 1,2,3,4 = col
+    float vals[16] = {
+        mat.a1, mat.b1, mat.c1, mat.d1,
+        mat.a2, mat.b2, mat.c2, mat.d2,
+        mat.a3, mat.b3, mat.c3, mat.d3,
+        mat.a4, mat.b4, mat.c4, mat.d4
+    };
+    return glm::make_mat4( vals );
+}
+
+std::unordered_map<std::string, std::weak_ptr<const ModelAsset>> ModelAsset::sCache;
+
+std::shared_ptr<const ModelAsset> ModelAsset::Get(
+    const std::string& fileName,
+    SkinningMode skinningMode,
+    const AnimCompression& animCompression )
+{
+    // every setting changes what's loaded, so they're all part of the key
+    const std::string key = fileName +
+        "|" + std::to_string( int( skinningMode )) +
+        "|" + std::to_string( animCompression.posTolerance ) +
+        "|" + std::to_string( animCompression.rotTolerance ) +
+        "|" + std::to_string( animCompression.sclTolerance );
+    std::shared_ptr<const ModelAsset> asset = sCache[key].lock();
+    if ( !asset ) {
+        asset = std::make_shared<const ModelAsset>( fileName, skinningMode, animCompression );
+        sCache[key] = asset;
+    }
+    return asset;
+}
+
+ModelAsset::ModelAsset(
+    const std::string& fileName,
+    SkinningMode skinningMode,
+    const AnimCompression& animCompression ) :
+    mFileName(fileName),
+    mSkinningMode(skinningMode)
+{
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(
+        fileName.c_str(),
+        aiProcess_Triangulate |
+        aiProcess_GenSmoothNormals
+    );
+    if ( !scene ||
+            (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) ||
+            !scene->mRootNode ) {
+        std::cerr << "ModelAsset::Load readfile failed: " <<
+            importer.GetErrorString() << std::endl;
+        exit( EXIT_FAILURE );
+    }
+    mMeshes.resize( scene->mNumMeshes );
+    mMeshSkins.resize( scene->mNumMeshes );
+    mMeshNodes.resize( scene->mNumMeshes, 0 );
+    size_t curMesh = 0;
+    if ( !processNode( scene->mRootNode, scene, SceneGraph::NO_PARENT, curMesh )) {
+        std::cerr << "ModelAsset::Load failed to load meshes" << std::endl;
+        exit( EXIT_FAILURE );
+    }
+    mSceneGraph.UpdateWorldTransforms();
+
+    mAnimations.resize( mSkeletons.size() );
+    mAnimNames.resize( scene->mNumAnimations );
+    for ( size_t i=0; i<scene->mNumAnimations; ++i ) {
+        mAnimNames[i] = std::string( scene->mAnimations[i]->mName.C_Str() );
+    }
+    if ( mAnimNames.size() == 1 && mAnimNames[0].empty() ) {
+        mAnimNames[0] = "animation0";
+    }
+    for ( size_t skelIdx=0; skelIdx<mSkeletons.size(); ++skelIdx ) {
+        mAnimations[skelIdx].resize( scene->mNumAnimations );
+        for ( size_t i=0; i<scene->mNumAnimations; ++i ) {
+            Animation& anim = mAnimations[skelIdx][i];
+            if ( !anim.Load( scene->mAnimations[i], scene, &mSkeletons[skelIdx], animCompression )) {
+                std::cerr << "ModelAsset::Load failed to process animation" << std::endl;
+                exit( EXIT_FAILURE );
+            }
+            anim.SetName( mAnimNames[i] );
+        }
+    }
+
+    std::cout << "Loaded Assimp Mesh " << fileName << std::endl;
+    std::cout << "  Num Meshes: " << mMeshes.size() << std::endl;
+    std::cout << "  Skeletons: " << mSkeletons.size() << std::endl;
+    std::cout << "  Animations: " << mAnimNames.size() << std::endl;
+    for ( size_t i=0; i<mAnimNames.size(); ++i ) {
+        // compression report, over every rig
+        size_t rawBytes = 0;
+        size_t compressedBytes = 0;
+        float maxPosError = 0.0f;
+        float maxRotError = 0.0f;
+        float maxSclError = 0.0f;
+        for ( size_t skelIdx=0; skelIdx<mAnimations.size(); ++skelIdx ) {
+            const Animation::CompressionStats& stats = mAnimations[skelIdx][i].GetCompressionStats();
+            rawBytes += stats.rawBytes;
+            compressedBytes += stats.compressedBytes;
+            maxPosError = std::max( maxPosError, stats.maxPosError );
+            maxRotError = std::max( maxRotError, stats.maxRotError );
+            maxSclError = std::max( maxSclError, stats.maxSclError );
+        }
+        std::cout << "    " << mAnimNames[i] << ": "
+                  << rawBytes << " -> " << compressedBytes << " bytes, max bone error pos "
+                  << maxPosError << " rot " << maxRotError << " scl " << maxSclError << std::endl;
+    }
+}
+
+bool ModelAsset::processNode(
+    const aiNode* node,
+    const aiScene* scene,
+    const int parentNode,
+    size_t& curMesh
+)
+{
+    const size_t graphNode = mSceneGraph.AddNode(
+        parentNode,
+        Affine( aiMatToMat4( node->mTransformation )),
+        std::string( node->mName.C_Str() )
+    );
+
+    // process all the node's meshes (if any)
+    for ( size_t i=0; i<node->mNumMeshes; ++i ) {
+        const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+        assert( curMesh < mMeshes.size() );
+        // skeleton first; it decides the order of the vertex bone indices
+        Skeleton meshSkeleton;
+        if ( !meshSkeleton.Load( mesh, scene )) {
+            return false;
+        }
+        if ( !mMeshes[curMesh].Load( mesh, scene, mSkinningMode, meshSkeleton.GetBoneRemap() )) {
+            return false;
+        }
+        assert( curMesh < mMeshSkins.size() );
+        addMeshSkeleton( meshSkeleton, scene, mMeshSkins[curMesh] );
+        mMeshNodes[curMesh] = uint32_t( graphNode );
+        ++curMesh;
+    }
+
+    // process the node's children
+    for ( size_t i=0; i<node->mNumChildren; ++i ) {
+        if ( !processNode( node->mChildren[i], scene, int( graphNode ), curMesh )) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// true if the skeletons have a bone in common
+static bool sharesBone( const ModelAsset::Skeleton& a, const ModelAsset::Skeleton& b )
+{
+    for ( const ModelAsset::Skeleton::Bone& bone : b.GetBones() ) {
+        if ( a.FindBone( bone.mName ) >= 0 ) { return true; }
+    }
+    return false;
+}
+
+void ModelAsset::addMeshSkeleton( const Skeleton& meshSkeleton, const aiScene* scene, MeshSkin& outSkin )
+{
+    outSkin.skeletonIdx = NO_SKELETON;
+    outSkin.boneMap.clear();
+    outSkin.invBindPoses = meshSkeleton.GetGlobalInvBindPoses();
+    const size_t numBones = meshSkeleton.GetNumBones();
+    if ( numBones == 0 ) { return; }
+
+    // bones shared between rigs mean they are parts of one hierarchy, so
+    // the new bones go into the first rig they overlap, along with any
+    // other rig they connect it to. Every mesh of a hierarchy then ends
+    // up on one rig whatever order the meshes load in
+    size_t rigIdx = NO_SKELETON;
+    std::vector<uint32_t> remap;
+    for ( size_t skelIdx=0; skelIdx<mSkeletons.size(); )
+    {
+        if ( !sharesBone( mSkeletons[skelIdx], meshSkeleton )) {
+            ++skelIdx;
+            continue;
+        }
+        if ( rigIdx == NO_SKELETON ) {
+            rigIdx = skelIdx;
+            ++skelIdx;
+            continue;
+        }
+        mSkeletons[rigIdx].Merge( mSkeletons[skelIdx], scene, remap );
+        remapRig( rigIdx, remap );
+        // move the merged rig's meshes over; later rigs shift down
+        for ( MeshSkin& skin : mMeshSkins ) {
+            if ( skin.boneMap.empty() ) { continue; }
+            if ( skin.skeletonIdx == skelIdx ) {
+                for ( uint32_t& bone : skin.boneMap ) {
+                    bone = uint32_t( mSkeletons[rigIdx].FindBone( mSkeletons[skelIdx].GetBone( bone ).mName ));
+                }
+                skin.skeletonIdx = rigIdx;
+            } else if ( skin.skeletonIdx > skelIdx && skin.skeletonIdx != NO_SKELETON ) {
+                --skin.skeletonIdx;
+            }
+        }
+        mSkeletons.erase( mSkeletons.begin() + skelIdx );
+    }
+
+    if ( rigIdx == NO_SKELETON ) {
+        rigIdx = mSkeletons.size();
+        mSkeletons.push_back( meshSkeleton );
+    } else {
+        mSkeletons[rigIdx].Merge( meshSkeleton, scene, remap );
+        remapRig( rigIdx, remap );
+    }
+    outSkin.skeletonIdx = rigIdx;
+    outSkin.boneMap.resize( numBones );
+    for ( size_t i=0; i<numBones; ++i ) {
+        outSkin.boneMap[i] = uint32_t( mSkeletons[rigIdx].FindBone( meshSkeleton.GetBone( i ).mName ));
+    }
+}
+
+void ModelAsset::remapRig( const size_t skelIdx, const std::vector<uint32_t>& remap )
+{
+    // vertex bone indices address the mesh palette, which reaches the
+    // rig through boneMap, so only the maps change
+    for ( MeshSkin& skin : mMeshSkins ) {
+        if ( skin.skeletonIdx != skelIdx || skin.boneMap.empty() ) { continue; }
+        for ( uint32_t& bone : skin.boneMap ) {
+            bone = remap[bone];
+        }
+    }
+}
+
+int ModelAsset::Skeleton::FindBone( const std::string& name ) const
+{
+    for ( size_t i=0; i<mBones.size(); ++i ) {
+        if ( mBones[i].mName == name ) {
+            return int( i );
+        }
+    }
+    return -1;
+}
+
+// Mesh functions
+ModelAsset::Mesh::Mesh() :
+    mGpuSkinned(false)
+{}
+ModelAsset::Mesh::~Mesh()
+{}
+
+bool ModelAsset::Mesh::Load(
+    const aiMesh* mesh,
+    const aiScene* scene,
+    SkinningMode skinningMode,
+    const std::vector<uint32_t>& boneRemap
+)
+{
+    const aiMesh* assimpMesh = mesh;
+
+    mVertices.resize( assimpMesh->mNumVertices );
+    mBoneIndices.resize( assimpMesh->mNumVertices );
+    mBoneWeights.resize( assimpMesh->mNumVertices );
+    std::vector<unsigned int> boneWeightCounters( assimpMesh->mNumVertices, 0 );
+
+    for (size_t i=0; i<assimpMesh->mNumVertices; ++i) {
+        mVertices[i].x = assimpMesh->mVertices[i].x;
+        mVertices[i].y = assimpMesh->mVertices[i].y;
+        mVertices[i].z = assimpMesh->mVertices[i].z;
+        mVertices[i].nx = assimpMesh->mNormals[i].x;
+        mVertices[i].ny = assimpMesh->mNormals[i].y;
+        mVertices[i].nz = assimpMesh->mNormals[i].z;
+        if ( assimpMesh->mTextureCoords[0] ) {
+            mVertices[i].u = assimpMesh->mTextureCoords[0][i].x;
+            mVertices[i].v = assimpMesh->mTextureCoords[0][i].y;
+        } else {
+            mVertices[i].u = mVertices[i].v = 0.0f;
+        }
+
+        // default all bone indices to 0
+        mBoneIndices[i].idx0 = 0;
+        mBoneIndices[i].idx1 = 0;
+        mBoneIndices[i].idx2 = 0;
+        mBoneIndices[i].idx3 = 0;
+
+        // default all weights to 0
+        mBoneWeights[i].weight0 = 0.0f;
+        mBoneWeights[i].weight1 = 0.0f;
+        mBoneWeights[i].weight2 = 0.0f;
+        mBoneWeights[i].weight3 = 0.0f;
+    }
+
+    for ( size_t i=0; i<assimpMesh->mNumBones; ++i ) {
+        const aiBone* bone = assimpMesh->mBones[i];
+        const uint32_t boneIdx = boneRemap[i];
+
+        // get weights/indices
+        for ( size_t j=0; j<bone->mNumWeights; ++j ) {
+            const aiVertexWeight& weight = bone->mWeights[j];
+            // index of the vertex which is influenced by the bone
+            const unsigned int vertIndex = weight.mVertexId;
+            assert( vertIndex < mVertices.size() );
+            // zero weights contribute nothing; keep them out of the used
+            // slots so the influence count below is the real one
+            if ( weight.mWeight == 0.0f ) { continue; }
+            switch ( boneWeightCounters[vertIndex] )
+            {
+            case 0:
+                mBoneWeights[vertIndex].weight0 = weight.mWeight;
+                mBoneIndices[vertIndex].idx0 = boneIdx;
+                break;
+            case 1:
+                mBoneWeights[vertIndex].weight1 = weight.mWeight;
+                mBoneIndices[vertIndex].idx1 = boneIdx;
+                break;
+            case 2:
+                mBoneWeights[vertIndex].weight2 = weight.mWeight;
+                mBoneIndices[vertIndex].idx2 = boneIdx;
+                break;
+            case 3:
+                mBoneWeights[vertIndex].weight3 = weight.mWeight;
+                mBoneIndices[vertIndex].idx3 = boneIdx;
+                break;
+            default:
+                std::cout << "AssimpMesh unhandled weight number " <<
+                    boneWeightCounters[vertIndex] << std::endl;
+                break;
+            }
+            ++boneWeightCounters[vertIndex];
+        }
+    }
+    // possibly todo - normalize weights?
+
+    // skinned vertices are a weighted average of their bones' transforms
+    // of the bind pose vertex, so they stay inside the union of these
+    // boxes moved by the palette
+    mBoneBounds.assign( boneRemap.size(), Aabb() );
+    for ( size_t i=0; i<assimpMesh->mNumBones; ++i ) {
+        const aiBone* bone = assimpMesh->mBones[i];
+        Aabb& bounds = mBoneBounds[boneRemap[i]];
+        for ( size_t j=0; j<bone->mNumWeights; ++j ) {
+            if ( bone->mWeights[j].mWeight == 0.0f ) { continue; }
+            const VertexTextured& vert = mVertices[bone->mWeights[j].mVertexId];
+            bounds.Add( glm::vec3( vert.x, vert.y, vert.z ));
+        }
+    }
+
+    // group vertices by influence count so Update can skin each group with
+    // a kernel specialized for that count; the index buffer is remapped
+    // below so the rendered triangles stay the same
+    std::vector<uint32_t> oldToNewIdx( mVertices.size() );
+    for ( size_t i=0; i<oldToNewIdx.size(); ++i ) {
+        oldToNewIdx[i] = uint32_t(i);
+    }
+    for ( int n=1; n<MAX_BONE_INFLUENCES; ++n ) {
+        mInfluenceGroups[n-1].begin = 0;
+        mInfluenceGroups[n-1].end = 0;
+    }
+    mInfluenceGroups[MAX_BONE_INFLUENCES-1].begin = 0;
+    mInfluenceGroups[MAX_BONE_INFLUENCES-1].end = mVertices.size();
+    if ( assimpMesh->mNumBones > 0 ) {
+        sortByInfluenceCount( boneWeightCounters, oldToNewIdx );
+    }
+
+    mIndices.resize( assimpMesh->mNumFaces*3 );
+    for ( size_t i=0; i<assimpMesh->mNumFaces; ++i ) {
+        aiFace& face = assimpMesh->mFaces[i];
+        assert( face.mNumIndices == 3 );
+        mIndices[i*3 + 0] = oldToNewIdx[face.mIndices[0]];
+        mIndices[i*3 + 1] = oldToNewIdx[face.mIndices[1]];
+        mIndices[i*3 + 2] = oldToNewIdx[face.mIndices[2]];
+    }
+
+    mGpuSkinned = (skinningMode == SKINNING_GPU) && (assimpMesh->mNumBones > 0);
+    if ( mGpuSkinned ) {
+        // bone data goes up once with the vertices; nothing is
+        // re-uploaded per frame so no frame copy is needed
+        std::vector<VertexSkinned> skinnedVerts( mVertices.size() );
+        for ( size_t i=0; i<mVertices.size(); ++i ) {
+            VertexSkinned& vert = skinnedVerts[i];
+            vert.x = mVertices[i].x;
+            vert.y = mVertices[i].y;
+            vert.z = mVertices[i].z;
+            vert.nx = mVertices[i].nx;
+            vert.ny = mVertices[i].ny;
+            vert.nz = mVertices[i].nz;
+            vert.u = mVertices[i].u;
+            vert.v = mVertices[i].v;
+            vert.boneIdx[0] = mBoneIndices[i].idx0;
+            vert.boneIdx[1] = mBoneIndices[i].idx1;
+            vert.boneIdx[2] = mBoneIndices[i].idx2;
+            vert.boneIdx[3] = mBoneIndices[i].idx3;
+            vert.boneWeight[0] = mBoneWeights[i].weight0;
+            vert.boneWeight[1] = mBoneWeights[i].weight1;
+            vert.boneWeight[2] = mBoneWeights[i].weight2;
+            vert.boneWeight[3] = mBoneWeights[i].weight3;
+        }
+        mVertBuf = std::make_shared<VertexBuffer>(
+            VertexBuffer::POS_TEXCOORD_SKINNED,
+            skinnedVerts.data(), skinnedVerts.size(),
+            mIndices.data(), mIndices.size(),
+            VertexBuffer::USAGE_STATIC
+        );
+    } else if ( assimpMesh->mNumBones > 0 ) {
+        // CPU skinned; positions are rewritten every frame but normals
+        // and texcoords never change, so keep them in separate streams.
+        // Each instance gets its own dynamic position stream from these
+        // bind pose ones (see AssimpMesh)
+        VertexBuffer::Usage streamUsage[VertexBuffer::NUM_STREAMS];
+        streamUsage[VertexBuffer::STREAM_POSITION] = VertexBuffer::USAGE_STATIC;
+        streamUsage[VertexBuffer::STREAM_NORMAL] = VertexBuffer::USAGE_STATIC;
+        streamUsage[VertexBuffer::STREAM_TEXCOORD] = VertexBuffer::USAGE_STATIC;
+        streamUsage[VertexBuffer::STREAM_SKIN] = VertexBuffer::USAGE_STATIC;
+        mVertBuf = std::make_shared<VertexBuffer>(
+            VertexBuffer::POS_TEXCOORD,
+            mVertices.data(), mVertices.size(),
+            mIndices.data(), mIndices.size(),
+            streamUsage
+        );
+    } else {
+        mVertBuf = std::make_shared<VertexBuffer>(
+            VertexBuffer::POS_TEXCOORD,
+            mVertices.data(), mVertices.size(),
+            mIndices.data(), mIndices.size(),
+            VertexBuffer::USAGE_STATIC
+        );
+    }
+
+    return true;
+}
+
+void ModelAsset::Mesh::sortByInfluenceCount(
+    const std::vector<unsigned int>& influenceCounts,
+    std::vector<uint32_t>& outOldToNewIdx
+)
+{
+    // counting sort; vertices with no bones go with the 1 influence
+    // group, where their 0 weight gives the same result as before
+    size_t groupSizes[MAX_BONE_INFLUENCES] = { 0 };
+    std::vector<int> vertGroup( mVertices.size() );
+    for ( size_t i=0; i<mVertices.size(); ++i ) {
+        const unsigned int count = std::min( influenceCounts[i], (unsigned int)MAX_BONE_INFLUENCES );
+        vertGroup[i] = count > 0 ? int(count) - 1 : 0;
+        ++groupSizes[vertGroup[i]];
+    }
+    size_t groupNext[MAX_BONE_INFLUENCES];
+    size_t groupBegin = 0;
+    for ( int g=0; g<MAX_BONE_INFLUENCES; ++g ) {
+        mInfluenceGroups[g].begin = groupBegin;
+        mInfluenceGroups[g].end = groupBegin + groupSizes[g];
+        groupNext[g] = groupBegin;
+        groupBegin += groupSizes[g];
+    }
+
+    std::vector<VertexTextured> sortedVertices( mVertices.size() );
+    std::vector<VertBoneIndices> sortedBoneIndices( mBoneIndices.size() );
+    std::vector<VertBoneWeights> sortedBoneWeights( mBoneWeights.size() );
+    for ( size_t i=0; i<mVertices.size(); ++i ) {
+        const size_t newIdx = groupNext[vertGroup[i]]++;
+        outOldToNewIdx[i] = uint32_t(newIdx);
+        sortedVertices[newIdx] = mVertices[i];
+        sortedBoneIndices[newIdx] = mBoneIndices[i];
+        sortedBoneWeights[newIdx] = mBoneWeights[i];
+    }
+    mVertices.swap( sortedVertices );
+    mBoneIndices.swap( sortedBoneIndices );
+    mBoneWeights.swap( sortedBoneWeights );
+}
+
+static const aiNode* getBoneNode(
+    const std::string& name,
+    const aiNode* node
+)
+{
+    if ( node != nullptr &&
+            std::string(node->mName.C_Str()) == name) {
+        return node;
+    }
+    
+    for ( size_t i=0; i<node->mNumChildren; ++i ) {
+        const aiNode* childNode = getBoneNode( name, node->mChildren[i] );
+        if ( childNode != nullptr ) {
+            return childNode;
+        }
+    }
+    
+    return nullptr;
+}
+static std::string getParentName(
+    const std::string& boneName,
+    const aiScene* scene
+)
+{
+    const aiNode* rootNode = scene->mRootNode;
+    const aiNode* boneNode = getBoneNode( boneName, rootNode );
+    assert( boneNode != nullptr );
+    if ( boneNode->mParent != nullptr ) {
+        const aiNode* parent = boneNode->mParent;
+        return std::string( parent->mName.C_Str() );
+    }
+    return "";
+}
+
+// Skeleton functions
+bool ModelAsset::Skeleton::Load(
+    const aiMesh* mesh,
+    const aiScene* scene
+)
+{
+    // bones in aiMesh order
+    std::vector<Bone> meshBones( mesh->mNumBones );
+    for ( size_t i=0; i<mesh->mNumBones; ++i ) {
+        const aiBone* bone = mesh->mBones[i];
+        meshBones[i].mLocalBindPose = aiMatToMat4( bone->mOffsetMatrix );
+        meshBones[i].mName = std::string( bone->mName.C_Str() );
+        meshBones[i].mParent = -1;
+    }
+    build( meshBones, scene, mBoneRemap );
+    return true;
+}
+
+void ModelAsset::Skeleton::Merge(
+    const Skeleton& other,
+    const aiScene* scene,
+    std::vector<uint32_t>& outRemap
+)
+{
+    // shared bones keep this skeleton's bind pose
+    std::vector<Bone> bones = mBones;
+    for ( const Bone& bone : other.mBones ) {
+        if ( FindBone( bone.mName ) < 0 ) {
+            bones.push_back( bone );
+        }
+    }
+    const size_t numOld = mBones.size();
+    std::vector<uint32_t> remap;
+    build( bones, scene, remap );
+    outRemap.assign( remap.begin(), remap.begin() + numOld );
+    for ( uint32_t& idx : mBoneRemap ) {
+        idx = outRemap[idx];
+    }
+}
+
+void ModelAsset::Skeleton::build(
+    std::vector<Bone> meshBones,
+    const aiScene* scene,
+    std::vector<uint32_t>& outRemap
+)
+{
+    // Get parent indices
+    std::vector<std::vector<size_t>> children( meshBones.size() );
+    for ( size_t i=0; i<meshBones.size(); ++i ) {
+        meshBones[i].mParent = -1;
+        std::string parentName = getParentName( meshBones[i].mName, scene );
+        if ( !parentName.empty() ) {
+            for ( size_t j=0; j<meshBones.size(); ++j ) {
+                if ( meshBones[j].mName == parentName ) {
+                    meshBones[i].mParent = int( j );
+                    children[j].push_back( i );
+                    break;
+                }
+            }
+        }
+    }
+
+    // Reorder depth first from each root, siblings in input order, so
+    // every parent comes before its children
+    const uint32_t unvisited = uint32_t( -1 );
+    outRemap.assign( meshBones.size(), unvisited );
+    mBones.clear();
+    mBones.reserve( meshBones.size() );
+    std::vector<size_t> stack;
+    for ( size_t root=0; root<meshBones.size(); ++root ) {
+        if ( meshBones[root].mParent >= 0 ) { continue; }
+        stack.push_back( root );
+        while ( !stack.empty() ) {
+            const size_t i = stack.back();
+            stack.pop_back();
+            outRemap[i] = uint32_t( mBones.size() );
+            mBones.push_back( meshBones[i] );
+            if ( meshBones[i].mParent >= 0 ) {
+                mBones.back().mParent = int( outRemap[meshBones[i].mParent] );
+            }
+            for ( size_t c=children[i].size(); c>0; --c ) {
+                stack.push_back( children[i][c-1] );
+            }
+        }
+    }
+    // only a parent cycle, which a node tree can't have, leaves bones
+    // unvisited; keep them as roots rather than drop them
+    for ( size_t i=0; i<meshBones.size(); ++i ) {
+        if ( outRemap[i] == unvisited ) {
+            outRemap[i] = uint32_t( mBones.size() );
+            mBones.push_back( meshBones[i] );
+            mBones.back().mParent = -1;
+        }
+    }
+
+    // mLocalBindPose holds the inverse global bind pose (see
+    // ComputeGlobalInvBindPose), so the parent relative one is
+    // parentInvBind * inverse( invBind )
+    mIsLeaf.assign( mBones.size(), 1 );
+    mLocalRestPoses.resize( mBones.size() );
+    for ( size_t i=0; i<mBones.size(); ++i ) {
+        const int parent = mBones[i].mParent;
+        mLocalRestPoses[i] = glm::inverse( mBones[i].mLocalBindPose );
+        if ( parent >= 0 ) {
+            mIsLeaf[parent] = 0;
+            mLocalRestPoses[i] = mBones[parent].mLocalBindPose * mLocalRestPoses[i];
+        }
+    }
+
+    // the first root comes first
+    mRootBoneIdx = 0;
+    ComputeGlobalInvBindPose();
+}
+
+void ModelAsset::Skeleton::ComputeGlobalInvBindPose()
+{
+    // resize to number of bones, which auto fills identity
+    mGlobalInvBindPoses.resize( GetNumBones() );
+    if ( GetNumBones() == 0 ) { return; }
+    
+    // Assimp already calculates the global inverse bind poses for us
+    mGlobalInvBindPoses[0] = mBones[0].mLocalBindPose;
+    for ( size_t i=1; i<mGlobalInvBindPoses.size(); ++i ) {
+        const glm::mat4 localMat = mBones[i].mLocalBindPose;
+        mGlobalInvBindPoses[i] = localMat;
+    }
+}
+
+// Animation functions
+// below this |dot| between two rotation keys normalized lerp drifts too
+// far from the constant speed slerp path, so those bones fall back to slerp
+static const float NLERP_MIN_DOT = 0.95f;
+
+void ModelAsset::Animation::samplePoseKeysScalar(
+    const float* keysA,
+    const float* keysB,
+    const float* blend,
+    const size_t stride,
+    const size_t firstBone,
+    const size_t endBone,
+    glm::mat4* outLocal )
+{
+    for ( size_t b=firstBone; b<endBone; ++b ) {
+        #define KEY( keys, comp ) keys[comp * stride + b]
+        const glm::vec3 pos = glm::mix(
+            glm::vec3( KEY( keysA, KEY_POS_X ), KEY( keysA, KEY_POS_Y ), KEY( keysA, KEY_POS_Z )),
+            glm::vec3( KEY( keysB, KEY_POS_X ), KEY( keysB, KEY_POS_Y ), KEY( keysB, KEY_POS_Z )),
+            KEY( blend, TRACK_POS )
+        );
+        const glm::vec3 scl = glm::mix(
+            glm::vec3( KEY( keysA, KEY_SCL_X ), KEY( keysA, KEY_SCL_Y ), KEY( keysA, KEY_SCL_Z )),
+            glm::vec3( KEY( keysB, KEY_SCL_X ), KEY( keysB, KEY_SCL_Y ), KEY( keysB, KEY_SCL_Z )),
+            KEY( blend, TRACK_SCL )
+        );
+        const glm::quat rotA( KEY( keysA, KEY_ROT_W ), KEY( keysA, KEY_ROT_X ), KEY( keysA, KEY_ROT_Y ), KEY( keysA, KEY_ROT_Z ));
+        glm::quat rotB( KEY( keysB, KEY_ROT_W ), KEY( keysB, KEY_ROT_X ), KEY( keysB, KEY_ROT_Y ), KEY( keysB, KEY_ROT_Z ));
+        #undef KEY
+
+        // q and -q are the same rotation; blend along the shortest path
+        float dot = glm::dot( rotA, rotB );
+        if ( dot < 0.0f ) {
+            rotB = -rotB;
+            dot = -dot;
+        }
+        const float t = blend[TRACK_ROT * stride + b];
+        glm::quat rot;
+        if ( dot < NLERP_MIN_DOT ) {
+            rot = glm::slerp( rotA, rotB, t );
+        } else {
+            rot = glm::normalize( rotA * (1.0f - t) + rotB * t );
+        }
+
+        glm::mat4 local = glm::mat4_cast( rot );
+        local[0] *= scl.x;
+        local[1] *= scl.y;
+        local[2] *= scl.z;
+        local[3] = glm::vec4( pos, 1.0f );
+        outLocal[b] = local;
+    }
+}
+
+// writes translate * rotate * scale
+void ModelAsset::Animation::samplePoseKeys(
+    const float* keysA,
+    const float* keysB,
+    const float* blend,
+    const size_t stride,
+    const size_t numBones,
+    glm::mat4* outLocal )
+{
+#ifdef SIMD_SSE2
+    const __m128 one = _mm_set1_ps( 1.0f );
+    const __m128 two = _mm_set1_ps( 2.0f );
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 signBit = _mm_set1_ps( -0.0f );
+    const __m128 minDot = _mm_set1_ps( NLERP_MIN_DOT );
+
+    for ( size_t b=0; b<numBones; b+=SIMD_BONES )
+    {
+        #define LOAD( keys, comp ) _mm_loadu_ps( &keys[comp * stride + b] )
+        #define LERP( va, vb, vt ) _mm_add_ps( va, _mm_mul_ps( _mm_sub_ps( vb, va ), vt ))
+        const __m128 tPos = LOAD( blend, TRACK_POS );
+        const __m128 tRot = LOAD( blend, TRACK_ROT );
+        const __m128 tScl = LOAD( blend, TRACK_SCL );
+        const __m128 px = LERP( LOAD( keysA, KEY_POS_X ), LOAD( keysB, KEY_POS_X ), tPos );
+        const __m128 py = LERP( LOAD( keysA, KEY_POS_Y ), LOAD( keysB, KEY_POS_Y ), tPos );
+        const __m128 pz = LERP( LOAD( keysA, KEY_POS_Z ), LOAD( keysB, KEY_POS_Z ), tPos );
+        const __m128 sx = LERP( LOAD( keysA, KEY_SCL_X ), LOAD( keysB, KEY_SCL_X ), tScl );
+        const __m128 sy = LERP( LOAD( keysA, KEY_SCL_Y ), LOAD( keysB, KEY_SCL_Y ), tScl );
+        const __m128 sz = LERP( LOAD( keysA, KEY_SCL_Z ), LOAD( keysB, KEY_SCL_Z ), tScl );
+
+        const __m128 ax = LOAD( keysA, KEY_ROT_X );
+        const __m128 ay = LOAD( keysA, KEY_ROT_Y );
+        const __m128 az = LOAD( keysA, KEY_ROT_Z );
+        const __m128 aw = LOAD( keysA, KEY_ROT_W );
+        __m128 bx = LOAD( keysB, KEY_ROT_X );
+        __m128 by = LOAD( keysB, KEY_ROT_Y );
+        __m128 bz = LOAD( keysB, KEY_ROT_Z );
+        __m128 bw = LOAD( keysB, KEY_ROT_W );
+
+        // flip b where the dot product is negative to take the short path
+        const __m128 dot = _mm_add_ps(
+            _mm_add_ps( _mm_mul_ps( ax, bx ), _mm_mul_ps( ay, by )),
+            _mm_add_ps( _mm_mul_ps( az, bz ), _mm_mul_ps( aw, bw ))
+        );
+        const __m128 flip = _mm_and_ps( dot, signBit );
+        bx = _mm_xor_ps( bx, flip );
+        by = _mm_xor_ps( by, flip );
+        bz = _mm_xor_ps( bz, flip );
+        bw = _mm_xor_ps( bw, flip );
+        const __m128 absDot = _mm_andnot_ps( signBit, dot );
+
+        // nlerp
+        __m128 qx = LERP( ax, bx, tRot );
+        __m128 qy = LERP( ay, by, tRot );
+        __m128 qz = LERP( az, bz, tRot );
+        __m128 qw = LERP( aw, bw, tRot );
+        #undef LERP
+        #undef LOAD
+        const __m128 lenSq = _mm_add_ps(
+            _mm_add_ps( _mm_mul_ps( qx, qx ), _mm_mul_ps( qy, qy )),
+            _mm_add_ps( _mm_mul_ps( qz, qz ), _mm_mul_ps( qw, qw ))
+        );
+        const __m128 invLen = _mm_div_ps( one, _mm_sqrt_ps( lenSq ));
+        qx = _mm_mul_ps( qx, invLen );
+        qy = _mm_mul_ps( qy, invLen );
+        qz = _mm_mul_ps( qz, invLen );
+        qw = _mm_mul_ps( qw, invLen );
+
+        // rotation matrix scaled per column, as in mat4_cast * scale
+        const __m128 x2 = _mm_mul_ps( qx, two );
+        const __m128 y2 = _mm_mul_ps( qy, two );
+        const __m128 z2 = _mm_mul_ps( qz, two );
+        const __m128 xx = _mm_mul_ps( qx, x2 );
+        const __m128 yy = _mm_mul_ps( qy, y2 );
+        const __m128 zz = _mm_mul_ps( qz, z2 );
+        const __m128 xy = _mm_mul_ps( qx, y2 );
+        const __m128 xz = _mm_mul_ps( qx, z2 );
+        const __m128 yz = _mm_mul_ps( qy, z2 );
+        const __m128 wx = _mm_mul_ps( qw, x2 );
+        const __m128 wy = _mm_mul_ps( qw, y2 );
+        const __m128 wz = _mm_mul_ps( qw, z2 );
+
+        __m128 c0x = _mm_mul_ps( _mm_sub_ps( one, _mm_add_ps( yy, zz )), sx );
+        __m128 c0y = _mm_mul_ps( _mm_add_ps( xy, wz ), sx );
+        __m128 c0z = _mm_mul_ps( _mm_sub_ps( xz, wy ), sx );
+        __m128 c0w = zero;
+        __m128 c1x = _mm_mul_ps( _mm_sub_ps( xy, wz ), sy );
+        __m128 c1y = _mm_mul_ps( _mm_sub_ps( one, _mm_add_ps( xx, zz )), sy );
+        __m128 c1z = _mm_mul_ps( _mm_add_ps( yz, wx ), sy );
+        __m128 c1w = zero;
+        __m128 c2x = _mm_mul_ps( _mm_add_ps( xz, wy ), sz );
+        __m128 c2y = _mm_mul_ps( _mm_sub_ps( yz, wx ), sz );
+        __m128 c2z = _mm_mul_ps( _mm_sub_ps( one, _mm_add_ps( xx, yy )), sz );
+        __m128 c2w = zero;
+        __m128 c3x = px;
+        __m128 c3y = py;
+        __m128 c3z = pz;
+        __m128 c3w = one;
+
+        // SoA -> one matrix per bone
+        _MM_TRANSPOSE4_PS( c0x, c0y, c0z, c0w );
+        _MM_TRANSPOSE4_PS( c1x, c1y, c1z, c1w );
+        _MM_TRANSPOSE4_PS( c2x, c2y, c2z, c2w );
+        _MM_TRANSPOSE4_PS( c3x, c3y, c3z, c3w );
+        const __m128 cols[4][4] = {
+            { c0x, c1x, c2x, c3x },
+            { c0y, c1y, c2y, c3y },
+            { c0z, c1z, c2z, c3z },
+            { c0w, c1w, c2w, c3w }
+        };
+        const size_t lanes = numBones - b < SIMD_BONES ? numBones - b : SIMD_BONES;
+        for ( size_t lane=0; lane<lanes; ++lane ) {
+            float* dst = glm::value_ptr( outLocal[b + lane] );
+            _mm_storeu_ps( dst + 0, cols[lane][0] );
+            _mm_storeu_ps( dst + 4, cols[lane][1] );
+            _mm_storeu_ps( dst + 8, cols[lane][2] );
+            _mm_storeu_ps( dst + 12, cols[lane][3] );
+        }
+
+        // redo the few bones rotating too far between keys with slerp
+        const int slerpMask = _mm_movemask_ps( _mm_cmplt_ps( absDot, minDot ));
+        if ( slerpMask != 0 ) {
+            for ( size_t lane=0; lane<lanes; ++lane ) {
+                if ( slerpMask & (1 << lane) ) {
+                    samplePoseKeysScalar( keysA, keysB, blend, stride, b + lane, b + lane + 1, outLocal );
+                }
+            }
+        }
+    }
+#else
+    samplePoseKeysScalar( keysA, keysB, blend, stride, 0, numBones, outLocal );
+#endif
+}
+
+// inOutChild = parent * inOutChild, for affine transforms (bottom row
+// 0,0,0,1) such as bone poses: only the top 3x4 is computed
+static inline void concatAffine( const glm::mat4& parent, glm::mat4& inOutChild )
+{
+#ifdef SIMD_SSE2
+    const float* p = glm::value_ptr( parent );
+    float* c = glm::value_ptr( inOutChild );
+    const __m128 p0 = _mm_loadu_ps( p + 0 );
+    const __m128 p1 = _mm_loadu_ps( p + 4 );
+    const __m128 p2 = _mm_loadu_ps( p + 8 );
+    const __m128 p3 = _mm_loadu_ps( p + 12 );
+    for ( int col=0; col<4; ++col ) {
+        const float* cc = c + col * 4;
+        __m128 r = _mm_add_ps(
+            _mm_add_ps( _mm_mul_ps( p0, _mm_set1_ps( cc[0] )), _mm_mul_ps( p1, _mm_set1_ps( cc[1] ))),
+            _mm_mul_ps( p2, _mm_set1_ps( cc[2] ))
+        );
+        // translation column; w of the other columns is 0
+        if ( col == 3 ) {
+            r = _mm_add_ps( r, p3 );
+        }
+        _mm_storeu_ps( c + col * 4, r );
+    }
+#else
+    const glm::mat4 child = inOutChild;
+    for ( int col=0; col<4; ++col ) {
+        inOutChild[col] = parent[0] * child[col].x + parent[1] * child[col].y + parent[2] * child[col].z;
+    }
+    inOutChild[3] += parent[3];
+#endif
+}
+
+// Rate used when the file doesn't specify one
+static const double DEFAULT_TICKS_PER_SECOND = 24.0;
+
+// range of the 3 smallest components of a unit quaternion
+static const float QUAT_COMPONENT_MAX = 0.70710678f; // 1/sqrt(2)
+static const float QUAT_COMPONENT_STEPS = 32767.0f; // 15 bits
+static const float VEC3_COMPONENT_STEPS = 65535.0f; // 16 bits
+
+ModelAsset::Animation::PackedQuat ModelAsset::Animation::packQuat( const glm::quat& q )
+{
+    const glm::quat unit = glm::normalize( q );
+    const float comps[4] = { unit.x, unit.y, unit.z, unit.w };
+    int largest = 0;
+    for ( int i=1; i<4; ++i ) {
+        if ( fabsf( comps[i] ) > fabsf( comps[largest] )) {
+            largest = i;
+        }
+    }
+    // q and -q are the same rotation; flip so the dropped one is positive
+    const float sign = comps[largest] < 0.0f ? -1.0f : 1.0f;
+    PackedQuat packed;
+    int outIdx = 0;
+    for ( int i=0; i<4; ++i ) {
+        if ( i == largest ) { continue; }
+        float norm = (comps[i] * sign / QUAT_COMPONENT_MAX) * 0.5f + 0.5f;
+        norm = std::max( 0.0f, std::min( norm, 1.0f ));
+        packed.v[outIdx] = uint16_t( lroundf( norm * QUAT_COMPONENT_STEPS ));
+        ++outIdx;
+    }
+    packed.v[0] |= uint16_t( (largest & 1) << 15 );
+    packed.v[1] |= uint16_t( (largest >> 1) << 15 );
+    return packed;
+}
+
+glm::quat ModelAsset::Animation::unpackQuat( const PackedQuat& packed )
+{
+    const int largest = (packed.v[0] >> 15) | ((packed.v[1] >> 15) << 1);
+    float comps[4];
+    float sumSq = 0.0f;
+    int inIdx = 0;
+    for ( int i=0; i<4; ++i ) {
+        if ( i == largest ) { continue; }
+        const float norm = float( packed.v[inIdx] & 0x7FFF ) / QUAT_COMPONENT_STEPS;
+        comps[i] = (norm * 2.0f - 1.0f) * QUAT_COMPONENT_MAX;
+        sumSq += comps[i] * comps[i];
+        ++inIdx;
+    }
+    comps[largest] = sqrtf( std::max( 0.0f, 1.0f - sumSq ));
+    return glm::quat( comps[3], comps[0], comps[1], comps[2] );
+}
+
+ModelAsset::Animation::PackedVec3 ModelAsset::Animation::packVec3(
+    const glm::vec3& v,
+    const glm::vec3& min,
+    const glm::vec3& step )
+{
+    PackedVec3 packed;
+    for ( int i=0; i<3; ++i ) {
+        const float steps = step[i] > 0.0f ? (v[i] - min[i]) / step[i] : 0.0f;
+        packed.v[i] = uint16_t( lroundf( std::max( 0.0f, std::min( steps, VEC3_COMPONENT_STEPS ))));
+    }
+    return packed;
+}
+
+glm::vec3 ModelAsset::Animation::unpackVec3(
+    const PackedVec3& packed,
+    const glm::vec3& min,
+    const glm::vec3& step )
+{
+    return min + glm::vec3( packed.v[0], packed.v[1], packed.v[2] ) * step;
+}
+
+// Key reduction helpers for vec3 and quaternion tracks
+static float keyError( const glm::vec3& a, const glm::vec3& b )
+{
+    return glm::length( a - b );
+}
+static float keyError( const glm::quat& a, const glm::quat& b )
+{
+    // angle of the rotation between them; atan2 stays accurate for the
+    // tiny angles tolerances are about, where acos of the dot doesn't
+    const glm::quat delta = glm::conjugate( a ) * b;
+    const float sinHalf = glm::length( glm::vec3( delta.x, delta.y, delta.z ));
+    return 2.0f * atan2f( sinHalf, fabsf( delta.w ));
+}
+static glm::vec3 interpKeys( const glm::vec3& a, const glm::vec3& b, const float t )
+{
+    return glm::mix( a, b, t );
+}
+static glm::quat interpKeys( const glm::quat& a, glm::quat b, const float t )
+{
+    // same as the sampler
+    float dot = glm::dot( a, b );
+    if ( dot < 0.0f ) {
+        b = -b;
+        dot = -dot;
+    }
+    if ( dot < NLERP_MIN_DOT ) {
+        return glm::slerp( a, b, t );
+    }
+    return glm::normalize( a * (1.0f - t) + b * t );
+}
+
+/**
+ * Pick the keys of a track to keep. A constant track keeps its first key,
+ * and none at all if that equals identity. Otherwise keys are dropped
+ * greedily while interpolating the kept keys around them reproduces every
+ * dropped key within tolerance.
+ */
+template<typename T>
+static void reduceKeys(
+    const std::vector<float>& times,
+    const std::vector<T>& values,
+    const T& identity,
+    const float tolerance,
+    std::vector<uint32_t>& outKept )
+{
+    outKept.clear();
+    const size_t numKeys = values.size();
+    if ( numKeys == 0 ) { return; }
+
+    bool constant = true;
+    for ( size_t i=1; i<numKeys && constant; ++i ) {
+        constant = keyError( values[0], values[i] ) <= tolerance;
+    }
+    if ( constant ) {
+        if ( keyError( values[0], identity ) > tolerance ) {
+            outKept.push_back( 0 );
+        }
+        return;
+    }
+
+    size_t anchor = 0;
+    outKept.push_back( 0 );
+    for ( size_t end=anchor+2; end<numKeys; ++end ) {
+        bool fits = true;
+        const float span = times[end] - times[anchor];
+        for ( size_t mid=anchor+1; mid<end && fits; ++mid ) {
+            const float t = span > 0.0f ? (times[mid] - times[anchor]) / span : 0.0f;
+            fits = keyError( interpKeys( values[anchor], values[end], t ), values[mid] ) <= tolerance;
+        }
+        if ( !fits ) {
+            anchor = end - 1;
+            outKept.push_back( uint32_t( anchor ));
+        }
+    }
+    outKept.push_back( uint32_t( numKeys - 1 ));
+}
+
+// min and quantization step of a vec3 track's kept keys
+static void vec3Range(
+    const std::vector<glm::vec3>& values,
+    const std::vector<uint32_t>& kept,
+    glm::vec3& outMin,
+    glm::vec3& outStep )
+{
+    if ( kept.empty() ) {
+        outMin = glm::vec3( 0.0f );
+        outStep = glm::vec3( 0.0f );
+        return;
+    }
+    glm::vec3 maxVal = values[kept[0]];
+    outMin = values[kept[0]];
+    for ( uint32_t key : kept ) {
+        outMin = glm::min( outMin, values[key] );
+        maxVal = glm::max( maxVal, values[key] );
+    }
+    outStep = (maxVal - outMin) / VEC3_COMPONENT_STEPS;
+}
+
+bool ModelAsset::Animation::Load(
+    const aiAnimation* assimpAnim,
+    const aiScene* scene,
+    const Skeleton* skeleton,
+    const AnimCompression& compression
+)
+{
+    const std::vector<Skeleton::Bone>& bones = skeleton->GetBones();
+    mName = std::string( assimpAnim->mName.C_Str() );
+    mNumBones = bones.size();
+    mPaddedBones = (mNumBones + SIMD_BONES - 1) / SIMD_BONES * SIMD_BONES;
+
+    // key times are in ticks
+    const double ticksPerSecond = assimpAnim->mTicksPerSecond > 0.0 ?
+        assimpAnim->mTicksPerSecond : DEFAULT_TICKS_PER_SECOND;
+    mDuration = float( assimpAnim->mDuration / ticksPerSecond );
+
+    Channel noChannel;
+    for ( size_t track=0; track<NUM_TRACKS; ++track ) {
+        noChannel.keys[track].first = 0;
+        noChannel.keys[track].count = 0;
+        mKeyTimes[track].clear();
+    }
+    noChannel.posMin = noChannel.posStep = glm::vec3( 0.0f );
+    noChannel.sclMin = noChannel.sclStep = glm::vec3( 0.0f );
+    mChannels.assign( mNumBones, noChannel );
+    mPosKeys.clear();
+    mRotKeys.clear();
+    mSclKeys.clear();
+
+    mCompressionStats.rawBytes = 0;
+    mCompressionStats.maxPosError = 0.0f;
+    mCompressionStats.maxRotError = 0.0f;
+    mCompressionStats.maxSclError = 0.0f;
+
+    // source keys of the current channel, and which of them are kept
+    std::vector<float> posTimes, rotTimes, sclTimes;
+    std::vector<glm::vec3> positions, scales;
+    std::vector<glm::quat> rotations;
+    std::vector<uint32_t> kept;
+
+    for ( size_t i=0; i<assimpAnim->mNumChannels; ++i ) {
+        const aiNodeAnim* channel = assimpAnim->mChannels[i];
+        std::string name = std::string( channel->mNodeName.C_Str() );
+        const int boneIdx = skeleton->FindBone( name );
+        // nodes that aren't bones of this rig don't affect it
+        if ( boneIdx < 0 ) { continue; }
+
+        // each track keeps its own key count and times
+        posTimes.resize( channel->mNumPositionKeys );
+        positions.resize( channel->mNumPositionKeys );
+        for ( size_t j=0; j<channel->mNumPositionKeys; ++j ) {
+            const aiVectorKey& keyFrame = channel->mPositionKeys[j];
+            posTimes[j] = float( keyFrame.mTime / ticksPerSecond );
+            positions[j] = glm::vec3( keyFrame.mValue.x, keyFrame.mValue.y, keyFrame.mValue.z );
+        }
+        rotTimes.resize( channel->mNumRotationKeys );
+        rotations.resize( channel->mNumRotationKeys );
+        for ( size_t j=0; j<channel->mNumRotationKeys; ++j ) {
+            const aiQuatKey& keyFrame = channel->mRotationKeys[j];
+            rotTimes[j] = float( keyFrame.mTime / ticksPerSecond );
+            rotations[j] = glm::quat(
+                keyFrame.mValue.w,
+                keyFrame.mValue.x,
+                keyFrame.mValue.y,
+                keyFrame.mValue.z
+            );
+        }
+        sclTimes.resize( channel->mNumScalingKeys );
+        scales.resize( channel->mNumScalingKeys );
+        for ( size_t j=0; j<channel->mNumScalingKeys; ++j ) {
+            const aiVectorKey& keyFrame = channel->mScalingKeys[j];
+            sclTimes[j] = float( keyFrame.mTime / ticksPerSecond );
+            scales[j] = glm::vec3( keyFrame.mValue.x, keyFrame.mValue.y, keyFrame.mValue.z );
+        }
+        // uncompressed: time + value per key
+        mCompressionStats.rawBytes +=
+            positions.size() * (sizeof( float ) + sizeof( glm::vec3 )) +
+            rotations.size() * (sizeof( float ) + sizeof( glm::quat )) +
+            scales.size() * (sizeof( float ) + sizeof( glm::vec3 ));
+
+        Channel& outChannel = mChannels[boneIdx];
+
+        reduceKeys( posTimes, positions, glm::vec3( 0.0f ), compression.posTolerance, kept );
+        vec3Range( positions, kept, outChannel.posMin, outChannel.posStep );
+        outChannel.keys[TRACK_POS].first = uint32_t( mPosKeys.size() );
+        outChannel.keys[TRACK_POS].count = uint32_t( kept.size() );
+        for ( uint32_t key : kept ) {
+            mKeyTimes[TRACK_POS].push_back( posTimes[key] );
+            mPosKeys.push_back( packVec3( positions[key], outChannel.posMin, outChannel.posStep ));
+        }
+
+        reduceKeys( rotTimes, rotations, glm::quat( 1.0f, 0.0f, 0.0f, 0.0f ), compression.rotTolerance, kept );
+        outChannel.keys[TRACK_ROT].first = uint32_t( mRotKeys.size() );
+        outChannel.keys[TRACK_ROT].count = uint32_t( kept.size() );
+        for ( uint32_t key : kept ) {
+            mKeyTimes[TRACK_ROT].push_back( rotTimes[key] );
+            mRotKeys.push_back( packQuat( rotations[key] ));
+        }
+
+        reduceKeys( sclTimes, scales, glm::vec3( 1.0f ), compression.sclTolerance, kept );
+        vec3Range( scales, kept, outChannel.sclMin, outChannel.sclStep );
+        outChannel.keys[TRACK_SCL].first = uint32_t( mSclKeys.size() );
+        outChannel.keys[TRACK_SCL].count = uint32_t( kept.size() );
+        for ( uint32_t key : kept ) {
+            mKeyTimes[TRACK_SCL].push_back( sclTimes[key] );
+            mSclKeys.push_back( packVec3( scales[key], outChannel.sclMin, outChannel.sclStep ));
+        }
+
+        // error of the decoded tracks at every source key
+        uint32_t key, nextKey;
+        float blend;
+        for ( size_t j=0; j<positions.size(); ++j ) {
+            glm::vec3 pos( 0.0f );
+            if ( outChannel.keys[TRACK_POS].count > 0 ) {
+                findKeys( outChannel, TRACK_POS, posTimes[j], 0, key, nextKey, blend );
+                pos = interpKeys( getPosKey( outChannel, key ), getPosKey( outChannel, nextKey ), blend );
+            }
+            mCompressionStats.maxPosError = std::max( mCompressionStats.maxPosError, keyError( pos, positions[j] ));
+        }
+        for ( size_t j=0; j<rotations.size(); ++j ) {
+            glm::quat rot( 1.0f, 0.0f, 0.0f, 0.0f );
+            if ( outChannel.keys[TRACK_ROT].count > 0 ) {
+                findKeys( outChannel, TRACK_ROT, rotTimes[j], 0, key, nextKey, blend );
+                rot = interpKeys( getRotKey( outChannel, key ), getRotKey( outChannel, nextKey ), blend );
+            }
+            mCompressionStats.maxRotError = std::max( mCompressionStats.maxRotError, keyError( rot, rotations[j] ));
+        }
+        for ( size_t j=0; j<scales.size(); ++j ) {
+            glm::vec3 scl( 1.0f );
+            if ( outChannel.keys[TRACK_SCL].count > 0 ) {
+                findKeys( outChannel, TRACK_SCL, sclTimes[j], 0, key, nextKey, blend );
+                scl = interpKeys( getSclKey( outChannel, key ), getSclKey( outChannel, nextKey ), blend );
+            }
+            mCompressionStats.maxSclError = std::max( mCompressionStats.maxSclError, keyError( scl, scales[j] ));
+        }
+    }
+
+    mCompressionStats.compressedBytes =
+        mChannels.size() * sizeof( Channel ) +
+        mPosKeys.size() * sizeof( PackedVec3 ) +
+        mRotKeys.size() * sizeof( PackedQuat ) +
+        mSclKeys.size() * sizeof( PackedVec3 );
+    for ( size_t track=0; track<NUM_TRACKS; ++track ) {
+        mCompressionStats.compressedBytes += mKeyTimes[track].size() * sizeof( float );
+    }
+    return true;
+}
+
+size_t ModelAsset::Animation::GetNumKeys() const
+{
+    return mPosKeys.size() + mRotKeys.size() + mSclKeys.size();
+}
+
+// Index of the last key at or before time (0 if time is before the
+// first key). Checks the hint and the key after it first, which is
+// where sequential playback lands, before binary searching
+static uint32_t findKey(
+    const float* times,
+    const uint32_t count,
+    const float time,
+    const uint32_t hint )
+{
+    if ( hint < count && times[hint] <= time ) {
+        if ( hint + 1 >= count || time < times[hint + 1] ) {
+            return hint;
+        }
+        if ( hint + 2 >= count || time < times[hint + 2] ) {
+            return hint + 1;
+        }
+    }
+    const float* it = std::upper_bound( times, times + count, time );
+    return it == times ? 0 : uint32_t( it - times - 1 );
+}
+
+void ModelAsset::Animation::findKeys(
+    const Channel& channel,
+    const Track track,
+    const float time,
+    const uint32_t hint,
+    uint32_t& outKey,
+    uint32_t& outNextKey,
+    float& outBlend ) const
+{
+    const KeyRange& range = channel.keys[track];
+    const float* times = &mKeyTimes[track][range.first];
+    outKey = findKey( times, range.count, time, hint );
+    outNextKey = std::min( outKey + 1, range.count - 1 );
+    outBlend = 0.0f;
+    if ( outNextKey != outKey ) {
+        // Calculate percentage between this and next key
+        outBlend = (time - times[outKey]) / (times[outNextKey] - times[outKey]);
+        outBlend = std::max( 0.0f, std::min( outBlend, 1.0f ));
+    }
+}
+
+void ModelAsset::Animation::decodeKey(
+    const Channel& channel,
+    const size_t bone,
+    const Track track,
+    const uint32_t key,
+    const size_t stride,
+    float* keys ) const
+{
+    #define KEY( comp ) keys[comp * stride + bone]
+    switch ( track )
+    {
+    case TRACK_POS: {
+        const glm::vec3 pos = getPosKey( channel, key );
+        KEY( KEY_POS_X ) = pos.x; KEY( KEY_POS_Y ) = pos.y; KEY( KEY_POS_Z ) = pos.z;
+        break;
+    }
+    case TRACK_ROT: {
+        const glm::quat rot = getRotKey( channel, key );
+        KEY( KEY_ROT_X ) = rot.x; KEY( KEY_ROT_Y ) = rot.y; KEY( KEY_ROT_Z ) = rot.z; KEY( KEY_ROT_W ) = rot.w;
+        break;
+    }
+    default: {
+        const glm::vec3 scl = getSclKey( channel, key );
+        KEY( KEY_SCL_X ) = scl.x; KEY( KEY_SCL_Y ) = scl.y; KEY( KEY_SCL_Z ) = scl.z;
+        break;
+    }
+    }
+    #undef KEY
+}
+
+// components of each Track in the SoA frames
+static const size_t TRACK_FIRST_COMPONENT[ModelAsset::Animation::NUM_TRACKS] = {
+    ModelAsset::Animation::KEY_POS_X, ModelAsset::Animation::KEY_ROT_X, ModelAsset::Animation::KEY_SCL_X
+};
+static const size_t TRACK_NUM_COMPONENTS[ModelAsset::Animation::NUM_TRACKS] = { 3, 4, 3 };
+
+// SoA frames with every bone at the identity
+static void fillIdentityKeys( float* keys, const size_t stride )
+{
+    std::fill( keys, keys + ModelAsset::Animation::NUM_KEY_COMPONENTS * stride, 0.0f );
+    std::fill( keys + ModelAsset::Animation::KEY_ROT_W * stride, keys + (ModelAsset::Animation::KEY_ROT_W + 1) * stride, 1.0f );
+    std::fill( keys + ModelAsset::Animation::KEY_SCL_X * stride, keys + (ModelAsset::Animation::KEY_SCL_Z + 1) * stride, 1.0f );
+}
+
+void ModelAsset::Animation::resetCursor( Cursor& cursor, const Skeleton* skeleton, const bool skipLeafBones ) const
+{
+    const size_t stride = mPaddedBones;
+    const float inf = std::numeric_limits<float>::infinity();
+    cursor.anim = this;
+    cursor.skipLeafBones = skipLeafBones;
+    cursor.keys.assign( mNumBones * NUM_TRACKS, 0 );
+    cursor.keysA.resize( NUM_KEY_COMPONENTS * stride );
+    cursor.keysB.resize( NUM_KEY_COMPONENTS * stride );
+    fillIdentityKeys( cursor.keysA.data(), stride );
+    fillIdentityKeys( cursor.keysB.data(), stride );
+    // tracks without keys (and the padding) keep the identity forever
+    cursor.blend.assign( NUM_TRACKS * stride, 0.0f );
+    cursor.validFrom.assign( NUM_TRACKS * stride, -inf );
+    cursor.validTo.assign( NUM_TRACKS * stride, inf );
+    cursor.keyTime.assign( NUM_TRACKS * stride, 0.0f );
+    cursor.invSpan.assign( NUM_TRACKS * stride, 0.0f );
+    for ( size_t bone=0; bone<mNumBones; ++bone ) {
+        if ( skipLeafBones && skeleton->IsLeafBone( bone ) ) { continue; }
+        for ( size_t track=0; track<NUM_TRACKS; ++track ) {
+            if ( mChannels[bone].keys[track].count == 0 ) { continue; }
+            // an empty range, so the first update gathers it
+            cursor.validFrom[track * stride + bone] = inf;
+            cursor.validTo[track * stride + bone] = -inf;
+        }
+    }
+}
+
+void ModelAsset::Animation::updateCursor( Cursor& cursor, const float time ) const
+{
+    const size_t stride = mPaddedBones;
+    const float inf = std::numeric_limits<float>::infinity();
+    for ( size_t track=0; track<NUM_TRACKS; ++track )
+    {
+        const float* validFrom = &cursor.validFrom[track * stride];
+        const float* validTo = &cursor.validTo[track * stride];
+        const float* keyTime = &cursor.keyTime[track * stride];
+        const float* invSpan = &cursor.invSpan[track * stride];
+        float* blend = &cursor.blend[track * stride];
+        for ( size_t b=0; b<stride; b+=SIMD_BONES )
+        {
+            // the blend of every bone, then regather the ones whose
+            // time left their key pair
+            uint32_t staleMask = 0;
+#ifdef SIMD_SSE2
+            const __m128 t = _mm_set1_ps( time );
+            const __m128 inRange = _mm_and_ps(
+                _mm_cmpge_ps( t, _mm_loadu_ps( validFrom + b )),
+                _mm_cmplt_ps( t, _mm_loadu_ps( validTo + b ))
+            );
+            const __m128 pct = _mm_mul_ps( _mm_sub_ps( t, _mm_loadu_ps( keyTime + b )), _mm_loadu_ps( invSpan + b ));
+            _mm_storeu_ps( blend + b, _mm_min_ps( _mm_max_ps( pct, _mm_setzero_ps() ), _mm_set1_ps( 1.0f )));
+            staleMask = ~uint32_t( _mm_movemask_ps( inRange )) & 0xF;
+#else
+            for ( size_t lane=0; lane<SIMD_BONES; ++lane ) {
+                const size_t i = b + lane;
+                if ( time >= validFrom[i] && time < validTo[i] ) {
+                    blend[i] = std::max( 0.0f, std::min( (time - keyTime[i]) * invSpan[i], 1.0f ));
+                } else {
+                    staleMask |= 1u << lane;
+                }
+            }
+#endif
+            for ( size_t lane=0; staleMask != 0; ++lane, staleMask >>= 1 )
+            {
+                if ( (staleMask & 1) == 0 ) { continue; }
+                const size_t bone = b + lane;
+                const size_t i = track * stride + bone;
+                const Channel& channel = mChannels[bone];
+                uint32_t& hint = cursor.keys[bone * NUM_TRACKS + track];
+                // fresh tracks have an empty range; the rest held a pair
+                const bool hadPair = cursor.validFrom[i] <= cursor.validTo[i];
+                const uint32_t oldKey = hint;
+                uint32_t key, nextKey;
+                findKeys( channel, Track( track ), time, hint, key, nextKey, cursor.blend[i] );
+                if ( hadPair && key == oldKey + 1 ) {
+                    // moved on by one key, the usual case: the old next key
+                    // is the new first one, so only one key is decoded
+                    const size_t firstComp = TRACK_FIRST_COMPONENT[track];
+                    for ( size_t comp=firstComp; comp<firstComp + TRACK_NUM_COMPONENTS[track]; ++comp ) {
+                        cursor.keysA[comp * stride + bone] = cursor.keysB[comp * stride + bone];
+                    }
+                } else {
+                    decodeKey( channel, bone, Track( track ), key, stride, cursor.keysA.data() );
+                }
+                decodeKey( channel, bone, Track( track ), nextKey, stride, cursor.keysB.data() );
+                hint = key;
+                const float* times = &mKeyTimes[track][channel.keys[track].first];
+                cursor.validFrom[i] = key == 0 ? -inf : times[key];
+                cursor.validTo[i] = nextKey == key ? inf : times[nextKey];
+                cursor.keyTime[i] = times[key];
+                cursor.invSpan[i] = nextKey == key ? 0.0f : 1.0f / (times[nextKey] - times[key]);
+            }
+        }
+    }
+}
+
+void ModelAsset::Animation::GetGlobalPoseAtTime(
+    std::vector<glm::mat4>& outPoses,
+    const Skeleton* inSkeleton,
+    float inTime,
+    Cursor* cursor,
+    bool skipLeafBones ) const
+{
+    if ( outPoses.size() != mNumBones ) {
+        outPoses.resize( mNumBones );
+    }
+    if ( mNumBones == 0 ) { return; }
+
+    const size_t stride = mPaddedBones;
+    const float* keysA;
+    const float* keysB;
+    const float* blend;
+    if ( cursor )
+    {
+        // sequential playback: most tracks are still between the keys
+        // they were last sampled between, so only their blend changes
+        if ( cursor->anim != this ||
+                cursor->skipLeafBones != skipLeafBones ||
+                cursor->keys.size() != mNumBones * NUM_TRACKS ) {
+            resetCursor( *cursor, inSkeleton, skipLeafBones );
+        }
+        updateCursor( *cursor, inTime );
+        keysA = cursor->keysA.data();
+        keysB = cursor->keysB.data();
+        blend = cursor->blend.data();
+    }
+    else
+    {
+        // decode the 2 keys around inTime of every track into SoA frames
+        // for samplePoseKeys. Per thread, as crowds are posed on worker threads
+        static thread_local std::vector<float> sGather;
+        sGather.resize( (2 * NUM_KEY_COMPONENTS + NUM_TRACKS) * stride );
+        float* gatherA = sGather.data();
+        float* gatherB = gatherA + NUM_KEY_COMPONENTS * stride;
+        float* gatherBlend = gatherB + NUM_KEY_COMPONENTS * stride;
+        // bones without keys (and the padding) stay at the identity
+        fillIdentityKeys( gatherA, stride );
+        fillIdentityKeys( gatherB, stride );
+        std::fill( gatherBlend, gatherBlend + NUM_TRACKS * stride, 0.0f );
+        for ( size_t bone=0; bone<mNumBones; ++bone )
+        {
+            if ( skipLeafBones && inSkeleton->IsLeafBone( bone ) ) { continue; }
+            const Channel& channel = mChannels[bone];
+            for ( size_t track=0; track<NUM_TRACKS; ++track )
+            {
+                if ( channel.keys[track].count == 0 ) { continue; }
+                uint32_t key, nextKey;
+                // no hint; binary search
+                findKeys( channel, Track( track ), inTime, channel.keys[track].count, key, nextKey, gatherBlend[track * stride + bone] );
+                decodeKey( channel, bone, Track( track ), key, stride, gatherA );
+                decodeKey( channel, bone, Track( track ), nextKey, stride, gatherB );
+            }
+        }
+        keysA = gatherA;
+        keysB = gatherB;
+        blend = gatherBlend;
+    }
+
+    // local transforms of every bone straight into outPoses
+    samplePoseKeys( keysA, keysB, blend, stride, mNumBones, outPoses.data() );
+    if ( skipLeafBones ) {
+        for ( size_t bone=0; bone<mNumBones; ++bone ) {
+            if ( inSkeleton->IsLeafBone( bone ) ) {
+                outPoses[bone] = inSkeleton->GetLocalRestPose( bone );
+            }
+        }
+    }
+
+    // then concatenate down the hierarchy; parents come before their
+    // children (see Skeleton::Load), so it's one forward pass
+    const std::vector<Skeleton::Bone>& bones = inSkeleton->GetBones();
+    for ( size_t bone=0; bone<mNumBones; ++bone ) {
+        const int parent = bones[bone].mParent;
+        if ( parent >= 0 ) {
+            assert( size_t( parent ) < bone );
+            concatAffine( outPoses[parent], outPoses[bone] );
+        }
+    }
+}
+
+
@@ -0,0 +1,457 @@
+#ifndef MODEL_ASSET_H_INCLUDED
+#define MODEL_ASSET_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include <assimp/scene.h>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "VertexBuffer.h"
+#include "Skinning.h"
+#include "Bounds.h"
+#include "SceneGraph.h"
+
+/*
+ * Everything loaded from a model file that doesn't change after load:
+ * geometry, rigs and animation clips. Shared by every AssimpMesh of the
+ * same file, which only add their own transform, animation state and
+ * skinned output
+ */
+class ModelAsset
+{
+public:
+
+    enum SkinningMode
+    {
+        SKINNING_CPU, // skinned on the CPU, vertices re-uploaded every frame
+        SKINNING_GPU // bone indices/weights uploaded once, skinned in the vertex shader
+    };
+
+    // How much animation keys may be simplified at load. Keys are dropped
+    // while interpolating their neighbours stays within these; values are
+    // quantized either way
+    struct AnimCompression
+    {
+        float posTolerance; // model units
+        float rotTolerance; // radians
+        float sclTolerance;
+
+        AnimCompression() :
+            posTolerance( 0.001f ),
+            rotTolerance( 0.001f ),
+            sclTolerance( 0.001f )
+        {}
+    };
+
+    /**
+     * @brief Get the asset of a model file, loading it if no other
+     *      instance still holds it
+     *
+     * Assets are cached by file name and load settings while at least one
+     * shared_ptr to them exists. Creates GL objects, so main thread only.
+     */
+    static std::shared_ptr<const ModelAsset> Get(
+        const std::string& fileName,
+        SkinningMode skinningMode = SKINNING_CPU,
+        const AnimCompression& animCompression = AnimCompression()
+    );
+
+    // Loads the file; exits on failure. Prefer Get, which shares the asset
+    ModelAsset(
+        const std::string& fileName,
+        SkinningMode skinningMode,
+        const AnimCompression& animCompression
+    );
+
+    class Mesh
+    {
+    public:
+
+        // range of vertices that all have the same number of bone influences
+        struct InfluenceGroup
+        {
+            size_t begin;
+            size_t end;
+        };
+
+        Mesh();
+        ~Mesh();
+
+        // boneRemap: index into the mesh's Skeleton of each aiMesh bone,
+        // so vertex bone indices follow the skeleton's sorted order
+        bool Load(
+            const aiMesh* mesh,
+            const aiScene* scene,
+            SkinningMode skinningMode,
+            const std::vector<uint32_t>& boneRemap
+        );
+        void Unload(void);
+
+        // true if the vertex buffer holds VertexSkinned data for the GPU
+        bool IsGpuSkinned() const { return mGpuSkinned; }
+
+        // vertices are sorted by influence count at load;
+        // numInfluences in range [1,MAX_BONE_INFLUENCES]
+        const InfluenceGroup& GetInfluenceGroup( int numInfluences ) const {
+            return mInfluenceGroups[numInfluences-1];
+        }
+
+        const VertexBuffer&                 GetVertexBuffer() const { return *mVertBuf; }
+        std::shared_ptr<const VertexBuffer> GetVertexBufferPtr() const { return mVertBuf; }
+        const std::string&                  GetFileName() const { return mFileName; }
+        const std::vector<VertexTextured>&  GetVertices() const { return mVertices; }
+        const std::vector<VertBoneIndices>& GetBoneIndices() const { return mBoneIndices; }
+        const std::vector<VertBoneWeights>& GetBoneWeights() const { return mBoneWeights; }
+        const std::vector<uint32_t>&        GetIndices() const { return mIndices; }
+        // bind pose bounds
+        const Aabb&                         GetBounds() const { return mVertBuf->GetBounds(); }
+        // per skeleton bone, bind pose box of the vertices it influences;
+        // empty for bones that move none. Moved by the palette, their
+        // union holds the skinned mesh
+        const std::vector<Aabb>&            GetBoneBounds() const { return mBoneBounds; }
+
+    private:
+
+        std::shared_ptr<VertexBuffer> mVertBuf;
+        std::vector<VertexTextured> mVertices;
+        std::vector<VertBoneIndices> mBoneIndices;
+        std::vector<VertBoneWeights> mBoneWeights;
+        std::vector<Aabb> mBoneBounds;
+        std::vector<uint32_t> mIndices; // kept for CPU side users, e.g. occlusion culling
+        std::string mFileName;
+        bool mGpuSkinned;
+        InfluenceGroup mInfluenceGroups[MAX_BONE_INFLUENCES];
+
+        // reorder the vertex arrays by influence count, filling
+        // mInfluenceGroups and the old to new vertex index mapping
+        void sortByInfluenceCount(
+            const std::vector<unsigned int>& influenceCounts,
+            std::vector<uint32_t>& outOldToNewIdx
+        );
+    };
+
+
+    class Skeleton
+    {
+    public:
+
+        struct Bone
+        {
+            glm::mat4 mLocalBindPose;
+            std::string mName;
+            int mParent;
+        };
+
+        bool Load( const aiMesh* assimpMesh, const aiScene* scene );
+
+        size_t                        GetNumBones(void)           const { return mBones.size(); }
+        size_t                        GetRootBoneIdx(void)        const { return mRootBoneIdx; }
+        const Bone&                   GetBone( size_t idx )       const { return mBones[idx]; }
+        const std::vector<Bone>&      GetBones(void)              const { return mBones; }
+        const std::vector<glm::mat4>& GetGlobalInvBindPoses(void) const { return mGlobalInvBindPoses; }
+        const std::string&            GetFileName(void)           const { return mFileName; }
+        // index into mBones of each aiMesh bone, as bones are reordered at load
+        const std::vector<uint32_t>&  GetBoneRemap(void)          const { return mBoneRemap; }
+        // true if no other bone has this one as its parent
+        bool                          IsLeafBone( size_t idx )    const { return mIsLeaf[idx] != 0; }
+        // bind pose of a bone relative to its parent
+        const glm::mat4&              GetLocalRestPose( size_t idx ) const { return mLocalRestPoses[idx]; }
+
+        // index of the named bone, or -1 if this skeleton doesn't have it
+        int FindBone( const std::string& name ) const;
+
+        // Add the bones of other this skeleton lacks, reordered so every
+        // parent still comes first; shared bones keep this skeleton's bind
+        // pose. outRemap gets the new index of each old bone
+        void Merge( const Skeleton& other, const aiScene* scene, std::vector<uint32_t>& outRemap );
+
+    protected:
+        // Called automatically when the skeleton is loaded
+        // Computes the global inverse bind pose for each bone
+        void ComputeGlobalInvBindPose();
+    private:
+        // parent the bones by the scene's node tree, order them depth
+        // first and fill the derived per bone data. outRemap gets the
+        // index into mBones of each input bone
+        void build( std::vector<Bone> bones, const aiScene* scene, std::vector<uint32_t>& outRemap );
+        // The bones in the skeleton; sorted so every parent comes before
+        // its children, so global poses are one forward pass
+        std::vector<Bone> mBones;
+        std::vector<uint32_t> mBoneRemap;
+        std::vector<uint8_t> mIsLeaf;
+        std::vector<glm::mat4> mLocalRestPoses;
+        // The global inverse bind poses for each bone
+        std::vector<glm::mat4> mGlobalInvBindPoses;
+        // The file this was loaded from
+        std::string mFileName;
+        // which index into mBones is the root node
+        size_t mRootBoneIdx;
+    };
+
+
+    class Animation
+    {
+    public:
+
+        // per playback state: the decoded key pair each track was sampled
+        // between last. While a later time still falls between the same
+        // keys only the blend factor is recomputed; tracks that moved on
+        // look up their next keys from there. Rebuilt on clip changes
+        struct Cursor
+        {
+            const Animation* anim; // clip the cache was built for
+            bool skipLeafBones; // what it was built with
+            std::vector<uint32_t> keys; // [bone][track], key at or before the last time
+            // decoded key pairs, laid out as samplePoseKeys takes them
+            std::vector<float> keysA; // [component][bone]
+            std::vector<float> keysB;
+            std::vector<float> blend; // [track][bone]
+            // [track][bone]: the pair is valid for times in [validFrom,validTo);
+            // blend = (time - keyTime) * invSpan, clamped to [0,1]
+            std::vector<float> validFrom;
+            std::vector<float> validTo;
+            std::vector<float> keyTime;
+            std::vector<float> invSpan;
+
+            Cursor() : anim( nullptr ), skipLeafBones( false ) {}
+        };
+
+        // size and accuracy of the compressed keys against the source ones
+        struct CompressionStats
+        {
+            size_t rawBytes;
+            size_t compressedBytes;
+            // worst local error of any bone at any source key time
+            float maxPosError;
+            float maxRotError; // radians
+            float maxSclError;
+        };
+
+        bool Load(
+            const aiAnimation* assimpAnim,
+            const aiScene* scene,
+            const Skeleton* skeleton,
+            const AnimCompression& compression
+        );
+
+        size_t GetNumBones() const { return mNumBones; }
+        // total number of stored keys, over every track
+        size_t GetNumKeys() const;
+        const CompressionStats& GetCompressionStats() const { return mCompressionStats; }
+        float GetDuration() const { return mDuration; }
+        const std::string& GetName() const { return mName; }
+        void SetName( const std::string& newName ) { mName = newName; }
+
+        // Fills the provided vector with the global (current) pose matrices
+        // for each bone at the specified time in the anim.
+        // Time must be >= 0.0f && <= mDuration.
+        // cursor is optional; without one every key is binary searched.
+        // skipLeafBones holds leaf bones (fingers, toes, ...) at their bind
+        // pose instead of sampling them, for distant instances
+        void GetGlobalPoseAtTime(
+            std::vector<glm::mat4>& outPoses,
+            const Skeleton* inSkeleton,
+            float inTime,
+            Cursor* cursor = nullptr,
+            bool skipLeafBones = false
+        ) const;
+
+        // components of one key; each is stored as its own array per frame
+        enum KeyComponent
+        {
+            KEY_POS_X, KEY_POS_Y, KEY_POS_Z,
+            KEY_ROT_X, KEY_ROT_Y, KEY_ROT_Z, KEY_ROT_W,
+            KEY_SCL_X, KEY_SCL_Y, KEY_SCL_Z,
+            NUM_KEY_COMPONENTS
+        };
+        // bones sampled per SIMD step; bone arrays are padded to a multiple
+        static const size_t SIMD_BONES = 4;
+
+        // each channel is keyed separately for position, rotation and scale
+        enum Track
+        {
+            TRACK_POS,
+            TRACK_ROT,
+            TRACK_SCL,
+            NUM_TRACKS
+        };
+
+        // rotation as its 3 smallest components, 15 bits each; the 2 bit
+        // index of the dropped largest one is in the top bits of v[0],v[1]
+        struct PackedQuat
+        {
+            uint16_t v[3];
+        };
+        // q is normalized first; unpacking gives q or -q, the same rotation
+        static PackedQuat packQuat( const glm::quat& q );
+        static glm::quat unpackQuat( const PackedQuat& packed );
+
+    private:
+        size_t mNumBones;
+        size_t mPaddedBones; // mNumBones rounded up to SIMD_BONES
+
+        float mDuration; // total anim length in seconds
+
+        // a bone's keys of one track: [first,first+count) of that track's
+        // arrays. count 0 = no channel or an identity track, the bone
+        // keeps the identity; count 1 = constant track
+        struct KeyRange
+        {
+            uint32_t first;
+            uint32_t count;
+        };
+        // position or scale as a fraction of the channel's value range
+        struct PackedVec3
+        {
+            uint16_t v[3];
+        };
+        struct Channel
+        {
+            KeyRange keys[NUM_TRACKS];
+            // decoded value = min + packed * step
+            glm::vec3 posMin;
+            glm::vec3 posStep;
+            glm::vec3 sclMin;
+            glm::vec3 sclStep;
+        };
+        std::vector<Channel> mChannels; // per bone
+
+        // kept keys of every channel back to back
+        std::vector<float> mKeyTimes[NUM_TRACKS]; // seconds, ascending per channel
+        std::vector<PackedVec3> mPosKeys;
+        std::vector<PackedQuat> mRotKeys;
+        std::vector<PackedVec3> mSclKeys;
+
+        CompressionStats mCompressionStats;
+
+        static PackedVec3 packVec3( const glm::vec3& v, const glm::vec3& min, const glm::vec3& step );
+        static glm::vec3 unpackVec3( const PackedVec3& packed, const glm::vec3& min, const glm::vec3& step );
+        // decoded key of a bone's track
+        glm::vec3 getPosKey( const Channel& channel, uint32_t key ) const {
+            return unpackVec3( mPosKeys[channel.keys[TRACK_POS].first + key], channel.posMin, channel.posStep );
+        }
+        glm::quat getRotKey( const Channel& channel, uint32_t key ) const {
+            return unpackQuat( mRotKeys[channel.keys[TRACK_ROT].first + key] );
+        }
+        glm::vec3 getSclKey( const Channel& channel, uint32_t key ) const {
+            return unpackVec3( mSclKeys[channel.keys[TRACK_SCL].first + key], channel.sclMin, channel.sclStep );
+        }
+        // keys around time in a track: the one at or before it, the one
+        // after it and the blend between them. hint as in Cursor
+        void findKeys(
+            const Channel& channel,
+            Track track,
+            float time,
+            uint32_t hint,
+            uint32_t& outKey,
+            uint32_t& outNextKey,
+            float& outBlend
+        ) const;
+
+        // decode one key of a bone's track into an SoA frame (see
+        // samplePoseKeys); the track must have keys
+        void decodeKey(
+            const Channel& channel,
+            size_t bone,
+            Track track,
+            uint32_t key,
+            size_t stride,
+            float* keys
+        ) const;
+        // size a cursor for this clip and mark every keyed track stale
+        void resetCursor( Cursor& cursor, const Skeleton* skeleton, bool skipLeafBones ) const;
+        // bring a cursor's stale tracks to time and its blends up to date
+        void updateCursor( Cursor& cursor, float time ) const;
+
+        // interpolate the local transform of every bone between 2 gathered
+        // SoA frames, [component][bone]; blend is [track][bone] and stride
+        // is the padded bone count between components
+        static void samplePoseKeys(
+            const float* keysA,
+            const float* keysB,
+            const float* blend,
+            size_t stride,
+            size_t numBones,
+            glm::mat4* outLocal
+        );
+        // one bone at a time version of the above for bones [firstBone,endBone)
+        static void samplePoseKeysScalar(
+            const float* keysA,
+            const float* keysB,
+            const float* blend,
+            size_t stride,
+            size_t firstBone,
+            size_t endBone,
+            glm::mat4* outLocal
+        );
+
+        // file this was loaded from
+        std::string mName;
+    };
+
+
+    // How a sub mesh's bones map into its shared skeleton
+    struct MeshSkin
+    {
+        size_t skeletonIdx; // into the skeletons; NO_SKELETON if the mesh has no bones
+        std::vector<uint32_t> boneMap; // mesh bone index -> skeleton bone index
+        std::vector<glm::mat4> invBindPoses; // per mesh bone
+    };
+    static const size_t NO_SKELETON = (size_t)-1;
+
+    const std::string&                            GetFileName(void)     const { return mFileName; }
+    SkinningMode                                  GetSkinningMode(void) const { return mSkinningMode; }
+    const std::vector<Mesh>&                      GetMeshes(void)       const { return mMeshes; }
+    const std::vector<MeshSkin>&                  GetMeshSkins(void)    const { return mMeshSkins; }
+    const std::vector<Skeleton>&                  GetSkeletons(void)    const { return mSkeletons; }
+    const std::vector<std::vector<Animation>>&    GetAnimations(void)   const { return mAnimations; }
+    const std::vector<std::string>&               GetAnimNames(void)    const { return mAnimNames; }
+    // the file's node hierarchy with each node's local transform
+    const SceneGraph&                             GetSceneGraph(void)   const { return mSceneGraph; }
+    // per mesh, the scene graph node it hangs from
+    const std::vector<uint32_t>&                  GetMeshNodes(void)    const { return mMeshNodes; }
+
+private:
+
+    std::string mFileName;
+    SkinningMode mSkinningMode;
+    std::vector<Mesh> mMeshes;
+    std::vector<MeshSkin> mMeshSkins;
+    // unique rigs; sub meshes whose bones are all in the same rig share it,
+    // so each rig is posed once per Update regardless of sub mesh count
+    std::vector<Skeleton> mSkeletons;
+    // clips for each rig, [skeleton][anim], as tracks are indexed by rig bone
+    std::vector<std::vector<Animation>> mAnimations;
+    std::vector<std::string> mAnimNames;
+    SceneGraph mSceneGraph;
+    std::vector<uint32_t> mMeshNodes;
+
+    // loaded assets by file name and settings; expired once the last
+    // instance is gone
+    static std::unordered_map<std::string, std::weak_ptr<const ModelAsset>> sCache;
+
+    bool processNode(
+        const aiNode* node,
+        const aiScene* scene,
+        const int parentNode,
+        size_t& curMesh
+    );
+    // merge the given mesh skeleton into the rig it overlaps, or add it
+    // as a new rig, and fill the mesh's MeshSkin
+    void addMeshSkeleton( const Skeleton& meshSkeleton, const aiScene* scene, MeshSkin& outSkin );
+    // the bones of a rig moved to remap[old index]; update its meshes
+    void remapRig( const size_t skelIdx, const std::vector<uint32_t>& remap );
+};
+
+#endif // MODEL_ASSET_H_INCLUDED
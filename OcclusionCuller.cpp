@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <cmath>
+
+#include "OcclusionCuller.h"
+#include "ThreadPool.h"
+#include "Simd.h"
+
+// depth of an empty pixel; the far plane
+static const float CLEAR_DEPTH = 1.0f;
+
+OcclusionCuller::OcclusionCuller( const size_t width, const size_t height ) :
+    mWidth( (width + 3) & ~size_t(3) ),
+    mHeight( height ),
+    mViewProj( 1.0f )
+{
+    mTilesX = (mWidth + TILE_WIDTH - 1) / TILE_WIDTH;
+    mTilesY = (mHeight + TILE_HEIGHT - 1) / TILE_HEIGHT;
+    mDepth.assign( mWidth * mHeight, CLEAR_DEPTH );
+    mTileTris.resize( mTilesX * mTilesY );
+}
+
+void OcclusionCuller::BeginFrame( const glm::mat4& viewProj )
+{
+    mViewProj = viewProj;
+    std::fill( mDepth.begin(), mDepth.end(), CLEAR_DEPTH );
+    mTris.clear();
+    for ( std::vector<uint32_t>& tileTris : mTileTris ) {
+        tileTris.clear();
+    }
+}
+
+void OcclusionCuller::AddOccluder(
+    const glm::mat4& modelMat,
+    const float* positions,
+    const size_t positionStride,
+    const size_t numVertices,
+    const uint32_t* indices,
+    const size_t numIndices )
+{
+    const glm::mat4 mvp = mViewProj * modelMat;
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>( positions );
+    mClipScratch.resize( numVertices );
+    for ( size_t i=0; i<numVertices; ++i ) {
+        const float* pos = reinterpret_cast<const float*>( bytes + i * positionStride );
+        mClipScratch[i] = mvp * glm::vec4( pos[0], pos[1], pos[2], 1.0f );
+    }
+
+    const float width = float( mWidth );
+    const float height = float( mHeight );
+    for ( size_t i=0; i+2<numIndices; i+=3 )
+    {
+        Tri tri;
+        bool clipped = false;
+        for ( int v=0; v<3; ++v ) {
+            const glm::vec4& clip = mClipScratch[indices[i + v]];
+            // crossing the near plane; dropping it keeps the occluder
+            // conservative without clipping
+            if ( clip.w <= 0.0f || clip.z < -clip.w ) {
+                clipped = true;
+                break;
+            }
+            const float invW = 1.0f / clip.w;
+            tri.x[v] = (clip.x * invW * 0.5f + 0.5f) * width;
+            tri.y[v] = (clip.y * invW * 0.5f + 0.5f) * height;
+            tri.z[v] = clip.z * invW * 0.5f + 0.5f;
+        }
+        if ( clipped ) { continue; }
+
+        // back faces are hidden by front faces of a closed occluder, and
+        // leaving them out of an open one only shrinks it
+        const float area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) -
+                           (tri.x[2] - tri.x[0]) * (tri.y[1] - tri.y[0]);
+        if ( area <= 0.0f ) { continue; }
+
+        tri.minX = std::max( int( std::floor( std::min( tri.x[0], std::min( tri.x[1], tri.x[2] )))), 0 );
+        tri.minY = std::max( int( std::floor( std::min( tri.y[0], std::min( tri.y[1], tri.y[2] )))), 0 );
+        tri.maxX = std::min( int( std::floor( std::max( tri.x[0], std::max( tri.x[1], tri.x[2] )))), int( mWidth ) - 1 );
+        tri.maxY = std::min( int( std::floor( std::max( tri.y[0], std::max( tri.y[1], tri.y[2] )))), int( mHeight ) - 1 );
+        if ( tri.minX > tri.maxX || tri.minY > tri.maxY ) { continue; }
+
+        // bin into every tile its bounds touch
+        const uint32_t triIdx = uint32_t( mTris.size() );
+        mTris.push_back( tri );
+        for ( size_t ty = tri.minY / TILE_HEIGHT; ty <= tri.maxY / TILE_HEIGHT; ++ty ) {
+            for ( size_t tx = tri.minX / TILE_WIDTH; tx <= tri.maxX / TILE_WIDTH; ++tx ) {
+                mTileTris[ty * mTilesX + tx].push_back( triIdx );
+            }
+        }
+    }
+}
+
+void OcclusionCuller::RasterizeOccluders()
+{
+    // tiles don't share pixels, so they need no locking
+    ThreadPool::GetInstance()->ParallelForDynamic(
+        mTileTris.size(),
+        1,
+        [this]( size_t begin, size_t end ) {
+            for ( size_t tile=begin; tile<end; ++tile ) {
+                rasterizeTile( tile );
+            }
+        }
+    );
+}
+
+void OcclusionCuller::rasterizeTile( const size_t tile )
+{
+    const int tileMinX = int( (tile % mTilesX) * TILE_WIDTH );
+    const int tileMinY = int( (tile / mTilesX) * TILE_HEIGHT );
+    const int tileMaxX = std::min( tileMinX + int( TILE_WIDTH ), int( mWidth ) ) - 1;
+    const int tileMaxY = std::min( tileMinY + int( TILE_HEIGHT ), int( mHeight ) ) - 1;
+
+    for ( const uint32_t triIdx : mTileTris[tile] )
+    {
+        const Tri& tri = mTris[triIdx];
+        // whole SIMD steps; tiles are a multiple of 4 wide so they stay inside it
+        const int minX = std::max( tri.minX, tileMinX ) & ~3;
+        const int maxX = std::min( tri.maxX, tileMaxX );
+        const int minY = std::max( tri.minY, tileMinY );
+        const int maxY = std::min( tri.maxY, tileMaxY );
+
+        // edge functions, >= 0 inside a counter clockwise triangle:
+        // e = a*x + b*y + c for the edge from vertex v to v+1
+        float a[3], b[3], c[3];
+        for ( int v=0; v<3; ++v ) {
+            const int next = (v + 1) % 3;
+            a[v] = tri.y[v] - tri.y[next];
+            b[v] = tri.x[next] - tri.x[v];
+            c[v] = -(a[v] * tri.x[v] + b[v] * tri.y[v]);
+        }
+        // depth plane from the barycentric weights of vertices 1 and 2,
+        // which are the edge functions opposite them over the area
+        const float invArea = 1.0f / (a[0] * tri.x[2] + b[0] * tri.y[2] + c[0]);
+        const float dz1 = tri.z[1] - tri.z[0];
+        const float dz2 = tri.z[2] - tri.z[0];
+        const float dzdx = (a[2] * dz1 + a[0] * dz2) * invArea;
+        const float dzdy = (b[2] * dz1 + b[0] * dz2) * invArea;
+        // farthest depth within a pixel rather than at its center
+        const float z0 = tri.z[0] - dzdx * tri.x[0] - dzdy * tri.y[0] +
+                         0.5f * (std::fabs( dzdx ) + std::fabs( dzdy ));
+
+#ifdef SIMD_SSE2
+        const __m128 laneOffsets = _mm_setr_ps( 0.5f, 1.5f, 2.5f, 3.5f );
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 stepE0 = _mm_set1_ps( 4.0f * a[0] );
+        const __m128 stepE1 = _mm_set1_ps( 4.0f * a[1] );
+        const __m128 stepE2 = _mm_set1_ps( 4.0f * a[2] );
+        const __m128 stepZ = _mm_set1_ps( 4.0f * dzdx );
+        for ( int y=minY; y<=maxY; ++y )
+        {
+            // pixel centers of the first 4 pixels of the row
+            const float py = float( y ) + 0.5f;
+            const __m128 px = _mm_add_ps( _mm_set1_ps( float( minX )), laneOffsets );
+            __m128 e0 = _mm_add_ps( _mm_mul_ps( px, _mm_set1_ps( a[0] )), _mm_set1_ps( b[0] * py + c[0] ));
+            __m128 e1 = _mm_add_ps( _mm_mul_ps( px, _mm_set1_ps( a[1] )), _mm_set1_ps( b[1] * py + c[1] ));
+            __m128 e2 = _mm_add_ps( _mm_mul_ps( px, _mm_set1_ps( a[2] )), _mm_set1_ps( b[2] * py + c[2] ));
+            __m128 z = _mm_add_ps( _mm_mul_ps( px, _mm_set1_ps( dzdx )), _mm_set1_ps( dzdy * py + z0 ));
+
+            float* row = &mDepth[y * mWidth];
+            for ( int x=minX; x<=maxX; x+=4 )
+            {
+                const __m128 inside = _mm_and_ps(
+                    _mm_cmpge_ps( e0, zero ),
+                    _mm_and_ps( _mm_cmpge_ps( e1, zero ), _mm_cmpge_ps( e2, zero ))
+                );
+                if ( _mm_movemask_ps( inside ) != 0 ) {
+                    const __m128 oldDepth = _mm_loadu_ps( row + x );
+                    const __m128 newDepth = _mm_min_ps( oldDepth, z );
+                    _mm_storeu_ps( row + x, _mm_or_ps(
+                        _mm_and_ps( inside, newDepth ),
+                        _mm_andnot_ps( inside, oldDepth )
+                    ));
+                }
+                e0 = _mm_add_ps( e0, stepE0 );
+                e1 = _mm_add_ps( e1, stepE1 );
+                e2 = _mm_add_ps( e2, stepE2 );
+                z = _mm_add_ps( z, stepZ );
+            }
+        }
+#else
+        for ( int y=minY; y<=maxY; ++y )
+        {
+            const float py = float( y ) + 0.5f;
+            float* row = &mDepth[y * mWidth];
+            for ( int x=minX; x<=maxX; ++x ) {
+                const float px = float( x ) + 0.5f;
+                if ( a[0] * px + b[0] * py + c[0] >= 0.0f &&
+                     a[1] * px + b[1] * py + c[1] >= 0.0f &&
+                     a[2] * px + b[2] * py + c[2] >= 0.0f ) {
+                    row[x] = std::min( row[x], z0 + dzdx * px + dzdy * py );
+                }
+            }
+        }
+#endif
+    }
+}
+
+bool OcclusionCuller::IsVisible( const Aabb& worldBox ) const
+{
+    if ( worldBox.IsEmpty() ) { return false; }
+
+    // screen rect and nearest depth of the 8 corners
+    float minX = float( mWidth ), minY = float( mHeight ), maxX = 0.0f, maxY = 0.0f;
+    float minZ = CLEAR_DEPTH;
+    for ( int i=0; i<8; ++i )
+    {
+        const glm::vec4 corner(
+            (i & 1) ? worldBox.max.x : worldBox.min.x,
+            (i & 2) ? worldBox.max.y : worldBox.min.y,
+            (i & 4) ? worldBox.max.z : worldBox.min.z,
+            1.0f
+        );
+        const glm::vec4 clip = mViewProj * corner;
+        // reaches the camera; can't be behind anything
+        if ( clip.w <= 0.0f || clip.z < -clip.w ) {
+            return true;
+        }
+        const float invW = 1.0f / clip.w;
+        const float x = (clip.x * invW * 0.5f + 0.5f) * float( mWidth );
+        const float y = (clip.y * invW * 0.5f + 0.5f) * float( mHeight );
+        minX = std::min( minX, x ); maxX = std::max( maxX, x );
+        minY = std::min( minY, y ); maxY = std::max( maxY, y );
+        minZ = std::min( minZ, clip.z * invW * 0.5f + 0.5f );
+    }
+
+    if ( maxX < 0.0f || maxY < 0.0f || minX >= float( mWidth ) || minY >= float( mHeight ) ) {
+        // off screen; that's for frustum culling to decide
+        return true;
+    }
+    // Every overlapped pixel, grown by one. Occluders write a pixel once
+    // they cover its center, so an edge pixel can be only partly hidden;
+    // the pixel next to it across the edge is then left empty, and the
+    // extra ring reaches it
+    const int x0 = std::max( int( std::floor( minX )) - 1, 0 );
+    const int y0 = std::max( int( std::floor( minY )) - 1, 0 );
+    const int x1 = std::min( int( std::floor( maxX )) + 1, int( mWidth ) - 1 );
+    const int y1 = std::min( int( std::floor( maxY )) + 1, int( mHeight ) - 1 );
+
+    // visible if any pixel's occluder is farther than the box's nearest point
+#ifdef SIMD_SSE2
+    const __m128 boxZ = _mm_set1_ps( minZ );
+    const int firstMask = 0xF & (0xF << (x0 & 3));
+    const int lastMask = 0xF >> (3 - (x1 & 3));
+    for ( int y=y0; y<=y1; ++y ) {
+        const float* row = &mDepth[y * mWidth];
+        for ( int x=x0 & ~3; x<=x1; x+=4 ) {
+            int mask = _mm_movemask_ps( _mm_cmpge_ps( _mm_loadu_ps( row + x ), boxZ ));
+            if ( x == (x0 & ~3) ) { mask &= firstMask; }
+            if ( x == (x1 & ~3) ) { mask &= lastMask; }
+            if ( mask != 0 ) { return true; }
+        }
+    }
+#else
+    for ( int y=y0; y<=y1; ++y ) {
+        const float* row = &mDepth[y * mWidth];
+        for ( int x=x0; x<=x1; ++x ) {
+            if ( row[x] >= minZ ) { return true; }
+        }
+    }
+#endif
+    return false;
+}
+
+size_t OcclusionCuller::CullBoxes( const Aabb* worldBoxes, const size_t count, uint8_t* outVisible ) const
+{
+    ThreadPool::GetInstance()->ParallelFor(
+        count,
+        CULL_CHUNK_SIZE,
+        [this,worldBoxes,outVisible]( size_t begin, size_t end ) {
+            for ( size_t i=begin; i<end; ++i ) {
+                outVisible[i] = IsVisible( worldBoxes[i] ) ? 1 : 0;
+            }
+        }
+    );
+    size_t numVisible = 0;
+    for ( size_t i=0; i<count; ++i ) {
+        numVisible += outVisible[i];
+    }
+    return numVisible;
+}
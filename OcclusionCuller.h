@@ -0,0 +1,95 @@
+#ifndef OCCLUSION_CULLER_H_INCLUDED
+#define OCCLUSION_CULLER_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+/* Software occlusion culling. Large occluders (walls, buildings) are
+ * rasterized into a small CPU depth buffer, then object bounds are tested
+ * against it. Doesn't touch GL, so it also runs headless.
+ * Per frame: BeginFrame, AddOccluder..., RasterizeOccluders, then any
+ * number of IsVisible/CullBoxes calls */
+class OcclusionCuller
+{
+public:
+
+    // width is rounded up to a multiple of 4 (one SIMD step)
+    OcclusionCuller( const size_t width = 256, const size_t height = 128 );
+
+    // Clear the depth buffer and drop last frame's occluders
+    void BeginFrame( const glm::mat4& viewProj );
+
+    /**
+     * @brief Queue an indexed triangle mesh to be rasterized as an occluder
+     *
+     * Only the front faces of triangles fully in front of the near plane
+     * are kept, which can only make the occluder smaller, never larger.
+     *
+     * @param modelMat model to world matrix
+     * @param positions first vertex position; 3 floats per vertex
+     * @param positionStride bytes from one position to the next
+     * @param numVertices number of vertices
+     * @param indices 3 per triangle
+     * @param numIndices number of indices
+     */
+    void AddOccluder(
+        const glm::mat4& modelMat,
+        const float* positions,
+        const size_t positionStride,
+        const size_t numVertices,
+        const uint32_t* indices,
+        const size_t numIndices
+    );
+
+    // Rasterize the queued occluders, one ThreadPool job per tile
+    void RasterizeOccluders();
+
+    // false if a world space box is fully behind the occluders
+    bool IsVisible( const Aabb& worldBox ) const;
+    // Test many world space boxes across the ThreadPool; outVisible[i]
+    // is set to 0 for hidden boxes and 1 otherwise. Returns the number visible
+    size_t CullBoxes( const Aabb* worldBoxes, const size_t count, uint8_t* outVisible ) const;
+
+    size_t GetWidth() const { return mWidth; }
+    size_t GetHeight() const { return mHeight; }
+    // depth per pixel, row by row from the bottom; 1 = nothing rasterized
+    const float* GetDepthBuffer() const { return mDepth.data(); }
+    size_t GetNumOccluderTris() const { return mTris.size(); }
+
+private:
+
+    // the buffer is split into tiles rasterized in parallel
+    static const size_t TILE_WIDTH = 64;
+    static const size_t TILE_HEIGHT = 32;
+    // min number of boxes tested per worker thread job
+    static const size_t CULL_CHUNK_SIZE = 64;
+
+    // screen space triangle, counter clockwise
+    struct Tri
+    {
+        float x[3];
+        float y[3];
+        float z[3]; // depth, 0 = near plane, 1 = far plane
+        int minX, minY, maxX, maxY; // pixel bounds, clamped to the buffer
+    };
+
+    size_t mWidth;
+    size_t mHeight;
+    size_t mTilesX;
+    size_t mTilesY;
+    glm::mat4 mViewProj;
+    std::vector<float> mDepth;
+    std::vector<Tri> mTris;
+    std::vector<std::vector<uint32_t>> mTileTris; // per tile, indices into mTris
+    std::vector<glm::vec4> mClipScratch; // AddOccluder's transformed vertices
+
+    // rasterize every triangle binned into a tile
+    void rasterizeTile( const size_t tile );
+};
+
+#endif // OCCLUSION_CULLER_H_INCLUDED
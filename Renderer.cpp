@@ -1,8 +1,30 @@
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+#include <limits>
 #include "Renderer.h"
 
 // static class instance
 Renderer Renderer::sInstance;
-Renderer::Renderer()
+Renderer::Renderer() :
+    mNearPlane( 0.1f ),
+    mFarPlane( 1000.0f ),
+    mCurShader( nullptr ),
+    mBonePaletteUBO( 0 ),
+    mUniformBufferAlignment( 256 ),
+    mFrameUniformsUBO( 0 ),
+    mFrameUniformsDirty( true ),
+    mDrawUniformsUBO( 0 ),
+    mDrawUniformsStride( 0 ),
+    mDrawUniformsOffset( 0 ),
+    mOcclusionCuller( nullptr ),
+    mInstanceVBO( 0 ),
+    mCrowdPaletteBuffer( 0 ),
+    mCrowdPaletteTexture( 0 ),
+    mMaxTextureBufferTexels( 0 ),
+    mCurTexture( 0 ),
+    mBoundTexture( 0 ),
+    mBoundVAO( 0 )
 {}
 
 // Initialization
@@ -41,13 +63,91 @@ void Renderer::Init( const char *title, const int width, const int height )
     // init glew
     glewInit();
 
-    mProjMat = glm::perspective( glm::radians(60.0f), float(mWidth)/float(mHeight), 0.1f, 1000.0f );
+    mProjMat = glm::perspective( glm::radians(60.0f), float(mWidth)/float(mHeight), mNearPlane, mFarPlane );
     mViewMat = glm::mat4( 1.0f );
 
-    mTexturedLitShader = std::make_unique<Shader>(
+    mTexturedLitShader = createLitShader(
         "shaders/TexLitVertexShader.glsl",
         "shaders/TexLitFragmentShader.glsl"
     );
+    mTexturedLitInstShader = createLitShader(
+        "shaders/TexLitInstVertShader.glsl",
+        "shaders/TexLitFragmentShader.glsl"
+    );
+    mSkinnedLitShader = createLitShader(
+        "shaders/SkelVertShader.glsl",
+        "shaders/TexLitFragmentShader.glsl"
+    );
+    mSkinnedLitShader->SetUniformBlockBinding( "BonePalette", BONE_PALETTE_BINDING );
+    mDqSkinnedLitShader = createLitShader(
+        "shaders/SkelDqVertShader.glsl",
+        "shaders/TexLitFragmentShader.glsl"
+    );
+    mDqSkinnedLitShader->SetUniformBlockBinding( "BoneDualQuats", BONE_PALETTE_BINDING );
+    mSkinnedLitInstShader = createLitShader(
+        "shaders/SkelInstVertShader.glsl",
+        "shaders/TexLitFragmentShader.glsl"
+    );
+    mSkinnedLitInstShader->Use();
+    mSkinnedLitInstShader->SetInt( "uBonePalettes", CROWD_PALETTE_TEXTURE_UNIT );
+    mDqSkinnedLitInstShader = createLitShader(
+        "shaders/SkelDqInstVertShader.glsl",
+        "shaders/TexLitFragmentShader.glsl"
+    );
+    mDqSkinnedLitInstShader->Use();
+    mDqSkinnedLitInstShader->SetInt( "uBoneDqs", CROWD_PALETTE_TEXTURE_UNIT );
+    mCurShader = nullptr;
+    mCurTexture = 0;
+    mBoundTexture = 0;
+    mBoundVAO = 0;
+    mQueueStats.numDraws = 0;
+    mQueueStats.numCulled = 0;
+    mQueueStats.numOccluded = 0;
+    mQueueStats.stateChanges = 0;
+    mQueueStats.savedStateChanges = 0;
+
+    // glBindBufferRange offsets must be a multiple of the UBO alignment
+    GLint uboAlignment = 256;
+    glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uboAlignment );
+    mUniformBufferAlignment = uboAlignment;
+
+    // sized to the frame's palettes at each Flush
+    glGenBuffers( 1, &mBonePaletteUBO );
+    glBindBuffer( GL_UNIFORM_BUFFER, mBonePaletteUBO );
+    glBufferData( GL_UNIFORM_BUFFER, BONE_PALETTE_BLOCK_SIZE, nullptr, GL_STREAM_DRAW );
+
+    glGenBuffers( 1, &mFrameUniformsUBO );
+    glBindBuffer( GL_UNIFORM_BUFFER, mFrameUniformsUBO );
+    glBufferData( GL_UNIFORM_BUFFER, sizeof( FrameUniforms ), nullptr, GL_DYNAMIC_DRAW );
+    glBindBufferBase( GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, mFrameUniformsUBO );
+    mFrameUniformsDirty = true;
+
+    mDrawUniformsStride =
+        (sizeof( DrawUniforms ) + uboAlignment - 1) / uboAlignment * uboAlignment;
+    mDrawUniformsOffset = 0;
+    glGenBuffers( 1, &mDrawUniformsUBO );
+    glBindBuffer( GL_UNIFORM_BUFFER, mDrawUniformsUBO );
+    glBufferData(
+        GL_UNIFORM_BUFFER,
+        DRAW_UNIFORMS_RING_SLOTS * mDrawUniformsStride,
+        nullptr,
+        GL_STREAM_DRAW
+    );
+    glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+
+    glGenBuffers( 1, &mInstanceVBO );
+
+    // RGBA32F texels, so each palette matrix is 4 texels
+    glGetIntegerv( GL_MAX_TEXTURE_BUFFER_SIZE, &mMaxTextureBufferTexels );
+    glGenBuffers( 1, &mCrowdPaletteBuffer );
+    glBindBuffer( GL_TEXTURE_BUFFER, mCrowdPaletteBuffer );
+    glBufferData( GL_TEXTURE_BUFFER, sizeof( glm::mat4 ), nullptr, GL_STREAM_DRAW );
+    glBindBuffer( GL_TEXTURE_BUFFER, 0 );
+    glGenTextures( 1, &mCrowdPaletteTexture );
+    glActiveTexture( GL_TEXTURE0 + CROWD_PALETTE_TEXTURE_UNIT );
+    glBindTexture( GL_TEXTURE_BUFFER, mCrowdPaletteTexture );
+    glTexBuffer( GL_TEXTURE_BUFFER, GL_RGBA32F, mCrowdPaletteBuffer );
+    glActiveTexture( GL_TEXTURE0 );
 
     mAmbientLight = glm::vec3(1.0f,1.0f,1.0f);
     for ( int i=0; i<MAX_POS_LIGHTS; ++i) {
@@ -62,6 +162,24 @@ void Renderer::Init( const char *title, const int width, const int height )
 
 Renderer::~Renderer()
 {
+    if ( mBonePaletteUBO != 0 ) {
+        glDeleteBuffers( 1, &mBonePaletteUBO );
+    }
+    if ( mFrameUniformsUBO != 0 ) {
+        glDeleteBuffers( 1, &mFrameUniformsUBO );
+    }
+    if ( mDrawUniformsUBO != 0 ) {
+        glDeleteBuffers( 1, &mDrawUniformsUBO );
+    }
+    if ( mInstanceVBO != 0 ) {
+        glDeleteBuffers( 1, &mInstanceVBO );
+    }
+    if ( mCrowdPaletteTexture != 0 ) {
+        glDeleteTextures( 1, &mCrowdPaletteTexture );
+    }
+    if ( mCrowdPaletteBuffer != 0 ) {
+        glDeleteBuffers( 1, &mCrowdPaletteBuffer );
+    }
     SDL_GL_DeleteContext( mContext );
     SDL_DestroyWindow( mWindow );
     SDL_Quit();
@@ -75,7 +193,7 @@ void Renderer::Clear()
 
 void Renderer::SetTexture( const Texture& tex )
 {
-    glBindTexture( GL_TEXTURE_2D, tex.mTextureID );
+    mCurTexture = tex.mTextureID;
 }
 
 void Renderer::SetAmbientLight( float r, float g, float b )
@@ -83,6 +201,7 @@ void Renderer::SetAmbientLight( float r, float g, float b )
     mAmbientLight.x = r;
     mAmbientLight.y = g;
     mAmbientLight.z = b;
+    mFrameUniformsDirty = true;
 }
 
 bool Renderer::SetPosLight( const PositionalLight& lgt, const size_t index )
@@ -90,6 +209,7 @@ bool Renderer::SetPosLight( const PositionalLight& lgt, const size_t index )
     if ( index >= MAX_POS_LIGHTS ) { return false; }
     mPosLights[index].position = lgt.position;
     mPosLights[index].diffuse = lgt.diffuse;
+    mFrameUniformsDirty = true;
     return true;
 }
 
@@ -98,54 +218,574 @@ bool Renderer::SetDirLight( const DirectionalLight& lgt, const size_t index )
     if ( index >= MAX_DIR_LIGHTS ) { return false; }
     mDirLights[index].direction = lgt.direction;
     mDirLights[index].diffuse = lgt.diffuse;
+    mFrameUniformsDirty = true;
     return true;
 }
 
-void Renderer::DrawVertexBuffer( const glm::mat4& modelMat, const VertexBuffer& vb )
+void Renderer::DrawVertexBuffer(
+    const glm::mat4& modelMat,
+    const VertexBuffer& vb,
+    const BoundingSphere* bounds )
 {
-    glm::mat4 mvpMat = mProjMat * mViewMat * modelMat;
-    glm::mat4 normalMat = glm::inverse( glm::transpose( modelMat ));
-
-    // Change shaders if necessary
+    if ( bounds == nullptr ) {
+        bounds = &vb.GetBoundingSphere();
+    }
     switch (vb.mType)
     {
     case VertexBuffer::POS_TEXCOORD:
-        if ( mCurShader != mTexturedLitShader.get() ) {
-            mCurShader = mTexturedLitShader.get();
-            //printf("Set cur shader sPosTexcoordShader\n");
-            mCurShader->Use();
-        }
+        queueDraw( mTexturedLitShader.get(), modelMat, vb, nullptr, 0, bounds );
         break;
     default:
         std::cerr << "DrawVertexBuffer: unhandled vertex buffer type" << std::endl;
         return;
     }
+}
 
-    mCurShader->SetVec3( "uAmbient", mAmbientLight );
-    for ( int i=0; i<MAX_POS_LIGHTS; ++i ) {
-        char ufrmName[256];
-        sprintf( ufrmName, "uPosLgtPos%d", i );
-        mCurShader->SetVec3( ufrmName, mPosLights[i].position );
-        sprintf( ufrmName, "uPosLgtDff%d", i );
-        mCurShader->SetVec3( ufrmName, mPosLights[i].diffuse );
-    }
-    for ( int i=0; i<MAX_DIR_LIGHTS; ++i ) {
-        char ufrmName[256];
-        sprintf( ufrmName, "uDirLgtDir%d", i );
-        mCurShader->SetVec3( ufrmName, mDirLights[i].direction );
-        sprintf( ufrmName, "uDirLgtDff%d", i );
-        mCurShader->SetVec3( ufrmName, mDirLights[i].diffuse );
-    }
-    mCurShader->SetMat4( "uMvpMatrix", mvpMat );
-    mCurShader->SetMat4( "uModelMatrix", modelMat );
-    mCurShader->SetMat4( "uNormalMatrix", normalMat );
-
-    glBindVertexArray( vb.mVAO );
-    if ( vb.mNumIndices > 0 ) {
-        glDrawElements( GL_TRIANGLES, vb.mNumIndices, GL_UNSIGNED_INT, 0 );
+void Renderer::DrawVertexBufferInstanced(
+    const glm::mat4* modelMats,
+    const size_t numInstances,
+    const VertexBuffer& vb,
+    const BoundingSphere* bounds )
+{
+    if ( vb.mType != VertexBuffer::POS_TEXCOORD ) {
+        std::cerr << "DrawVertexBufferInstanced: unhandled vertex buffer type" << std::endl;
+        return;
+    }
+    if ( bounds == nullptr ) {
+        bounds = &vb.GetBoundingSphere();
+    }
+    queueInstanced( mTexturedLitInstShader.get(), modelMats, numInstances, vb, 0, 0, bounds );
+}
+
+void Renderer::DrawSkinnedVertexBufferInstanced(
+    const glm::mat4* modelMats,
+    const glm::mat4* palettes,
+    const size_t numInstances,
+    const size_t numBones,
+    const VertexBuffer& vb,
+    const BoundingSphere* bounds )
+{
+    drawSkinnedInstanced(
+        mSkinnedLitInstShader.get(),
+        modelMats,
+        reinterpret_cast<const glm::vec4*>( palettes ),
+        numInstances,
+        numBones * 4,
+        vb,
+        bounds
+    );
+}
+
+void Renderer::DrawSkinnedVertexBufferInstanced(
+    const glm::mat4* modelMats,
+    const DualQuat* dualQuats,
+    const size_t numInstances,
+    const size_t numBones,
+    const VertexBuffer& vb,
+    const BoundingSphere* bounds )
+{
+    drawSkinnedInstanced(
+        mDqSkinnedLitInstShader.get(),
+        modelMats,
+        reinterpret_cast<const glm::vec4*>( dualQuats ),
+        numInstances,
+        numBones * 2,
+        vb,
+        bounds
+    );
+}
+
+void Renderer::drawSkinnedInstanced(
+    Shader* shader,
+    const glm::mat4* modelMats,
+    const glm::vec4* palettes,
+    const size_t numInstances,
+    const size_t paletteTexels,
+    const VertexBuffer& vb,
+    const BoundingSphere* bounds )
+{
+    if ( vb.mType != VertexBuffer::POS_TEXCOORD_SKINNED ) {
+        std::cerr << "DrawSkinnedVertexBufferInstanced: unhandled vertex buffer type" << std::endl;
+        return;
+    }
+    const size_t numTexels = numInstances * paletteTexels;
+    if ( mCrowdPalettes.size() + numTexels > (size_t)mMaxTextureBufferTexels ) {
+        std::cerr << "DrawSkinnedVertexBufferInstanced: too many palettes this frame for a texture buffer" << std::endl;
+        return;
+    }
+
+    const size_t paletteBase = mCrowdPalettes.size();
+    mCrowdPalettes.insert( mCrowdPalettes.end(), palettes, palettes + numTexels );
+    queueInstanced( shader, modelMats, numInstances, vb, paletteBase, paletteTexels, bounds );
+}
+
+void Renderer::queueInstanced(
+    Shader* shader,
+    const glm::mat4* modelMats,
+    const size_t numInstances,
+    const VertexBuffer& vb,
+    const size_t paletteBase,
+    const size_t paletteTexels,
+    const BoundingSphere* bounds )
+{
+    if ( numInstances == 0 ) { return; }
+
+    // the first instance stands in for the whole batch when sorting
+    queueDraw( shader, modelMats[0], vb, nullptr, 0, nullptr );
+    DrawCmd& cmd = mDrawCmds.back();
+    cmd.instanceOffset = mInstanceData.size();
+    cmd.numInstances = numInstances;
+    Aabb worldBox;
+    for ( size_t i=0; i<numInstances; ++i ) {
+        if ( bounds != nullptr ) {
+            const BoundingSphere world = bounds->Transformed( modelMats[i] );
+            worldBox.Add( world.center - glm::vec3( world.radius ));
+            worldBox.Add( world.center + glm::vec3( world.radius ));
+        }
+        InstanceData inst;
+        inst.modelMatrix = modelMats[i];
+        inst.normalMatrix = glm::inverse( glm::transpose( modelMats[i] ));
+        inst.paletteOffset = (uint32_t)( paletteBase + i * paletteTexels );
+        inst.pad[0] = inst.pad[1] = inst.pad[2] = 0;
+        mInstanceData.push_back( inst );
+    }
+    if ( bounds != nullptr ) {
+        const BoundingSphere world( worldBox );
+        cmd.bounds = glm::vec4( world.center, world.radius );
+    }
+}
+
+void Renderer::DrawSkinnedVertexBuffer(
+    const glm::mat4& modelMat,
+    const VertexBuffer& vb,
+    const glm::mat4* palette,
+    const size_t numBones,
+    const BoundingSphere* bounds )
+{
+    if ( numBones > MAX_SKINNING_BONES ) {
+        std::cerr << "DrawSkinnedVertexBuffer: too many bones: " << numBones << std::endl;
+        return;
+    }
+    drawSkinned(
+        mSkinnedLitShader.get(),
+        modelMat,
+        vb,
+        palette,
+        numBones * sizeof( glm::mat4 ),
+        bounds
+    );
+}
+
+void Renderer::DrawSkinnedVertexBuffer(
+    const glm::mat4& modelMat,
+    const VertexBuffer& vb,
+    const DualQuat* dualQuats,
+    const size_t numBones,
+    const BoundingSphere* bounds )
+{
+    if ( numBones > MAX_SKINNING_BONES ) {
+        std::cerr << "DrawSkinnedVertexBuffer: too many bones: " << numBones << std::endl;
+        return;
+    }
+    drawSkinned(
+        mDqSkinnedLitShader.get(),
+        modelMat,
+        vb,
+        dualQuats,
+        numBones * sizeof( DualQuat ),
+        bounds
+    );
+}
+
+void Renderer::drawSkinned(
+    Shader* shader,
+    const glm::mat4& modelMat,
+    const VertexBuffer& vb,
+    const void* boneData,
+    const size_t boneDataSize,
+    const BoundingSphere* bounds )
+{
+    if ( vb.mType != VertexBuffer::POS_TEXCOORD_SKINNED ) {
+        std::cerr << "DrawSkinnedVertexBuffer: unhandled vertex buffer type" << std::endl;
+        return;
+    }
+
+    queueDraw( shader, modelMat, vb, boneData, boneDataSize, bounds );
+}
+
+void Renderer::queueDraw(
+    Shader* shader,
+    const glm::mat4& modelMat,
+    const VertexBuffer& vb,
+    const void* boneData,
+    const size_t boneDataSize,
+    const BoundingSphere* bounds )
+{
+    DrawCmd cmd;
+    cmd.shader = shader;
+    cmd.vb = &vb;
+    vb.mDrawQueued = true;
+    cmd.texture = mCurTexture;
+    cmd.modelMat = modelMat;
+    // copy the bones; the caller may update its palette before Flush.
+    // Each palette starts aligned so Flush can bind it in place
+    cmd.boneDataOffset = 0;
+    cmd.boneDataSize = boneDataSize;
+    if ( boneDataSize > 0 ) {
+        cmd.boneDataOffset = (mBoneData.size() + mUniformBufferAlignment - 1) /
+            mUniformBufferAlignment * mUniformBufferAlignment;
+        mBoneData.resize( cmd.boneDataOffset );
+        const uint8_t* bytes = static_cast<const uint8_t*>( boneData );
+        mBoneData.insert( mBoneData.end(), bytes, bytes + boneDataSize );
+    }
+    cmd.instanceOffset = 0;
+    cmd.numInstances = 0;
+    if ( bounds != nullptr ) {
+        cmd.bounds = glm::vec4( bounds->center, bounds->radius );
     } else {
-        glDrawArrays( GL_TRIANGLES, 0, vb.mNumVertices );
+        cmd.bounds = glm::vec4( 0.0f, 0.0f, 0.0f, std::numeric_limits<float>::infinity() );
     }
+    mDrawCmds.push_back( cmd );
+}
+
+uint64_t Renderer::makeSortKey( const DrawCmd& cmd ) const
+{
+    // quantize the view space distance so nearer draws of the same
+    // state come first and benefit from early depth rejection
+    const glm::vec4 viewPos = mViewMat * cmd.modelMat[3];
+    float depth = (-viewPos.z - mNearPlane) / (mFarPlane - mNearPlane);
+    depth = std::min( std::max( depth, 0.0f ), 1.0f );
+    const uint64_t depthBits = (uint64_t)( depth * float( (1 << 24) - 1 ));
+
+    const uint64_t shaderBits = cmd.shader->GetProgID() & 0xFF;
+    const uint64_t textureBits = cmd.texture & 0xFFFF;
+    const uint64_t vaoBits = cmd.vb->mVAO & 0xFFFF;
+    return (shaderBits << 56) | (textureBits << 40) | (vaoBits << 24) | depthBits;
+}
+
+void Renderer::radixSort( std::vector<SortItem>& items, std::vector<SortItem>& scratch )
+{
+    scratch.resize( items.size() );
+    for ( int shift=0; shift<64; shift+=8 )
+    {
+        size_t counts[256] = { 0 };
+        for ( const SortItem& item : items ) {
+            ++counts[(item.key >> shift) & 0xFF];
+        }
+        if ( counts[(items[0].key >> shift) & 0xFF] == items.size() ) { continue; }
+
+        size_t offset = 0;
+        for ( int i=0; i<256; ++i ) {
+            const size_t count = counts[i];
+            counts[i] = offset;
+            offset += count;
+        }
+        for ( const SortItem& item : items ) {
+            scratch[counts[(item.key >> shift) & 0xFF]++] = item;
+        }
+        items.swap( scratch );
+    }
+}
+
+void Renderer::Flush()
+{
+    mQueueStats.numDraws = 0;
+    mQueueStats.numCulled = 0;
+    mQueueStats.numOccluded = 0;
+    mQueueStats.stateChanges = 0;
+    mQueueStats.savedStateChanges = 0;
+    if ( mDrawCmds.empty() ) { return; }
+
+    // textures and vertex arrays are also bound outside the queue when
+    // they are created or updated, so don't trust the cache across frames
+    mBoundTexture = INVALID_GL_NAME;
+    mBoundVAO = INVALID_GL_NAME;
+
+    // cull the whole queue in one batch before anything is submitted
+    mCullSpheres.resize( mDrawCmds.size() );
+    mCullVisible.resize( mDrawCmds.size() );
+    for ( size_t i=0; i<mDrawCmds.size(); ++i ) {
+        const DrawCmd& cmd = mDrawCmds[i];
+        if ( cmd.numInstances > 0 ) {
+            mCullSpheres[i] = cmd.bounds; // already around every instance
+            continue;
+        }
+        const BoundingSphere world = BoundingSphere(
+            glm::vec3( cmd.bounds ), cmd.bounds.w
+        ).Transformed( cmd.modelMat );
+        mCullSpheres[i] = glm::vec4( world.center, world.radius );
+    }
+    const size_t numVisible = GetViewFrustum().CullSpheres(
+        mCullSpheres.data(),
+        mCullSpheres.size(),
+        mCullVisible.data()
+    );
+    mQueueStats.numCulled = mDrawCmds.size() - numVisible;
+
+    // then the occlusion culler, with boxes around the surviving spheres;
+    // unbounded draws skip it
+    if ( mOcclusionCuller != nullptr ) {
+        mOcclusionBoxes.clear();
+        mOcclusionCmds.clear();
+        for ( size_t i=0; i<mDrawCmds.size(); ++i ) {
+            const glm::vec4& sphere = mCullSpheres[i];
+            if ( !mCullVisible[i] || std::isinf( sphere.w )) { continue; }
+            Aabb box;
+            box.min = glm::vec3( sphere ) - glm::vec3( sphere.w );
+            box.max = glm::vec3( sphere ) + glm::vec3( sphere.w );
+            mOcclusionBoxes.push_back( box );
+            mOcclusionCmds.push_back( (uint32_t)i );
+        }
+        mOcclusionVisible.resize( mOcclusionBoxes.size() );
+        mOcclusionCuller->CullBoxes( mOcclusionBoxes.data(), mOcclusionBoxes.size(), mOcclusionVisible.data() );
+        for ( size_t i=0; i<mOcclusionCmds.size(); ++i ) {
+            if ( !mOcclusionVisible[i] ) {
+                mCullVisible[mOcclusionCmds[i]] = 0;
+                ++mQueueStats.numOccluded;
+            }
+        }
+    }
+    mQueueStats.numDraws = numVisible - mQueueStats.numOccluded;
+
+    mSortItems.clear();
+    for ( size_t i=0; i<mDrawCmds.size(); ++i ) {
+        if ( !mCullVisible[i] ) { continue; }
+        SortItem item;
+        item.key = makeSortKey( mDrawCmds[i] );
+        item.cmdIdx = (uint32_t)i;
+        mSortItems.push_back( item );
+    }
+    if ( !mSortItems.empty() ) {
+        radixSort( mSortItems, mSortScratch );
+    }
+
+    // every instanced draw of the frame shares one upload
+    if ( !mInstanceData.empty() ) {
+        glBindBuffer( GL_ARRAY_BUFFER, mInstanceVBO );
+        glBufferData(
+            GL_ARRAY_BUFFER,
+            mInstanceData.size() * sizeof( InstanceData ),
+            mInstanceData.data(),
+            GL_STREAM_DRAW
+        );
+        glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    }
+    // so do the bone palettes; padded so a whole block bound at the
+    // last palette's offset stays inside the buffer
+    if ( !mBoneData.empty() ) {
+        mBoneData.resize( mBoneData.size() + BONE_PALETTE_BLOCK_SIZE );
+        glBindBuffer( GL_UNIFORM_BUFFER, mBonePaletteUBO );
+        glBufferData(
+            GL_UNIFORM_BUFFER,
+            mBoneData.size(),
+            mBoneData.data(),
+            GL_STREAM_DRAW
+        );
+        glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+    }
+    // the texture on CROWD_PALETTE_TEXTURE_UNIT stays bound to this buffer
+    if ( !mCrowdPalettes.empty() ) {
+        glBindBuffer( GL_TEXTURE_BUFFER, mCrowdPaletteBuffer );
+        glBufferData(
+            GL_TEXTURE_BUFFER,
+            mCrowdPalettes.size() * sizeof( glm::vec4 ),
+            mCrowdPalettes.data(),
+            GL_STREAM_DRAW
+        );
+        glBindBuffer( GL_TEXTURE_BUFFER, 0 );
+    }
+
+    for ( const SortItem& item : mSortItems )
+    {
+        const DrawCmd& cmd = mDrawCmds[item.cmdIdx];
+        useShader( cmd.shader );
+        bindTexture( cmd.texture );
+        bindVertexArray( cmd.vb->mVAO );
+
+        if ( cmd.boneDataSize > 0 ) {
+            // only the bone data changes per frame; the vertices stay on the GPU
+            glBindBufferRange(
+                GL_UNIFORM_BUFFER,
+                BONE_PALETTE_BINDING,
+                mBonePaletteUBO,
+                cmd.boneDataOffset,
+                BONE_PALETTE_BLOCK_SIZE
+            );
+        }
+
+        if ( cmd.numInstances > 0 ) {
+            updateFrameUniforms();
+            setInstanceAttribs( cmd.instanceOffset );
+            drawArrays( *cmd.vb, cmd.numInstances );
+            resetInstanceAttribs();
+        } else {
+            setLitUniforms( cmd.modelMat );
+            drawArrays( *cmd.vb );
+        }
+    }
+
+    for ( const DrawCmd& cmd : mDrawCmds ) {
+        cmd.vb->mDrawQueued = false;
+    }
+    mDrawCmds.clear();
+    mBoneData.clear();
+    mCullSpheres.clear();
+    mInstanceData.clear();
+    mCrowdPalettes.clear();
+}
+
+std::unique_ptr<Shader> Renderer::createLitShader( const char* vertexFile, const char* fragmentFile )
+{
+    std::unique_ptr<Shader> shader = std::make_unique<Shader>( vertexFile, fragmentFile );
+    shader->SetUniformBlockBinding( "FrameUniforms", FRAME_UNIFORMS_BINDING );
+    shader->SetUniformBlockBinding( "DrawUniforms", DRAW_UNIFORMS_BINDING );
+    return shader;
+}
+
+void Renderer::useShader( Shader* shader )
+{
+    if ( mCurShader == shader ) {
+        ++mQueueStats.savedStateChanges;
+        return;
+    }
+    mCurShader = shader;
+    mCurShader->Use();
+    ++mQueueStats.stateChanges;
+}
+
+void Renderer::bindTexture( GLuint texture )
+{
+    if ( mBoundTexture == texture ) {
+        ++mQueueStats.savedStateChanges;
+        return;
+    }
+    mBoundTexture = texture;
+    glBindTexture( GL_TEXTURE_2D, texture );
+    ++mQueueStats.stateChanges;
+}
+
+void Renderer::bindVertexArray( GLuint vao )
+{
+    if ( mBoundVAO == vao ) {
+        ++mQueueStats.savedStateChanges;
+        return;
+    }
+    mBoundVAO = vao;
+    glBindVertexArray( vao );
+    ++mQueueStats.stateChanges;
+}
+
+void Renderer::updateFrameUniforms()
+{
+    if ( mFrameUniformsDirty )
+    {
+        FrameUniforms frame;
+        frame.viewProjMatrix = mProjMat * mViewMat;
+        frame.ambient = glm::vec4( mAmbientLight, 0.0f );
+        for ( int i=0; i<MAX_POS_LIGHTS; ++i ) {
+            frame.posLgtPos[i] = glm::vec4( mPosLights[i].position, 0.0f );
+            frame.posLgtDff[i] = glm::vec4( mPosLights[i].diffuse, 0.0f );
+        }
+        for ( int i=0; i<MAX_DIR_LIGHTS; ++i ) {
+            frame.dirLgtDir[i] = glm::vec4( mDirLights[i].direction, 0.0f );
+            frame.dirLgtDff[i] = glm::vec4( mDirLights[i].diffuse, 0.0f );
+        }
+        glBindBuffer( GL_UNIFORM_BUFFER, mFrameUniformsUBO );
+        glBufferSubData( GL_UNIFORM_BUFFER, 0, sizeof( frame ), &frame );
+        mFrameUniformsDirty = false;
+    }
+}
+
+void Renderer::setLitUniforms( const glm::mat4& modelMat )
+{
+    updateFrameUniforms();
+
+    DrawUniforms draw;
+    draw.modelMatrix = modelMat;
+    draw.normalMatrix = glm::inverse( glm::transpose( modelMat ));
+
+    glBindBuffer( GL_UNIFORM_BUFFER, mDrawUniformsUBO );
+    if ( mDrawUniformsOffset + mDrawUniformsStride > DRAW_UNIFORMS_RING_SLOTS * mDrawUniformsStride ) {
+        // ring is full; orphan the storage so the driver hands out fresh
+        // memory instead of waiting for draws still reading the old slots
+        glBufferData(
+            GL_UNIFORM_BUFFER,
+            DRAW_UNIFORMS_RING_SLOTS * mDrawUniformsStride,
+            nullptr,
+            GL_STREAM_DRAW
+        );
+        mDrawUniformsOffset = 0;
+    }
+    glBufferSubData( GL_UNIFORM_BUFFER, mDrawUniformsOffset, sizeof( draw ), &draw );
+    glBindBufferRange(
+        GL_UNIFORM_BUFFER,
+        DRAW_UNIFORMS_BINDING,
+        mDrawUniformsUBO,
+        mDrawUniformsOffset,
+        sizeof( draw )
+    );
+    glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+    mDrawUniformsOffset += mDrawUniformsStride;
+}
+
+void Renderer::setInstanceAttribs( const size_t firstInstance )
+{
+    // GL 3.3 has no base instance, so offset the attribute pointers instead;
+    // each mat4 takes 4 locations, one column each
+    glBindBuffer( GL_ARRAY_BUFFER, mInstanceVBO );
+    const size_t instanceOffset = firstInstance * sizeof( InstanceData );
+    for ( GLuint col=0; col<8; ++col ) { // model then normal matrix
+        const GLuint location = INSTANCE_ATTRIB_LOCATION + col;
+        glVertexAttribPointer(
+            location,
+            4,
+            GL_FLOAT,
+            GL_FALSE,
+            sizeof( InstanceData ),
+            (void*)( instanceOffset + col * sizeof( glm::vec4 ))
+        );
+        glEnableVertexAttribArray( location );
+        glVertexAttribDivisor( location, 1 ); // advance once per instance
+    }
+    const GLuint offsetLocation = INSTANCE_ATTRIB_LOCATION + 8;
+    glVertexAttribIPointer(
+        offsetLocation,
+        1,
+        GL_UNSIGNED_INT,
+        sizeof( InstanceData ),
+        (void*)( instanceOffset + offsetof( InstanceData, paletteOffset ))
+    );
+    glEnableVertexAttribArray( offsetLocation );
+    glVertexAttribDivisor( offsetLocation, 1 );
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+}
+
+void Renderer::resetInstanceAttribs()
+{
+    for ( GLuint location=INSTANCE_ATTRIB_LOCATION; location<=INSTANCE_ATTRIB_LOCATION + 8; ++location ) {
+        glDisableVertexAttribArray( location );
+        glVertexAttribDivisor( location, 0 );
+    }
+}
+
+void Renderer::drawArrays( const VertexBuffer& vb, const size_t numInstances )
+{
+    // dynamic buffers are triple buffered; draw the most recently written copy
+    const GLint baseVertex = vb.getBaseVertex();
+    if ( numInstances > 0 ) {
+        if ( vb.mNumIndices > 0 ) {
+            glDrawElementsInstancedBaseVertex(
+                GL_TRIANGLES, vb.mNumIndices, GL_UNSIGNED_INT, 0, numInstances, baseVertex
+            );
+        } else {
+            glDrawArraysInstanced( GL_TRIANGLES, baseVertex, vb.mNumVertices, numInstances );
+        }
+    } else if ( vb.mNumIndices > 0 ) {
+        glDrawElementsBaseVertex( GL_TRIANGLES, vb.mNumIndices, GL_UNSIGNED_INT, 0, baseVertex );
+    } else {
+        glDrawArrays( GL_TRIANGLES, baseVertex, vb.mNumVertices );
+    }
+    vb.onDrawn();
 }
 
 void Renderer::Update()
@@ -156,6 +796,8 @@ void Renderer::Update()
         if ( e.type == SDL_QUIT ) mQuit = true;
     }
 
+    Flush();
+
     SDL_GL_SwapWindow( mWindow );
 }
 
@@ -3,6 +3,8 @@
 
 #include <iostream>
 #include <memory>
+#include <vector>
+#include <cstdint>
 #include <cstdlib>
 #include <GL/glew.h>
 #include <SDL2/SDL.h>
@@ -10,6 +12,10 @@
 #include "VertexBuffer.h"
 #include "Shader.h"
 #include "Texture.h"
+#include "Skinning.h"
+#include "Bounds.h"
+#include "Frustum.h"
+#include "OcclusionCuller.h"
 
 #define MAX_POS_LIGHTS 1
 #define MAX_DIR_LIGHTS 1
@@ -30,6 +36,11 @@ public:
     // Apply the given texture to all future draw calls
     void SetTexture( const Texture& tex );
 
+    // Draws are not issued immediately but queued until the end of the
+    // frame, then sorted by shader, texture, vertex array and depth so
+    // the queue can skip redundant state changes. Vertex buffers must
+    // stay alive until Flush.
+
     // Set the global ambient light color
     void SetAmbientLight( float r, float g, float b );
 
@@ -49,14 +60,104 @@ public:
     // Set a directional light properties at the given index
     bool SetDirLight( const DirectionalLight& lgt, const size_t index );
 
-    // Render the data of the input vertex buffer with the given model matrix
-    void DrawVertexBuffer( const glm::mat4& modelMat, const VertexBuffer& vb );
+    // Draws outside the view frustum are dropped at Flush. bounds are in
+    // model space; skinned draws without bounds are never culled, as the
+    // pose can move their vertices anywhere. Instanced draws are culled
+    // as a whole, by the union of their instances' bounds
+
+    // Render the data of the input vertex buffer with the given model
+    // matrix. bounds default to the vertex buffer's
+    void DrawVertexBuffer(
+        const glm::mat4& modelMat,
+        const VertexBuffer& vb,
+        const BoundingSphere* bounds = nullptr
+    );
+
+    // Render numInstances copies of a POS_TEXCOORD vertex buffer in a
+    // single instanced draw call, one copy per model matrix. bounds are
+    // in model space, shared by every copy, and default to the vertex
+    // buffer's
+    void DrawVertexBufferInstanced(
+        const glm::mat4* modelMats,
+        const size_t numInstances,
+        const VertexBuffer& vb,
+        const BoundingSphere* bounds = nullptr
+    );
+
+    // Render numInstances copies of a POS_TEXCOORD_SKINNED vertex buffer
+    // in a single instanced draw, each skinned with its own palette.
+    // palettes holds numBones matrices per instance, instance after
+    // instance. Palettes go in a texture buffer, so unlike
+    // DrawSkinnedVertexBuffer there is no MAX_SKINNING_BONES limit.
+    // bounds are in model space and must hold every instance's pose;
+    // without them the batch is never culled
+    void DrawSkinnedVertexBufferInstanced(
+        const glm::mat4* modelMats,
+        const glm::mat4* palettes,
+        const size_t numInstances,
+        const size_t numBones,
+        const VertexBuffer& vb,
+        const BoundingSphere* bounds = nullptr
+    );
+    // Same as above but skinned with dual quaternion blending
+    void DrawSkinnedVertexBufferInstanced(
+        const glm::mat4* modelMats,
+        const DualQuat* dualQuats,
+        const size_t numInstances,
+        const size_t numBones,
+        const VertexBuffer& vb,
+        const BoundingSphere* bounds = nullptr
+    );
+
+    // max bones per GPU skinned draw; must match shaders/SkelVertShader.glsl
+    static const size_t MAX_SKINNING_BONES = 96;
+
+    // Render a POS_TEXCOORD_SKINNED vertex buffer, skinned on the GPU
+    // with the given palette (current pose * inverse bind pose per bone)
+    void DrawSkinnedVertexBuffer(
+        const glm::mat4& modelMat,
+        const VertexBuffer& vb,
+        const glm::mat4* palette,
+        const size_t numBones,
+        const BoundingSphere* bounds = nullptr
+    );
+    // Same as above but skinned with dual quaternion blending
+    void DrawSkinnedVertexBuffer(
+        const glm::mat4& modelMat,
+        const VertexBuffer& vb,
+        const DualQuat* dualQuats,
+        const size_t numBones,
+        const BoundingSphere* bounds = nullptr
+    );
+
+    // Sort and submit all queued draws; called by Update
+    void Flush();
+
+    struct QueueStats
+    {
+        size_t numDraws; // draws submitted
+        size_t numCulled; // queued draws dropped by frustum culling
+        size_t numOccluded; // queued draws dropped by the occlusion culler
+        size_t stateChanges; // program/texture/vertex array binds issued
+        size_t savedStateChanges; // binds skipped because the state was already set
+    };
+    // stats of the most recent Flush
+    const QueueStats& GetQueueStats() const { return mQueueStats; }
+
+    // frustum of the current camera, in world space
+    Frustum GetViewFrustum() const { return Frustum( mProjMat * mViewMat ); }
+    glm::mat4 GetViewProjMatrix() const { return mProjMat * mViewMat; }
+
+    // Flush also drops draws whose bounds are behind this frame's
+    // occluders. The culler must be rasterized with GetViewProjMatrix
+    // before Flush; null turns occlusion culling off
+    void SetOcclusionCuller( const OcclusionCuller* culler ) { mOcclusionCuller = culler; }
 
     // test if the window should close
     bool ShouldClose();
 
-    // Poll events and
-    // update the screen
+    // Poll events, flush the
+    // render queue, and update the screen
     void Update();
 
 
@@ -69,14 +170,186 @@ private:
     
     glm::mat4 mProjMat; // projection matrix
     glm::mat4 mViewMat; // view/camera matrix
+    float mNearPlane; // of mProjMat; also scales the depth in sort keys
+    float mFarPlane;
 
     std::unique_ptr<Shader> mTexturedLitShader;
+    std::unique_ptr<Shader> mTexturedLitInstShader;
+    std::unique_ptr<Shader> mSkinnedLitShader;
+    std::unique_ptr<Shader> mDqSkinnedLitShader;
+    std::unique_ptr<Shader> mSkinnedLitInstShader;
+    std::unique_ptr<Shader> mDqSkinnedLitInstShader;
     Shader* mCurShader;
 
+    // uniform buffer holding the bone palettes (matrices or dual
+    // quaternions) of every queued skinned draw, uploaded once per Flush;
+    // each draw binds the range at its boneDataOffset
+    GLuint mBonePaletteUBO;
+    static const GLuint BONE_PALETTE_BINDING = 0;
+    // size of the BonePalette block, the larger of the two; bound for
+    // every skinned draw whatever its number of bones
+    static const size_t BONE_PALETTE_BLOCK_SIZE = MAX_SKINNING_BONES * sizeof( glm::mat4 );
+    size_t mUniformBufferAlignment; // glBindBufferRange offsets must be a multiple
+
+    // std140 layout of the FrameUniforms block in the lit shaders
+    struct FrameUniforms
+    {
+        glm::mat4 viewProjMatrix;
+        glm::vec4 ambient; // w unused
+        glm::vec4 posLgtPos[MAX_POS_LIGHTS];
+        glm::vec4 posLgtDff[MAX_POS_LIGHTS];
+        glm::vec4 dirLgtDir[MAX_DIR_LIGHTS];
+        glm::vec4 dirLgtDff[MAX_DIR_LIGHTS];
+    };
+    // std140 layout of the DrawUniforms block in the lit shaders
+    struct DrawUniforms
+    {
+        glm::mat4 modelMatrix;
+        glm::mat4 normalMatrix;
+    };
+
+    // camera and lights; re-uploaded on the first draw after they change
+    GLuint mFrameUniformsUBO;
+    bool mFrameUniformsDirty;
+    static const GLuint FRAME_UNIFORMS_BINDING = 1;
+
+    // ring of DrawUniforms slots; each draw writes the next slot and
+    // binds just that range, so earlier draws in flight keep their data
+    GLuint mDrawUniformsUBO;
+    size_t mDrawUniformsStride; // sizeof(DrawUniforms) rounded up to the UBO offset alignment
+    size_t mDrawUniformsOffset; // next free slot in bytes
+    static const size_t DRAW_UNIFORMS_RING_SLOTS = 1024;
+    static const GLuint DRAW_UNIFORMS_BINDING = 2;
+
+    // a queued draw
+    struct DrawCmd
+    {
+        Shader* shader;
+        const VertexBuffer* vb;
+        GLuint texture;
+        glm::mat4 modelMat;
+        size_t boneDataOffset; // into mBoneData; a multiple of mUniformBufferAlignment
+        size_t boneDataSize; // 0 for unskinned draws
+        size_t instanceOffset; // into mInstanceData
+        size_t numInstances; // 0 for non instanced draws
+        glm::vec4 bounds; // model space sphere, world space for instanced
+                          // draws; infinite radius is never culled
+    };
+    struct SortItem
+    {
+        uint64_t key;
+        uint32_t cmdIdx;
+    };
+    std::vector<DrawCmd> mDrawCmds;
+    std::vector<SortItem> mSortItems;
+    std::vector<SortItem> mSortScratch;
+    std::vector<uint8_t> mBoneData; // bone palettes of the queued skinned draws
+    std::vector<glm::vec4> mCullSpheres; // world space bounds of the queued draws
+    std::vector<uint8_t> mCullVisible;
+    std::vector<Aabb> mOcclusionBoxes; // frustum visible bounded draws
+    std::vector<uint32_t> mOcclusionCmds; // their mDrawCmds index
+    std::vector<uint8_t> mOcclusionVisible;
+    const OcclusionCuller* mOcclusionCuller;
+
+    // per instance vertex attributes; must match shaders/TexLitInstVertShader.glsl
+    struct InstanceData
+    {
+        glm::mat4 modelMatrix;
+        glm::mat4 normalMatrix;
+        uint32_t paletteOffset; // first texel in mCrowdPalettes; skinned instances only
+        uint32_t pad[3];
+    };
+    std::vector<InstanceData> mInstanceData; // instances of the queued instanced draws
+    GLuint mInstanceVBO; // mInstanceData is uploaded here once per Flush
+    static const GLuint INSTANCE_ATTRIB_LOCATION = 5; // 9 locations, a vec4 per matrix column + palette offset
+
+    // palettes of the queued instanced skinned draws, read by the shader
+    // through a texture buffer so any number of bones and instances fit
+    std::vector<glm::vec4> mCrowdPalettes; // 4 texels per matrix, 2 per dual quaternion
+    GLuint mCrowdPaletteBuffer;
+    GLuint mCrowdPaletteTexture;
+    GLint mMaxTextureBufferTexels;
+    static const GLuint CROWD_PALETTE_TEXTURE_UNIT = 1;
+    QueueStats mQueueStats;
+    GLuint mCurTexture; // texture recorded with new draws
+
+    // GL state the queue last bound, to skip redundant binds
+    GLuint mBoundTexture;
+    GLuint mBoundVAO;
+    static const GLuint INVALID_GL_NAME = 0xFFFFFFFF; // forces the next bind
+
     glm::vec3 mAmbientLight;
     PositionalLight mPosLights[MAX_POS_LIGHTS];
     DirectionalLight mDirLights[MAX_DIR_LIGHTS];
 
+    // create a lit shader and attach its uniform blocks
+    static std::unique_ptr<Shader> createLitShader( const char* vertexFile, const char* fragmentFile );
+    // bind the shader/texture/vertex array if it isn't already
+    void useShader( Shader* shader );
+    void bindTexture( GLuint texture );
+    void bindVertexArray( GLuint vao );
+    // record a draw into the queue; null bounds are never culled
+    void queueDraw(
+        Shader* shader,
+        const glm::mat4& modelMat,
+        const VertexBuffer& vb,
+        const void* boneData,
+        const size_t boneDataSize,
+        const BoundingSphere* bounds
+    );
+    // record an instanced draw; instance i's palette starts at texel
+    // paletteBase + i*paletteTexels of mCrowdPalettes. The draw is
+    // culled by a sphere around every instance's bounds; null bounds are
+    // never culled
+    void queueInstanced(
+        Shader* shader,
+        const glm::mat4* modelMats,
+        const size_t numInstances,
+        const VertexBuffer& vb,
+        const size_t paletteBase,
+        const size_t paletteTexels,
+        const BoundingSphere* bounds
+    );
+    // validate, store the palettes and queue an instanced skinned draw;
+    // palettes holds paletteTexels texels per instance
+    void drawSkinnedInstanced(
+        Shader* shader,
+        const glm::mat4* modelMats,
+        const glm::vec4* palettes,
+        const size_t numInstances,
+        const size_t paletteTexels,
+        const VertexBuffer& vb,
+        const BoundingSphere* bounds
+    );
+    // sort key: shader (8 bits), texture (16), vertex array (16),
+    // front to back depth (24)
+    uint64_t makeSortKey( const DrawCmd& cmd ) const;
+    // LSD radix sort on the keys, one byte per pass. Stable, so draws with
+    // equal keys keep their submission order. Passes where every key has
+    // the same byte are skipped, which is most of them for a typical frame
+    static void radixSort( std::vector<SortItem>& items, std::vector<SortItem>& scratch );
+    // upload the frame uniforms if they changed
+    void updateFrameUniforms();
+    // upload the frame uniforms if they changed, and the draw uniforms
+    // for the given model matrix into the next ring slot
+    void setLitUniforms( const glm::mat4& modelMat );
+    // point the instance attributes of the bound VAO at the given instance
+    void setInstanceAttribs( const size_t firstInstance );
+    // disable them again; the VAO is shared with non instanced draws of
+    // the same vertex buffer
+    void resetInstanceAttribs();
+    // validate and queue a GPU skinned draw
+    void drawSkinned(
+        Shader* shader,
+        const glm::mat4& modelMat,
+        const VertexBuffer& vb,
+        const void* boneData,
+        const size_t boneDataSize,
+        const BoundingSphere* bounds
+    );
+    // issue the draw call for the given vertex buffer; its VAO must be bound
+    void drawArrays( const VertexBuffer& vb, const size_t numInstances = 0 );
+
     // singleton instance and enforced private ctor/copy/assignment
     static Renderer sInstance;
     Renderer();
@@ -0,0 +1,74 @@
+#include <cassert>
+#include <algorithm>
+
+#include "SceneGraph.h"
+
+SceneGraph::SceneGraph() :
+    mAnyDirty(false)
+{
+}
+
+size_t SceneGraph::AddNode( const int parent, const Affine& local, const std::string& name )
+{
+    assert( parent == NO_PARENT || size_t( parent ) < mParents.size() );
+    mParents.push_back( parent );
+    mLocals.push_back( local );
+    mWorlds.push_back( local );
+    mDirty.push_back( 1 );
+    mNames.push_back( name );
+    mAnyDirty = true;
+    return mParents.size() - 1;
+}
+
+size_t SceneGraph::Append( const SceneGraph& other, const int parent )
+{
+    const size_t first = mParents.size();
+    for ( size_t i=0; i<other.GetNumNodes(); ++i ) {
+        const int otherParent = other.mParents[i];
+        AddNode(
+            otherParent == NO_PARENT ? parent : int( first ) + otherParent,
+            other.mLocals[i],
+            other.mNames[i]
+        );
+    }
+    return first;
+}
+
+void SceneGraph::SetLocal( const size_t node, const Affine& local )
+{
+    mLocals[node] = local;
+    mDirty[node] = 1;
+    mAnyDirty = true;
+}
+
+size_t SceneGraph::UpdateWorldTransforms()
+{
+    if ( !mAnyDirty ) { return 0; }
+
+    // parents come first, so a dirty parent has already marked itself by
+    // the time its children are reached
+    size_t numUpdated = 0;
+    for ( size_t i=0; i<mParents.size(); ++i )
+    {
+        const int parent = mParents[i];
+        if ( parent != NO_PARENT && mDirty[parent] ) {
+            mDirty[i] = 1;
+        }
+        if ( !mDirty[i] ) { continue; }
+        mWorlds[i] = parent == NO_PARENT ?
+            mLocals[i] :
+            mWorlds[parent] * mLocals[i];
+        ++numUpdated;
+    }
+    std::fill( mDirty.begin(), mDirty.end(), 0 );
+    mAnyDirty = false;
+    return numUpdated;
+}
+
+int SceneGraph::FindNode( const std::string& name ) const
+{
+    for ( size_t i=0; i<mNames.size(); ++i ) {
+        if ( mNames[i] == name ) { return int( i ); }
+    }
+    return NO_PARENT;
+}
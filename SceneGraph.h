@@ -0,0 +1,57 @@
+#ifndef SCENE_GRAPH_H_INCLUDED
+#define SCENE_GRAPH_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Transform.h"
+
+/* Node hierarchy stored as flat arrays indexed by node. A node's parent
+ * always comes before it, so world transforms are brought up to date in
+ * one forward pass. Only nodes whose local transform changed, or that sit
+ * below one that did, are recomputed; when nothing moved an update is
+ * free */
+class SceneGraph
+{
+public:
+
+    static const int NO_PARENT = -1;
+
+    SceneGraph();
+
+    // parent must already be in the graph (or NO_PARENT). Returns the new
+    // node's index
+    size_t AddNode( const int parent, const Affine& local, const std::string& name = "" );
+    // Add every node of another graph; its roots go under parent. Returns
+    // the index of its first node, the others keep their relative order
+    size_t Append( const SceneGraph& other, const int parent = NO_PARENT );
+
+    void SetLocal( const size_t node, const Affine& local );
+    void SetLocal( const size_t node, const Transform& local ) { SetLocal( node, local.ToAffine() ); }
+    const Affine& GetLocal( const size_t node ) const { return mLocals[node]; }
+    // as of the last UpdateWorldTransforms
+    const Affine& GetWorld( const size_t node ) const { return mWorlds[node]; }
+
+    // Recompute the world transform of changed nodes and everything below
+    // them. Returns the number recomputed
+    size_t UpdateWorldTransforms();
+
+    size_t GetNumNodes() const { return mParents.size(); }
+    int GetParent( const size_t node ) const { return mParents[node]; }
+    const std::string& GetName( const size_t node ) const { return mNames[node]; }
+    // first node of the name; NO_PARENT if none
+    int FindNode( const std::string& name ) const;
+
+private:
+
+    std::vector<int> mParents;
+    std::vector<Affine> mLocals;
+    std::vector<Affine> mWorlds;
+    std::vector<uint8_t> mDirty; // local changed, or parent's world did this update
+    std::vector<std::string> mNames;
+    bool mAnyDirty;
+};
+
+#endif // SCENE_GRAPH_H_INCLUDED
@@ -50,9 +50,9 @@ Shader::Shader( const std::string vertexFile, const std::string shaderFile )
     glLinkProgram( mProgID);
 
     // check for success
-    glGetShaderiv( mProgID, GL_LINK_STATUS, &success );
+    glGetProgramiv( mProgID, GL_LINK_STATUS, &success );
     if ( !success ) {
-        glGetShaderInfoLog( mProgID, 512, NULL, infoLog );
+        glGetProgramInfoLog( mProgID, 512, NULL, infoLog );
         std::cerr << "Shader::Shader: Program Linkage Failed: "
             << infoLog << std::endl;
         exit(EXIT_FAILURE);
@@ -61,7 +61,8 @@ Shader::Shader( const std::string vertexFile, const std::string shaderFile )
     // delete our component shaders now
     glDeleteShader( vertexShaderID );
     glDeleteShader( fragmentShaderID );
-    
+
+    readActiveUniforms();
 }
 
 void Shader::Use(void)
@@ -69,9 +70,17 @@ void Shader::Use(void)
     glUseProgram( mProgID );
 }
 
+bool Shader::SetInt( const std::string& name, const int val )
+{
+    GLint pos = GetUniformLocation( name );
+    if ( pos < 0 ) { return false; }
+    glUniform1i( pos, val );
+    return true;
+}
+
 bool Shader::SetFloat( const std::string& name, const float val )
 {
-    GLint pos = glGetUniformLocation( mProgID, name.c_str() );
+    GLint pos = GetUniformLocation( name );
     if ( pos < 0 ) { return false; }
     glUniform1f( pos, val );
     return true;
@@ -79,7 +88,7 @@ bool Shader::SetFloat( const std::string& name, const float val )
 
 bool Shader::SetVec3( const std::string& name, const glm::vec3& val )
 {
-    GLint pos = glGetUniformLocation( mProgID, name.c_str() );
+    GLint pos = GetUniformLocation( name );
     if ( pos < 0 ) { return false; }
     glUniform3fv( pos, 1, glm::value_ptr(val) );
     return true;
@@ -87,13 +96,49 @@ bool Shader::SetVec3( const std::string& name, const glm::vec3& val )
 
 bool Shader::SetMat4( const std::string& name, const glm::mat4& val )
 {
-    GLint pos = glGetUniformLocation( mProgID, name.c_str() );
+    GLint pos = GetUniformLocation( name );
     if ( pos < 0 ) { return false; }
     const bool transpose = false;
     glUniformMatrix4fv( pos, 1, transpose, glm::value_ptr(val) );
     return true;
 }
 
+GLint Shader::GetUniformLocation( const std::string& name ) const
+{
+    auto it = mUniformLocations.find( name );
+    if ( it == mUniformLocations.end() ) { return -1; }
+    return it->second;
+}
+
+void Shader::SetInt( const GLint location, const int val )
+{
+    glUniform1i( location, val );
+}
+
+void Shader::SetFloat( const GLint location, const float val )
+{
+    glUniform1f( location, val );
+}
+
+void Shader::SetVec3( const GLint location, const glm::vec3& val )
+{
+    glUniform3fv( location, 1, glm::value_ptr(val) );
+}
+
+void Shader::SetMat4( const GLint location, const glm::mat4& val )
+{
+    const bool transpose = false;
+    glUniformMatrix4fv( location, 1, transpose, glm::value_ptr(val) );
+}
+
+bool Shader::SetUniformBlockBinding( const std::string& name, const GLuint binding )
+{
+    GLuint blockIdx = glGetUniformBlockIndex( mProgID, name.c_str() );
+    if ( blockIdx == GL_INVALID_INDEX ) { return false; }
+    glUniformBlockBinding( mProgID, blockIdx, binding );
+    return true;
+}
+
 // deconstructor
 Shader::~Shader(void)
 {}
@@ -117,3 +162,38 @@ GLuint Shader::GetProgID()
     return mProgID;
 }
 
+void Shader::readActiveUniforms()
+{
+    GLint numUniforms = 0;
+    GLint maxNameLen = 0;
+    glGetProgramiv( mProgID, GL_ACTIVE_UNIFORMS, &numUniforms );
+    glGetProgramiv( mProgID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLen );
+
+    std::string name( maxNameLen > 0 ? maxNameLen : 1, '\0' );
+    for ( GLint i=0; i<numUniforms; ++i )
+    {
+        GLsizei nameLen = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform( mProgID, (GLuint)i, (GLsizei)name.size(), &nameLen, &size, &type, &name[0] );
+        std::string uniformName( name.c_str(), nameLen );
+
+        // uniforms inside uniform blocks have no location
+        GLint location = glGetUniformLocation( mProgID, uniformName.c_str() );
+        if ( location < 0 ) { continue; }
+        mUniformLocations[uniformName] = location;
+
+        // arrays are reported once as "name[0]"; register the plain name
+        // and every element so any of them can be looked up
+        const size_t bracket = uniformName.rfind( "[0]" );
+        if ( bracket != std::string::npos && bracket + 3 == uniformName.size() )
+        {
+            const std::string baseName = uniformName.substr( 0, bracket );
+            mUniformLocations[baseName] = location;
+            for ( GLint elem=1; elem<size; ++elem ) {
+                const std::string elemName = baseName + "[" + std::to_string( elem ) + "]";
+                mUniformLocations[elemName] = glGetUniformLocation( mProgID, elemName.c_str() );
+            }
+        }
+    }
+}
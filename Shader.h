@@ -4,6 +4,7 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <unordered_map>
 
 #include <GL/glew.h>
 
@@ -26,10 +27,27 @@ public:
     void Use();
 
     // Set shader uniforms; returns true on success, false on failure
+    bool SetInt( const std::string& name, const int val );
     bool SetFloat( const std::string& name, const float val );
     bool SetVec3( const std::string& name, const glm::vec3& val );
     bool SetMat4( const std::string& name, const glm::mat4& val );
 
+    // Location of an active uniform, looked up in the table built at link
+    // time; -1 if the program has no such uniform. Callers that set the
+    // same uniforms every draw should keep the location and use the
+    // overloads below, which skip the name lookup entirely
+    GLint GetUniformLocation( const std::string& name ) const;
+
+    // Set shader uniforms by location; -1 is ignored like in GL
+    void SetInt( const GLint location, const int val );
+    void SetFloat( const GLint location, const float val );
+    void SetVec3( const GLint location, const glm::vec3& val );
+    void SetMat4( const GLint location, const glm::mat4& val );
+
+    // Attach the named uniform block to a uniform buffer binding point;
+    // returns false if the block doesn't exist
+    bool SetUniformBlockBinding( const std::string& name, const GLuint binding );
+
     // return the program ID
     GLuint GetProgID();
 
@@ -37,8 +55,14 @@ private:
 
     std::string getShaderStr( const std::string filename );
 
+    // fill mUniformLocations with every active uniform of the linked program
+    void readActiveUniforms();
+
     GLuint mProgID;
 
+    // active uniform name -> location; arrays have an entry per element
+    std::unordered_map<std::string, GLint> mUniformLocations;
+
 };
 
 #endif
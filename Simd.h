@@ -0,0 +1,31 @@
+#ifndef SIMD_H_INCLUDED
+#define SIMD_H_INCLUDED
+
+// Instruction set detection shared by the SIMD kernels
+
+// any x86; wider instruction sets are picked at runtime (see Skinning)
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// SSE2 is part of the x86-64 baseline, so kernels that only need it use
+// it unconditionally, without runtime dispatch
+#if defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// MSVC lets any intrinsic be used in any function; gcc/clang need the
+// instruction set enabled per function so the rest of the build can stay
+// at the baseline target
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
+#endif // SIMD_H_INCLUDED
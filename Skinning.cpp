@@ -0,0 +1,392 @@
+#include <cstring>
+
+#include "Skinning.h"
+#include "Simd.h"
+
+Skinning::Isa Skinning::sIsa = Skinning::GetSupportedIsa();
+
+#ifdef SIMD_X86
+static Skinning::Isa detectIsa()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid( info, 0 );
+    const int maxLeaf = info[0];
+    __cpuid( info, 1 );
+    const bool sse41 = (info[2] & (1 << 19)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx2 = false;
+    // the OS must also save the ymm registers on context switches
+    if ( maxLeaf >= 7 && osxsave && (_xgetbv(0) & 0x6) == 0x6 ) {
+        __cpuidex( info, 7, 0 );
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    const bool sse41 = __builtin_cpu_supports( "sse4.1" );
+    const bool avx2 = __builtin_cpu_supports( "avx2" );
+#endif
+    if ( avx2 ) { return Skinning::ISA_AVX2; }
+    if ( sse41 ) { return Skinning::ISA_SSE41; }
+    return Skinning::ISA_SCALAR;
+}
+#endif
+
+Skinning::Isa Skinning::GetSupportedIsa()
+{
+#ifdef SIMD_X86
+    static const Isa supported = detectIsa();
+    return supported;
+#else
+    return ISA_SCALAR;
+#endif
+}
+
+Skinning::Isa Skinning::GetIsa()
+{
+    return sIsa;
+}
+
+bool Skinning::SetIsa( Isa isa )
+{
+    if ( isa > GetSupportedIsa() ) {
+        return false;
+    }
+    sIsa = isa;
+    return true;
+}
+
+const char* Skinning::GetIsaName( Isa isa )
+{
+    switch ( isa )
+    {
+    case ISA_SCALAR: return "scalar";
+    case ISA_SSE41: return "SSE4.1";
+    case ISA_AVX2: return "AVX2";
+    default:
+        break;
+    }
+    return "unknown";
+}
+
+// Kernels are templated on the number of influences per vertex so the
+// loops over bones unroll at compile time and unused slots cost nothing
+
+template<int N>
+static void skinScalar(
+    const VertexTextured* inVerts,
+    glm::vec3* outPositions,
+    const VertBoneIndices* boneIdxs,
+    const VertBoneWeights* boneWeights,
+    size_t numVerts,
+    const glm::mat4* palette
+)
+{
+    for ( size_t i=0; i<numVerts; ++i )
+    {
+        const uint32_t* idxs = &boneIdxs[i].idx0;
+        const float* wgts = &boneWeights[i].weight0;
+
+        // blend the matrices first so the position is only transformed once
+        glm::mat4 blended = palette[idxs[0]] * wgts[0];
+        for ( int j=1; j<N; ++j ) {
+            blended += palette[idxs[j]] * wgts[j];
+        }
+
+        const glm::vec4 skinnedPos =
+            blended * glm::vec4( inVerts[i].x, inVerts[i].y, inVerts[i].z, 1.0f );
+
+        outPositions[i] = glm::vec3( skinnedPos );
+    }
+}
+
+#ifdef SIMD_X86
+
+// writes xyz of pos without touching the next position in memory
+SIMD_TARGET("sse4.1")
+static inline void storeXyz( glm::vec3& outPos, __m128 pos )
+{
+    _mm_storel_pi( reinterpret_cast<__m64*>( &outPos.x ), pos );
+    const int zBits = _mm_extract_ps( pos, 2 );
+    memcpy( &outPos.z, &zBits, sizeof(float) );
+}
+
+template<int N>
+SIMD_TARGET("sse4.1")
+static inline void skinVertSse41(
+    const VertexTextured& inVert,
+    glm::vec3& outPos,
+    const VertBoneIndices& boneIdxs,
+    const VertBoneWeights& boneWeights,
+    const float* palette
+)
+{
+    const uint32_t* idxs = &boneIdxs.idx0;
+    const float* wgts = &boneWeights.weight0;
+
+    // blended matrix, one column at a time (glm is column major)
+    __m128 col[4];
+    {
+        const float* mat = palette + idxs[0]*16;
+        const __m128 wgt = _mm_set1_ps( wgts[0] );
+        for ( int c=0; c<4; ++c ) {
+            col[c] = _mm_mul_ps( _mm_loadu_ps( mat + c*4 ), wgt );
+        }
+    }
+    for ( int j=1; j<N; ++j ) {
+        const float* mat = palette + idxs[j]*16;
+        const __m128 wgt = _mm_set1_ps( wgts[j] );
+        for ( int c=0; c<4; ++c ) {
+            col[c] = _mm_add_ps( col[c], _mm_mul_ps( _mm_loadu_ps( mat + c*4 ), wgt ));
+        }
+    }
+
+    // x,y,z,nx of the input vertex; w is implicitly 1
+    const __m128 p = _mm_loadu_ps( &inVert.x );
+    __m128 pos = _mm_add_ps(
+        _mm_mul_ps( col[0], _mm_shuffle_ps( p, p, _MM_SHUFFLE(0,0,0,0) )),
+        _mm_mul_ps( col[1], _mm_shuffle_ps( p, p, _MM_SHUFFLE(1,1,1,1) ))
+    );
+    pos = _mm_add_ps( pos, _mm_mul_ps( col[2], _mm_shuffle_ps( p, p, _MM_SHUFFLE(2,2,2,2) )));
+    pos = _mm_add_ps( pos, col[3] );
+
+    storeXyz( outPos, pos );
+}
+
+template<int N>
+SIMD_TARGET("sse4.1")
+static void skinSse41(
+    const VertexTextured* inVerts,
+    glm::vec3* outPositions,
+    const VertBoneIndices* boneIdxs,
+    const VertBoneWeights* boneWeights,
+    size_t numVerts,
+    const glm::mat4* palette
+)
+{
+    const float* pal = &palette[0][0][0];
+    size_t i = 0;
+    for ( ; i+4 <= numVerts; i += 4 ) {
+        skinVertSse41<N>( inVerts[i+0], outPositions[i+0], boneIdxs[i+0], boneWeights[i+0], pal );
+        skinVertSse41<N>( inVerts[i+1], outPositions[i+1], boneIdxs[i+1], boneWeights[i+1], pal );
+        skinVertSse41<N>( inVerts[i+2], outPositions[i+2], boneIdxs[i+2], boneWeights[i+2], pal );
+        skinVertSse41<N>( inVerts[i+3], outPositions[i+3], boneIdxs[i+3], boneWeights[i+3], pal );
+    }
+    for ( ; i<numVerts; ++i ) {
+        skinVertSse41<N>( inVerts[i], outPositions[i], boneIdxs[i], boneWeights[i], pal );
+    }
+}
+
+SIMD_TARGET("avx2")
+static inline __m256 loadPairAvx2( const float* hi, const float* lo )
+{
+    return _mm256_insertf128_ps(
+        _mm256_castps128_ps256( _mm_loadu_ps( lo )),
+        _mm_loadu_ps( hi ),
+        1
+    );
+}
+
+// Skins two vertices at once; the low 128 bit lane holds vertex i,
+// the high lane vertex i+1
+template<int N>
+SIMD_TARGET("avx2")
+static inline void skinVertPairAvx2(
+    const VertexTextured* inVerts,
+    glm::vec3* outPositions,
+    const VertBoneIndices* boneIdxs,
+    const VertBoneWeights* boneWeights,
+    const float* palette
+)
+{
+    // weights of both vertices fit in one register; broadcast each
+    // weight across its vertex's lane
+    const __m256 wgts = _mm256_loadu_ps( &boneWeights[0].weight0 );
+    const uint32_t* idxsA = &boneIdxs[0].idx0;
+    const uint32_t* idxsB = &boneIdxs[1].idx0;
+
+    __m256 col[4];
+    for ( int j=0; j<N; ++j ) {
+        const __m256 wgt = _mm256_permutevar8x32_ps(
+            wgts,
+            _mm256_setr_epi32( j,j,j,j, j+4,j+4,j+4,j+4 )
+        );
+        const float* matA = palette + idxsA[j]*16;
+        const float* matB = palette + idxsB[j]*16;
+        for ( int c=0; c<4; ++c ) {
+            const __m256 weighted = _mm256_mul_ps( loadPairAvx2( matB + c*4, matA + c*4 ), wgt );
+            col[c] = (j == 0) ? weighted : _mm256_add_ps( col[c], weighted );
+        }
+    }
+
+    const __m256 p = loadPairAvx2( &inVerts[1].x, &inVerts[0].x );
+    __m256 pos = _mm256_add_ps(
+        _mm256_mul_ps( col[0], _mm256_shuffle_ps( p, p, _MM_SHUFFLE(0,0,0,0) )),
+        _mm256_mul_ps( col[1], _mm256_shuffle_ps( p, p, _MM_SHUFFLE(1,1,1,1) ))
+    );
+    pos = _mm256_add_ps( pos, _mm256_mul_ps( col[2], _mm256_shuffle_ps( p, p, _MM_SHUFFLE(2,2,2,2) )));
+    pos = _mm256_add_ps( pos, col[3] );
+
+    storeXyz( outPositions[0], _mm256_castps256_ps128( pos ));
+    storeXyz( outPositions[1], _mm256_extractf128_ps( pos, 1 ));
+}
+
+template<int N>
+SIMD_TARGET("avx2")
+static void skinAvx2(
+    const VertexTextured* inVerts,
+    glm::vec3* outPositions,
+    const VertBoneIndices* boneIdxs,
+    const VertBoneWeights* boneWeights,
+    size_t numVerts,
+    const glm::mat4* palette
+)
+{
+    const float* pal = &palette[0][0][0];
+    size_t i = 0;
+    for ( ; i+8 <= numVerts; i += 8 ) {
+        skinVertPairAvx2<N>( inVerts+i+0, outPositions+i+0, boneIdxs+i+0, boneWeights+i+0, pal );
+        skinVertPairAvx2<N>( inVerts+i+2, outPositions+i+2, boneIdxs+i+2, boneWeights+i+2, pal );
+        skinVertPairAvx2<N>( inVerts+i+4, outPositions+i+4, boneIdxs+i+4, boneWeights+i+4, pal );
+        skinVertPairAvx2<N>( inVerts+i+6, outPositions+i+6, boneIdxs+i+6, boneWeights+i+6, pal );
+    }
+    for ( ; i+2 <= numVerts; i += 2 ) {
+        skinVertPairAvx2<N>( inVerts+i, outPositions+i, boneIdxs+i, boneWeights+i, pal );
+    }
+    if ( i < numVerts ) {
+        skinVertSse41<N>( inVerts[i], outPositions[i], boneIdxs[i], boneWeights[i], pal );
+    }
+}
+
+#endif // SIMD_X86
+
+template<int N>
+static void skinDispatch(
+    Skinning::Isa isa,
+    const VertexTextured* inVerts,
+    glm::vec3* outPositions,
+    const VertBoneIndices* boneIdxs,
+    const VertBoneWeights* boneWeights,
+    size_t numVerts,
+    const glm::mat4* palette
+)
+{
+    switch ( isa )
+    {
+#ifdef SIMD_X86
+    case Skinning::ISA_AVX2:
+        skinAvx2<N>( inVerts, outPositions, boneIdxs, boneWeights, numVerts, palette );
+        break;
+    case Skinning::ISA_SSE41:
+        skinSse41<N>( inVerts, outPositions, boneIdxs, boneWeights, numVerts, palette );
+        break;
+#endif
+    default:
+        skinScalar<N>( inVerts, outPositions, boneIdxs, boneWeights, numVerts, palette );
+        break;
+    }
+}
+
+void Skinning::SkinPositions(
+    const VertexTextured* inVerts,
+    glm::vec3* outPositions,
+    const VertBoneIndices* boneIdxs,
+    const VertBoneWeights* boneWeights,
+    size_t numVerts,
+    const glm::mat4* palette,
+    int numInfluences
+)
+{
+    switch ( numInfluences )
+    {
+    case 1: skinDispatch<1>( sIsa, inVerts, outPositions, boneIdxs, boneWeights, numVerts, palette ); break;
+    case 2: skinDispatch<2>( sIsa, inVerts, outPositions, boneIdxs, boneWeights, numVerts, palette ); break;
+    case 3: skinDispatch<3>( sIsa, inVerts, outPositions, boneIdxs, boneWeights, numVerts, palette ); break;
+    default: skinDispatch<4>( sIsa, inVerts, outPositions, boneIdxs, boneWeights, numVerts, palette ); break;
+    }
+}
+
+void Skinning::PaletteToDualQuats(
+    const glm::mat4* palette,
+    DualQuat* outDualQuats,
+    size_t numBones
+)
+{
+    for ( size_t i=0; i<numBones; ++i )
+    {
+        const glm::mat4& mat = palette[i];
+        // normalize the axes so scale doesn't end up in the rotation
+        const glm::mat3 rotMat(
+            glm::normalize( glm::vec3( mat[0] )),
+            glm::normalize( glm::vec3( mat[1] )),
+            glm::normalize( glm::vec3( mat[2] ))
+        );
+        const glm::quat real = glm::normalize( glm::quat_cast( rotMat ));
+        const glm::vec3 trans( mat[3] );
+        outDualQuats[i].real = real;
+        outDualQuats[i].dual =
+            glm::quat( 0.0f, trans.x, trans.y, trans.z ) * real * 0.5f;
+    }
+}
+
+template<int N>
+static void skinDualQuat(
+    const VertexTextured* inVerts,
+    glm::vec3* outPositions,
+    const VertBoneIndices* boneIdxs,
+    const VertBoneWeights* boneWeights,
+    size_t numVerts,
+    const DualQuat* dualQuats
+)
+{
+    for ( size_t i=0; i<numVerts; ++i )
+    {
+        const uint32_t* idxs = &boneIdxs[i].idx0;
+        const float* wgts = &boneWeights[i].weight0;
+
+        const DualQuat& dq0 = dualQuats[idxs[0]];
+        glm::quat real = dq0.real * wgts[0];
+        glm::quat dual = dq0.dual * wgts[0];
+        for ( int j=1; j<N; ++j ) {
+            const DualQuat& dq = dualQuats[idxs[j]];
+            // q and -q are the same rotation; blend along the shortest path
+            const float wgt = glm::dot( dq0.real, dq.real ) < 0.0f ? -wgts[j] : wgts[j];
+            real = real + dq.real * wgt;
+            dual = dual + dq.dual * wgt;
+        }
+        const float invLen = 1.0f / glm::length( real );
+        real = real * invLen;
+        dual = dual * invLen;
+
+        // rotate then translate: p' = p + 2r x (r x p + wp) + 2(w_r d - w_d r + r x d)
+        const glm::vec3 p( inVerts[i].x, inVerts[i].y, inVerts[i].z );
+        const glm::vec3 r( real.x, real.y, real.z );
+        const glm::vec3 d( dual.x, dual.y, dual.z );
+        const glm::vec3 skinnedPos =
+            p +
+            2.0f * glm::cross( r, glm::cross( r, p ) + real.w * p ) +
+            2.0f * ( real.w * d - dual.w * r + glm::cross( r, d ));
+
+        outPositions[i] = glm::vec3( skinnedPos );
+    }
+}
+
+void Skinning::SkinPositionsDualQuat(
+    const VertexTextured* inVerts,
+    glm::vec3* outPositions,
+    const VertBoneIndices* boneIdxs,
+    const VertBoneWeights* boneWeights,
+    size_t numVerts,
+    const DualQuat* dualQuats,
+    int numInfluences
+)
+{
+    switch ( numInfluences )
+    {
+    case 1: skinDualQuat<1>( inVerts, outPositions, boneIdxs, boneWeights, numVerts, dualQuats ); break;
+    case 2: skinDualQuat<2>( inVerts, outPositions, boneIdxs, boneWeights, numVerts, dualQuats ); break;
+    case 3: skinDualQuat<3>( inVerts, outPositions, boneIdxs, boneWeights, numVerts, dualQuats ); break;
+    default: skinDualQuat<4>( inVerts, outPositions, boneIdxs, boneWeights, numVerts, dualQuats ); break;
+    }
+}
+
@@ -0,0 +1,125 @@
+#ifndef SKINNING_H_INCLUDED
+#define SKINNING_H_INCLUDED
+
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "VertexBuffer.h"
+
+// max number of bones influencing a single vertex
+#define MAX_BONE_INFLUENCES 4
+
+// Up to 4 bones influencing a single vertex. Used influences come first;
+// unused slots have weight 0
+struct VertBoneIndices
+{
+    uint32_t idx0;
+    uint32_t idx1;
+    uint32_t idx2;
+    uint32_t idx3;
+};
+struct VertBoneWeights
+{
+    float weight0;
+    float weight1;
+    float weight2;
+    float weight3;
+};
+
+// Rigid bone transform as a unit dual quaternion (32 bytes vs 64 for a mat4).
+// real is the rotation, dual = 0.5 * translation * real
+struct DualQuat
+{
+    glm::quat real;
+    glm::quat dual;
+};
+
+/* Linear blend skinning kernels with runtime instruction set dispatch */
+class Skinning
+{
+public:
+
+    enum Isa
+    {
+        ISA_SCALAR, // plain glm, works everywhere
+        ISA_SSE41, // 4 vertices per loop iteration
+        ISA_AVX2 // 8 vertices per loop iteration
+    };
+
+    // The best instruction set the current CPU supports (detected once)
+    static Isa GetSupportedIsa();
+
+    // The instruction set SkinPositions currently uses;
+    // defaults to GetSupportedIsa()
+    static Isa GetIsa();
+
+    // Force a specific kernel, e.g. to compare output against ISA_SCALAR.
+    // Returns false if the CPU does not support the requested isa
+    static bool SetIsa( Isa isa );
+
+    static const char* GetIsaName( Isa isa );
+
+    /**
+     * @brief Skin vertex positions with up to 4 bones per vertex
+     *
+     * For each vertex the palette matrices are blended by the vertex weights
+     * first, and the position is then transformed once by the blended matrix.
+     * The skinned positions are written tightly packed, ready to upload to a
+     * VertexBuffer position stream.
+     *
+     * @param inVerts bind pose vertices
+     * @param outPositions where the skinned positions are written
+     * @param boneIdxs palette indices for each vertex
+     * @param boneWeights bone weights for each vertex
+     * @param numVerts number of entries in each of the above arrays
+     * @param palette skinning matrices (current pose * inverse bind pose)
+     * @param numInfluences how many leading bone slots are used by every
+     *      vertex in the range (1-4); selects a kernel specialized for that
+     *      count so unused slots are never touched
+     */
+    static void SkinPositions(
+        const VertexTextured* inVerts,
+        glm::vec3* outPositions,
+        const VertBoneIndices* boneIdxs,
+        const VertBoneWeights* boneWeights,
+        size_t numVerts,
+        const glm::mat4* palette,
+        int numInfluences = MAX_BONE_INFLUENCES
+    );
+
+    // Convert skinning matrices to dual quaternions. Dual quaternions can
+    // only hold rotation and translation, so any scale in the matrices is
+    // dropped
+    static void PaletteToDualQuats(
+        const glm::mat4* palette,
+        DualQuat* outDualQuats,
+        size_t numBones
+    );
+
+    /**
+     * @brief Skin vertex positions by dual quaternion blending
+     *
+     * Same as SkinPositions, but blends the bone dual quaternions instead of
+     * matrices. Avoids the volume loss (candy wrapper) of linear blending
+     * around twisting joints.
+     */
+    static void SkinPositionsDualQuat(
+        const VertexTextured* inVerts,
+        glm::vec3* outPositions,
+        const VertBoneIndices* boneIdxs,
+        const VertBoneWeights* boneWeights,
+        size_t numVerts,
+        const DualQuat* dualQuats,
+        int numInfluences = MAX_BONE_INFLUENCES
+    );
+
+private:
+
+    static Isa sIsa;
+};
+
+#endif // SKINNING_H_INCLUDED
+
@@ -0,0 +1,151 @@
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+// set while a thread runs chunks of a job, on the workers and on the
+// submitting thread alike, so nested ParallelFor calls run inline
+// instead of deadlocking on mSubmitMutex
+static thread_local bool sInsideJob = false;
+
+// static class instance
+ThreadPool ThreadPool::sInstance;
+ThreadPool::ThreadPool() :
+    mJobGeneration( 0 ),
+    mBusyWorkers( 0 ),
+    mQuit( false )
+{
+    mJob.func = nullptr;
+    mJob.count = 0;
+    mJob.chunkSize = 0;
+    mJob.numChunks = 0;
+    mJob.nextChunk = 0;
+    mJob.doneChunks = 0;
+}
+
+ThreadPool::~ThreadPool()
+{
+    Shutdown();
+}
+
+void ThreadPool::Init( const size_t numWorkers )
+{
+    Shutdown();
+    mQuit = false;
+    mWorkers.reserve( numWorkers );
+    for ( size_t i=0; i<numWorkers; ++i ) {
+        mWorkers.emplace_back( &ThreadPool::workerLoop, this );
+    }
+}
+
+void ThreadPool::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        mQuit = true;
+    }
+    mWorkCv.notify_all();
+    for ( std::thread& worker : mWorkers ) {
+        worker.join();
+    }
+    mWorkers.clear();
+}
+
+size_t ThreadPool::GetDefaultNumWorkers()
+{
+    const unsigned int numCores = std::thread::hardware_concurrency();
+    return numCores > 1 ? numCores - 1 : 0;
+}
+
+void ThreadPool::ParallelFor(
+    const size_t count,
+    const size_t minChunkSize,
+    const RangeFunc& func
+)
+{
+    if ( count == 0 ) { return; }
+
+    const size_t numThreads = mWorkers.size() + 1;
+    const size_t chunkSize = std::max( minChunkSize, (count + numThreads - 1) / numThreads );
+    run( count, chunkSize, func );
+}
+
+void ThreadPool::ParallelForDynamic(
+    const size_t count,
+    const size_t chunkSize,
+    const RangeFunc& func
+)
+{
+    if ( count == 0 ) { return; }
+    run( count, std::max( chunkSize, (size_t)1 ), func );
+}
+
+void ThreadPool::run( const size_t count, const size_t chunkSize, const RangeFunc& func )
+{
+    if ( mWorkers.empty() || sInsideJob || chunkSize >= count ) {
+        func( 0, count );
+        return;
+    }
+
+    std::lock_guard<std::mutex> submitLock( mSubmitMutex );
+    std::unique_lock<std::mutex> lock( mMutex );
+    mJob.func = &func;
+    mJob.count = count;
+    mJob.chunkSize = chunkSize;
+    mJob.numChunks = (count + chunkSize - 1) / chunkSize;
+    mJob.nextChunk = 0;
+    mJob.doneChunks = 0;
+    ++mJobGeneration;
+    mWorkCv.notify_all();
+
+    // the calling thread works too instead of just waiting
+    sInsideJob = true;
+    runChunks( lock );
+    sInsideJob = false;
+
+    // wait until every chunk is done and no worker still looks at mJob
+    mDoneCv.wait( lock, [this]() {
+        return mJob.doneChunks == mJob.numChunks && mBusyWorkers == 0;
+    });
+    mJob.func = nullptr;
+}
+
+void ThreadPool::runChunks( std::unique_lock<std::mutex>& lock )
+{
+    while ( mJob.nextChunk < mJob.numChunks )
+    {
+        const size_t chunk = mJob.nextChunk++;
+        const size_t begin = chunk * mJob.chunkSize;
+        const size_t end = std::min( begin + mJob.chunkSize, mJob.count );
+        const RangeFunc& func = *mJob.func;
+
+        lock.unlock();
+        func( begin, end );
+        lock.lock();
+
+        ++mJob.doneChunks;
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    sInsideJob = true;
+    size_t seenGeneration = 0;
+
+    std::unique_lock<std::mutex> lock( mMutex );
+    while ( true )
+    {
+        mWorkCv.wait( lock, [this,&seenGeneration]() {
+            return mQuit || mJobGeneration != seenGeneration;
+        });
+        if ( mQuit ) {
+            break;
+        }
+        seenGeneration = mJobGeneration;
+
+        ++mBusyWorkers;
+        runChunks( lock );
+        --mBusyWorkers;
+        mDoneCv.notify_one();
+    }
+}
+
@@ -0,0 +1,82 @@
+#ifndef THREAD_POOL_H_INCLUDED
+#define THREAD_POOL_H_INCLUDED
+
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/* Persistent worker thread pool Singleton Class */
+class ThreadPool
+{
+public:
+
+    // Work function for ParallelFor; called with the range [begin,end)
+    typedef std::function<void( size_t begin, size_t end )> RangeFunc;
+
+    static ThreadPool* GetInstance() { return &sInstance; }
+
+    // Start the given number of worker threads. The thread calling
+    // ParallelFor also does work, so numWorkers = cores-1 keeps every
+    // core busy. 0 workers runs everything on the calling thread.
+    void Init( const size_t numWorkers );
+    ~ThreadPool();
+
+    // Stop and join all worker threads
+    void Shutdown();
+
+    // cores-1, or 0 if the core count is unknown
+    static size_t GetDefaultNumWorkers();
+
+    size_t GetNumWorkers() const { return mWorkers.size(); }
+
+    // Split [0,count) into chunks of at least minChunkSize and run func
+    // on them across the workers and the calling thread. Returns once
+    // every chunk has finished. Calls from inside a chunk run serially.
+    void ParallelFor( const size_t count, const size_t minChunkSize, const RangeFunc& func );
+
+    // Same as ParallelFor, but always hands out chunks of chunkSize, so
+    // threads that finish early keep taking more. For items of uneven
+    // cost, e.g. one chunk per character
+    void ParallelForDynamic( const size_t count, const size_t chunkSize, const RangeFunc& func );
+
+private:
+
+    struct Job
+    {
+        const RangeFunc* func;
+        size_t count;
+        size_t chunkSize;
+        size_t numChunks;
+        size_t nextChunk; // next chunk to hand out
+        size_t doneChunks; // number of finished chunks
+    };
+
+    std::vector<std::thread> mWorkers;
+    std::mutex mMutex;
+    std::mutex mSubmitMutex; // only one ParallelFor job in flight at a time
+    std::condition_variable mWorkCv; // signals workers a new job is ready
+    std::condition_variable mDoneCv; // signals the caller a chunk finished
+    Job mJob;
+    size_t mJobGeneration; // incremented for each new job
+    size_t mBusyWorkers; // workers currently inside runChunks
+    bool mQuit;
+
+    void workerLoop();
+    // Run func over [0,count) in chunks of chunkSize and wait for them
+    void run( const size_t count, const size_t chunkSize, const RangeFunc& func );
+    // Take and run chunks of mJob until none are left; mMutex must be
+    // held on entry and is held again on return
+    void runChunks( std::unique_lock<std::mutex>& lock );
+
+    // singleton instance and enforced private ctor/copy/assignment
+    static ThreadPool sInstance;
+    ThreadPool();
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+};
+
+#endif // THREAD_POOL_H_INCLUDED
+
@@ -8,6 +8,45 @@
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+// Affine transform as the top 3 rows of a mat4; the bottom row is
+// always 0,0,0,1 so it isn't stored or multiplied
+struct Affine
+{
+    glm::vec4 rows[3];
+
+    inline Affine() {
+        rows[0] = glm::vec4( 1.0f, 0.0f, 0.0f, 0.0f );
+        rows[1] = glm::vec4( 0.0f, 1.0f, 0.0f, 0.0f );
+        rows[2] = glm::vec4( 0.0f, 0.0f, 1.0f, 0.0f );
+    }
+    // drops the bottom row of mat
+    inline explicit Affine( const glm::mat4& mat ) {
+        for ( int row=0; row<3; ++row ) {
+            rows[row] = glm::vec4( mat[0][row], mat[1][row], mat[2][row], mat[3][row] );
+        }
+    }
+
+    inline glm::mat4 ToMat4() const {
+        return glm::mat4(
+            glm::vec4( rows[0].x, rows[1].x, rows[2].x, 0.0f ),
+            glm::vec4( rows[0].y, rows[1].y, rows[2].y, 0.0f ),
+            glm::vec4( rows[0].z, rows[1].z, rows[2].z, 0.0f ),
+            glm::vec4( rows[0].w, rows[1].w, rows[2].w, 1.0f )
+        );
+    }
+};
+
+// a * b; 36 multiplies instead of a mat4's 64
+inline Affine operator*( const Affine& a, const Affine& b ) {
+    Affine result;
+    for ( int row=0; row<3; ++row ) {
+        const glm::vec4& r = a.rows[row];
+        result.rows[row] = b.rows[0] * r.x + b.rows[1] * r.y + b.rows[2] * r.z;
+        result.rows[row].w += r.w;
+    }
+    return result;
+}
+
 struct Transform
 {
     glm::vec3 position;
@@ -20,11 +59,34 @@ struct Transform
         scale(1.0f,1.0f,1.0f)
     {}
 
-    inline glm::mat4 ToMat4() {
-        return
-            glm::translate( glm::mat4(1.0f), position ) *
-            glm::mat4_cast( rotation ) *
-            glm::scale( glm::mat4(1.0f), scale );
+    // translate * rotate * scale, written out directly instead of
+    // multiplying the 3 matrices
+    inline Affine ToAffine() const {
+        const float x = rotation.x, y = rotation.y, z = rotation.z, w = rotation.w;
+        Affine result;
+        result.rows[0] = glm::vec4(
+            (1.0f - 2.0f * (y*y + z*z)) * scale.x,
+            2.0f * (x*y - w*z) * scale.y,
+            2.0f * (x*z + w*y) * scale.z,
+            position.x
+        );
+        result.rows[1] = glm::vec4(
+            2.0f * (x*y + w*z) * scale.x,
+            (1.0f - 2.0f * (x*x + z*z)) * scale.y,
+            2.0f * (y*z - w*x) * scale.z,
+            position.y
+        );
+        result.rows[2] = glm::vec4(
+            2.0f * (x*z - w*y) * scale.x,
+            2.0f * (y*z + w*x) * scale.y,
+            (1.0f - 2.0f * (x*x + y*y)) * scale.z,
+            position.z
+        );
+        return result;
+    }
+
+    inline glm::mat4 ToMat4() const {
+        return ToAffine().ToMat4();
     }
 };
 
@@ -1,4 +1,8 @@
+#include <cassert>
 #include <iostream>
+#include <vector>
+#include <cstddef>
+#include <cstring>
 #include "VertexBuffer.h"
 
 VertexBuffer::VertexBuffer(
@@ -12,10 +16,19 @@ VertexBuffer::VertexBuffer(
         mVAO( 0 ),
         mVBO( 0 ),
         mEBO( 0 ),
+        mMultiStream( false ),
         mNumVertices( 0 ),
         mVertexStride( 0 ),
-        mNumIndices( 0 )
+        mNumIndices( 0 ),
+        mDrawQueued( false )
 {
+    for ( int i=0; i<NUM_STREAMS; ++i ) {
+        mStreamVBOs[i] = 0;
+        mStreamStrides[i] = 0;
+        mStreamRings[i].buffer = 0;
+    }
+    mVertexRing.buffer = 0;
+
     int attribLocation; // aPos, where we set location = 0
     int dataType;
     int shouldNormalize;
@@ -27,6 +40,7 @@ VertexBuffer::VertexBuffer(
     case POS_COLOR: mVertexStride = sizeof( VertexColored ); break;
     case POS_TEXCOORD: mVertexStride = sizeof( VertexTextured ); break;
     case POS_TEX_COLOR_2D: mVertexStride = sizeof( VertexTexCol2d ); break;
+    case POS_TEXCOORD_SKINNED: mVertexStride = sizeof( VertexSkinned ); break;
     default:
         std::cerr << "Unhandled vertex buffer type: " << (int)type << std::endl;
         exit( EXIT_FAILURE );
@@ -41,12 +55,16 @@ VertexBuffer::VertexBuffer(
     }
     glBindVertexArray( mVAO );
     glBindBuffer( GL_ARRAY_BUFFER, mVBO );
-    glBufferData(
-        GL_ARRAY_BUFFER,
-        verticesSize * mVertexStride,
-        vertices,
-        (usage == USAGE_STATIC) ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW
-    );
+    if ( usage == USAGE_DYNAMIC ) {
+        createRing( mVertexRing, mVBO, verticesSize * mVertexStride, vertices );
+    } else {
+        glBufferData(
+            GL_ARRAY_BUFFER,
+            verticesSize * mVertexStride,
+            vertices,
+            GL_STATIC_DRAW
+        );
+    }
     if ( indices != nullptr && indicesSize > 0 )
     {
         glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mEBO );
@@ -61,6 +79,7 @@ VertexBuffer::VertexBuffer(
     mType = type;
     mNumVertices = verticesSize;
     mNumIndices = indicesSize;
+    computeBounds( vertices );
     switch (type)
     {
     case POS_COLOR:
@@ -159,6 +178,84 @@ VertexBuffer::VertexBuffer(
         );
         glEnableVertexAttribArray( attribLocation );
         break;
+    case POS_TEXCOORD_SKINNED:
+        // position
+        attribLocation = 0; // aPos, where we set location = 0
+        dataType = GL_FLOAT;
+        shouldNormalize = GL_FALSE;
+        floatsPerVertex = 3; // xyz
+        beginOffset = (void*)0;
+        glVertexAttribPointer(
+            attribLocation,
+            floatsPerVertex,
+            dataType,
+            shouldNormalize,
+            mVertexStride,
+            beginOffset
+        );
+        glEnableVertexAttribArray( attribLocation );
+        // normal 
+        attribLocation = 1; // aNormal, where we set location = 1
+        dataType = GL_FLOAT;
+        shouldNormalize = GL_FALSE;
+        floatsPerVertex = 3; // nx,ny,nz
+        beginOffset = (void*)( 3 * sizeof( float )); // skip xyz
+        glVertexAttribPointer(
+            attribLocation,
+            floatsPerVertex,
+            dataType,
+            shouldNormalize,
+            mVertexStride,
+            beginOffset
+        );
+        glEnableVertexAttribArray( attribLocation );
+        
+        // tex coord
+        attribLocation = 2; // aTexCoord, where we set location = 2
+        dataType = GL_FLOAT;
+        shouldNormalize = GL_FALSE;
+        floatsPerVertex = 2; // uv
+        beginOffset = (void*)( 6 * sizeof( float )); // skip xyz, nxnynz
+        glVertexAttribPointer(
+            attribLocation,
+            floatsPerVertex,
+            dataType,
+            shouldNormalize,
+            mVertexStride,
+            beginOffset
+        );
+        glEnableVertexAttribArray( attribLocation );
+
+        // bone indices; integer attribute so use the I version
+        attribLocation = 3; // aBoneIdxs, where we set location = 3
+        dataType = GL_UNSIGNED_INT;
+        floatsPerVertex = 4; // 4 indices
+        beginOffset = (void*)( 8 * sizeof( float )); // skip xyz, nxnynz, uv
+        glVertexAttribIPointer(
+            attribLocation,
+            floatsPerVertex,
+            dataType,
+            mVertexStride,
+            beginOffset
+        );
+        glEnableVertexAttribArray( attribLocation );
+
+        // bone weights
+        attribLocation = 4; // aBoneWeights, where we set location = 4
+        dataType = GL_FLOAT;
+        shouldNormalize = GL_FALSE;
+        floatsPerVertex = 4; // 4 weights
+        beginOffset = (void*)( 8 * sizeof( float ) + 4 * sizeof( uint32_t )); // skip xyz, nxnynz, uv, bone indices
+        glVertexAttribPointer(
+            attribLocation,
+            floatsPerVertex,
+            dataType,
+            shouldNormalize,
+            mVertexStride,
+            beginOffset
+        );
+        glEnableVertexAttribArray( attribLocation );
+        break;
     case POS_TEX_COLOR_2D:
         // position
         attribLocation = 0; // aPos, where we set location = 0
@@ -224,12 +321,206 @@ VertexBuffer::VertexBuffer(
     }
 }
 
+VertexBuffer::VertexBuffer(
+    Type type,
+    void* vertices,
+    size_t verticesSize,
+    uint32_t* indices,
+    size_t indicesSize,
+    const Usage streamUsage[NUM_STREAMS] ) :
+        mType( UNINITIALIZED ),
+        mVAO( 0 ),
+        mVBO( 0 ),
+        mEBO( 0 ),
+        mMultiStream( true ),
+        mNumVertices( 0 ),
+        mVertexStride( 0 ),
+        mNumIndices( 0 ),
+        mDrawQueued( false )
+{
+    // where each stream's data is within the interleaved input vertex
+    size_t streamOffsets[NUM_STREAMS] = { 0 };
+    for ( int i=0; i<NUM_STREAMS; ++i ) {
+        mStreamVBOs[i] = 0;
+        mStreamStrides[i] = 0;
+        mStreamRings[i].buffer = 0;
+    }
+    mVertexRing.buffer = 0;
+    switch ( type )
+    {
+    case POS_TEXCOORD:
+        mVertexStride = sizeof( VertexTextured );
+        streamOffsets[STREAM_POSITION] = offsetof( VertexTextured, x );
+        streamOffsets[STREAM_NORMAL] = offsetof( VertexTextured, nx );
+        streamOffsets[STREAM_TEXCOORD] = offsetof( VertexTextured, u );
+        break;
+    case POS_TEXCOORD_SKINNED:
+        mVertexStride = sizeof( VertexSkinned );
+        streamOffsets[STREAM_POSITION] = offsetof( VertexSkinned, x );
+        streamOffsets[STREAM_NORMAL] = offsetof( VertexSkinned, nx );
+        streamOffsets[STREAM_TEXCOORD] = offsetof( VertexSkinned, u );
+        streamOffsets[STREAM_SKIN] = offsetof( VertexSkinned, boneIdx );
+        mStreamStrides[STREAM_SKIN] = 4 * sizeof( uint32_t ) + 4 * sizeof( float );
+        break;
+    default:
+        std::cerr << "Unhandled multi stream vertex buffer type: " << (int)type << std::endl;
+        exit( EXIT_FAILURE );
+        break;
+    }
+    mStreamStrides[STREAM_POSITION] = 3 * sizeof( float );
+    mStreamStrides[STREAM_NORMAL] = 3 * sizeof( float );
+    mStreamStrides[STREAM_TEXCOORD] = 2 * sizeof( float );
+
+    glGenVertexArrays( 1, &mVAO );
+    glBindVertexArray( mVAO );
+
+    // split the interleaved vertices into one packed buffer per stream
+    std::vector<uint8_t> streamData;
+    const uint8_t* srcVerts = static_cast<const uint8_t*>( vertices );
+    for ( int stream=0; stream<NUM_STREAMS; ++stream )
+    {
+        const size_t stride = mStreamStrides[stream];
+        if ( stride == 0 ) { continue; }
+
+        streamData.resize( verticesSize * stride );
+        for ( size_t i=0; i<verticesSize; ++i ) {
+            memcpy(
+                &streamData[i * stride],
+                srcVerts + i * mVertexStride + streamOffsets[stream],
+                stride
+            );
+        }
+
+        glGenBuffers( 1, &mStreamVBOs[stream] );
+        glBindBuffer( GL_ARRAY_BUFFER, mStreamVBOs[stream] );
+        if ( streamUsage[stream] == USAGE_DYNAMIC ) {
+            createRing( mStreamRings[stream], mStreamVBOs[stream], streamData.size(), streamData.data() );
+        } else {
+            glBufferData(
+                GL_ARRAY_BUFFER,
+                streamData.size(),
+                streamData.data(),
+                GL_STATIC_DRAW
+            );
+        }
+
+        // draws start out reading the first ring region
+        setStreamAttribs( (Stream)stream, 0 );
+    }
+
+    if ( indices != nullptr && indicesSize > 0 )
+    {
+        glGenBuffers( 1, &mEBO );
+        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mEBO );
+        glBufferData(
+            GL_ELEMENT_ARRAY_BUFFER,
+            indicesSize * sizeof( uint32_t ),
+            indices,
+            GL_STATIC_DRAW
+        );
+    }
+
+    mType = type;
+    mNumVertices = verticesSize;
+    mNumIndices = indicesSize;
+    computeBounds( vertices );
+
+    // unbind the current buffers
+    // ORDER MATTERS - the VAO must be unbinded FIRST!
+    glBindVertexArray( 0 );
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    if ( indices != nullptr && indicesSize > 0 )
+    {
+        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+    }
+}
+
+VertexBuffer::VertexBuffer(
+    const std::shared_ptr<const VertexBuffer>& source,
+    const Usage streamUsage[NUM_STREAMS] ) :
+        mType( source->mType ),
+        mVAO( 0 ),
+        mVBO( 0 ),
+        mEBO( source->mEBO ),
+        mMultiStream( true ),
+        mNumVertices( source->mNumVertices ),
+        mVertexStride( source->mVertexStride ),
+        mNumIndices( source->mNumIndices ),
+        mBounds( source->mBounds ),
+        mBoundingSphere( source->mBoundingSphere ),
+        mSharedSource( source ),
+        mDrawQueued( false )
+{
+    if ( !source->mMultiStream ) {
+        std::cerr << "VertexBuffer: can only share the streams of a multi stream buffer" << std::endl;
+        exit( EXIT_FAILURE );
+    }
+    mVertexRing.buffer = 0;
+
+    glGenVertexArrays( 1, &mVAO );
+    glBindVertexArray( mVAO );
+    for ( int stream=0; stream<NUM_STREAMS; ++stream )
+    {
+        mStreamVBOs[stream] = 0;
+        mStreamStrides[stream] = source->mStreamStrides[stream];
+        mStreamRings[stream].buffer = 0;
+        if ( source->mStreamVBOs[stream] == 0 ) { continue; }
+
+        // the source's own dynamic streams move between ring regions, so
+        // they can't be shared either
+        const Ring& sourceRing = source->mStreamRings[stream];
+        if ( streamUsage[stream] == USAGE_STATIC && sourceRing.buffer == 0 ) {
+            mStreamVBOs[stream] = source->mStreamVBOs[stream];
+            glBindBuffer( GL_ARRAY_BUFFER, mStreamVBOs[stream] );
+        } else {
+            const size_t regionSize = mNumVertices * mStreamStrides[stream];
+            const size_t sourceOffset = sourceRing.buffer != 0 ? sourceRing.curRegion * regionSize : 0;
+            glGenBuffers( 1, &mStreamVBOs[stream] );
+            glBindBuffer( GL_ARRAY_BUFFER, mStreamVBOs[stream] );
+            createRing( mStreamRings[stream], mStreamVBOs[stream], regionSize, nullptr );
+            glBindBuffer( GL_COPY_READ_BUFFER, source->mStreamVBOs[stream] );
+            for ( int i=0; i<RING_REGIONS; ++i ) {
+                glCopyBufferSubData(
+                    GL_COPY_READ_BUFFER,
+                    GL_ARRAY_BUFFER,
+                    sourceOffset,
+                    i * regionSize,
+                    regionSize
+                );
+            }
+            glBindBuffer( GL_COPY_READ_BUFFER, 0 );
+        }
+        setStreamAttribs( (Stream)stream, 0 );
+    }
+    if ( mEBO != 0 ) {
+        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mEBO );
+    }
+
+    // ORDER MATTERS - the VAO must be unbinded FIRST!
+    glBindVertexArray( 0 );
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    if ( mEBO != 0 ) {
+        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+    }
+}
+
 VertexBuffer::~VertexBuffer()
 {
-    if ( mNumVertices != 0 ) {
+    destroyRing( mVertexRing );
+    for ( int i=0; i<NUM_STREAMS; ++i ) {
+        destroyRing( mStreamRings[i] );
+    }
+    if ( mMultiStream ) {
+        for ( int i=0; i<NUM_STREAMS; ++i ) {
+            const bool shared = mSharedSource && mStreamVBOs[i] == mSharedSource->mStreamVBOs[i];
+            if ( mStreamVBOs[i] != 0 && !shared ) {
+                glDeleteBuffers( 1, &mStreamVBOs[i] );
+            }
+        }
+    } else if ( mNumVertices != 0 ) {
         glDeleteBuffers( 1, &mVBO );
     }
-    if ( mNumIndices != 0 ) {
+    if ( mNumIndices != 0 && !mSharedSource ) {
         glDeleteBuffers( 1, &mEBO );
     }
     if ( mVAO != 0 ) {
@@ -237,8 +528,33 @@ VertexBuffer::~VertexBuffer()
     }
 }
 
+void VertexBuffer::computeBounds( const void* vertices )
+{
+    // every vertex format starts with its position
+    const bool is2d = (mType == POS_TEX_COLOR_2D);
+    const uint8_t* bytes = static_cast<const uint8_t*>( vertices );
+    mBounds = Aabb();
+    for ( size_t i=0; i<mNumVertices && bytes != nullptr; ++i ) {
+        const float* pos = reinterpret_cast<const float*>( bytes + i * mVertexStride );
+        mBounds.Add( glm::vec3( pos[0], pos[1], is2d ? 0.0f : pos[2] ));
+    }
+    mBoundingSphere = BoundingSphere( mBounds );
+}
+
 bool VertexBuffer::UpdateVertices( void* vertices, size_t verticesSize )
 {
+    // queued draws read the buffer at Flush, so they would see this data
+    assert( !mDrawQueued );
+    if ( mMultiStream ) {
+        std::cerr << "VertexBuffer::UpdateVertices: multi stream buffer, use UpdateStream" << std::endl;
+        return false;
+    }
+    if ( mVertexRing.buffer != 0 ) {
+        uint8_t* dst = beginRingWrite( mVertexRing );
+        if ( dst == nullptr ) { return false; }
+        memcpy( dst, vertices, verticesSize * mVertexStride );
+        return endRingWrite( mVertexRing, vertices );
+    }
     glBindBuffer( GL_ARRAY_BUFFER, mVBO );
     glBufferSubData(
         GL_ARRAY_BUFFER,
@@ -249,3 +565,221 @@ bool VertexBuffer::UpdateVertices( void* vertices, size_t verticesSize )
     return true;
 }
 
+bool VertexBuffer::UpdateStream( Stream stream, const void* data, size_t verticesSize )
+{
+    assert( !mDrawQueued );
+    if ( !mMultiStream || stream >= NUM_STREAMS || mStreamVBOs[stream] == 0 ) {
+        return false;
+    }
+    if ( mStreamRings[stream].buffer != 0 ) {
+        void* dst = BeginStreamWrite( stream );
+        if ( dst == nullptr ) { return false; }
+        memcpy( dst, data, verticesSize * mStreamStrides[stream] );
+        return endStreamWrite( stream, data );
+    }
+    glBindBuffer( GL_ARRAY_BUFFER, mStreamVBOs[stream] );
+    glBufferSubData(
+        GL_ARRAY_BUFFER,
+        0,
+        verticesSize * mStreamStrides[stream],
+        data
+    );
+    return true;
+}
+
+void* VertexBuffer::BeginStreamWrite( Stream stream )
+{
+    assert( !mDrawQueued );
+    if ( !mMultiStream || stream >= NUM_STREAMS || mStreamRings[stream].buffer == 0 ) {
+        std::cerr << "VertexBuffer::BeginStreamWrite: stream " << (int)stream
+                  << " is not dynamic" << std::endl;
+        return nullptr;
+    }
+    return beginRingWrite( mStreamRings[stream] );
+}
+
+void VertexBuffer::EndStreamWrite( Stream stream )
+{
+    endStreamWrite( stream, nullptr );
+}
+
+bool VertexBuffer::endStreamWrite( Stream stream, const void* data )
+{
+    Ring& ring = mStreamRings[stream];
+    const bool written = endRingWrite( ring, data );
+
+    // point the VAO at the region that was just written
+    glBindVertexArray( mVAO );
+    glBindBuffer( GL_ARRAY_BUFFER, ring.buffer );
+    setStreamAttribs( stream, ring.curRegion * ring.regionSize );
+    glBindVertexArray( 0 );
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    return written;
+}
+
+void VertexBuffer::setStreamAttribs( Stream stream, size_t offset )
+{
+    // attribute locations match the interleaved layouts
+    const GLsizei stride = (GLsizei)mStreamStrides[stream];
+    switch ( stream )
+    {
+    case STREAM_POSITION:
+        glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset ); // aPos
+        glEnableVertexAttribArray( 0 );
+        break;
+    case STREAM_NORMAL:
+        glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset ); // aNormal
+        glEnableVertexAttribArray( 1 );
+        break;
+    case STREAM_TEXCOORD:
+        glVertexAttribPointer( 2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offset ); // aTexCoord
+        glEnableVertexAttribArray( 2 );
+        break;
+    case STREAM_SKIN:
+        glVertexAttribIPointer( 3, 4, GL_UNSIGNED_INT, stride, (void*)offset ); // aBoneIdxs
+        glEnableVertexAttribArray( 3 );
+        glVertexAttribPointer( 4, 4, GL_FLOAT, GL_FALSE, stride, (void*)( offset + 4 * sizeof( uint32_t ))); // aBoneWeights
+        glEnableVertexAttribArray( 4 );
+        break;
+    default:
+        break;
+    }
+}
+
+GLint VertexBuffer::getBaseVertex() const
+{
+    if ( mVertexRing.buffer == 0 ) {
+        return 0;
+    }
+    return (GLint)( mVertexRing.curRegion * mNumVertices );
+}
+
+void VertexBuffer::onDrawn() const
+{
+    const Ring* rings[NUM_STREAMS + 1] = { &mVertexRing };
+    for ( int i=0; i<NUM_STREAMS; ++i ) {
+        rings[i + 1] = &mStreamRings[i];
+    }
+    for ( const Ring* ring : rings )
+    {
+        if ( ring->buffer == 0 ) { continue; }
+        // a newer fence covers everything an older one in the same region did
+        GLsync& fence = ring->fences[ring->curRegion];
+        if ( fence != nullptr ) {
+            glDeleteSync( fence );
+        }
+        fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+    }
+}
+
+void VertexBuffer::createRing( Ring& ring, GLuint buffer, size_t regionSize, const void* data )
+{
+    ring.buffer = buffer;
+    ring.regionSize = regionSize;
+    ring.curRegion = 0;
+    ring.mappedPtr = nullptr;
+    for ( int i=0; i<RING_REGIONS; ++i ) {
+        ring.fences[i] = nullptr;
+    }
+
+    const size_t totalSize = regionSize * RING_REGIONS;
+    if ( GLEW_ARB_buffer_storage )
+    {
+        // map once for the lifetime of the buffer; coherent so writes
+        // are visible to the GPU without explicit flushes
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage( GL_ARRAY_BUFFER, totalSize, nullptr, flags );
+        ring.mappedPtr = (uint8_t*)glMapBufferRange( GL_ARRAY_BUFFER, 0, totalSize, flags );
+        if ( ring.mappedPtr == nullptr ) {
+            std::cerr << "VertexBuffer: failed to persistently map dynamic buffer" << std::endl;
+            exit( EXIT_FAILURE );
+        }
+        for ( int i=0; i<RING_REGIONS && data != nullptr; ++i ) {
+            memcpy( ring.mappedPtr + i * regionSize, data, regionSize );
+        }
+    }
+    else
+    {
+        glBufferData( GL_ARRAY_BUFFER, totalSize, nullptr, GL_DYNAMIC_DRAW );
+        for ( int i=0; i<RING_REGIONS && data != nullptr; ++i ) {
+            glBufferSubData( GL_ARRAY_BUFFER, i * regionSize, regionSize, data );
+        }
+    }
+}
+
+void VertexBuffer::destroyRing( Ring& ring )
+{
+    if ( ring.buffer == 0 ) { return; }
+    for ( int i=0; i<RING_REGIONS; ++i ) {
+        if ( ring.fences[i] != nullptr ) {
+            glDeleteSync( ring.fences[i] );
+        }
+    }
+    // deleting the buffer also unmaps it
+    ring.buffer = 0;
+}
+
+uint8_t* VertexBuffer::beginRingWrite( Ring& ring )
+{
+    // curRegion only moves once the region can be written, so a failed
+    // map leaves draws reading the last complete one
+    const int nextRegion = (ring.curRegion + 1) % RING_REGIONS;
+
+    // wait until the GPU has finished the draws that read this region;
+    // normally already signaled since they were issued 2 frames ago
+    GLsync& fence = ring.fences[nextRegion];
+    if ( fence != nullptr )
+    {
+        const GLuint64 timeoutNs = 1000000; // 1ms
+        GLenum result = glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeoutNs );
+        while ( result == GL_TIMEOUT_EXPIRED ) {
+            result = glClientWaitSync( fence, 0, timeoutNs );
+        }
+        if ( result == GL_WAIT_FAILED ) {
+            std::cerr << "VertexBuffer: glClientWaitSync failed" << std::endl;
+        }
+        glDeleteSync( fence );
+        fence = nullptr;
+    }
+
+    const size_t offset = nextRegion * ring.regionSize;
+    if ( ring.mappedPtr != nullptr ) {
+        ring.curRegion = nextRegion;
+        return ring.mappedPtr + offset;
+    }
+    // the fence wait above already synchronized, so skip the driver's own
+    glBindBuffer( GL_ARRAY_BUFFER, ring.buffer );
+    uint8_t* dst = (uint8_t*)glMapBufferRange(
+        GL_ARRAY_BUFFER,
+        offset,
+        ring.regionSize,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+    );
+    if ( dst == nullptr ) {
+        std::cerr << "VertexBuffer: failed to map dynamic buffer region" << std::endl;
+        glBindBuffer( GL_ARRAY_BUFFER, 0 );
+        return nullptr;
+    }
+    ring.curRegion = nextRegion;
+    return dst;
+}
+
+bool VertexBuffer::endRingWrite( Ring& ring, const void* data )
+{
+    if ( ring.mappedPtr != nullptr ) { return true; }
+    glBindBuffer( GL_ARRAY_BUFFER, ring.buffer );
+    bool written = true;
+    if ( glUnmapBuffer( GL_ARRAY_BUFFER ) == GL_FALSE ) {
+        // the region's contents are undefined; write it again if the
+        // caller still has the data, else drop the write like a failed map
+        std::cerr << "VertexBuffer: dynamic buffer region was lost while mapped" << std::endl;
+        if ( data != nullptr ) {
+            glBufferSubData( GL_ARRAY_BUFFER, ring.curRegion * ring.regionSize, ring.regionSize, data );
+        } else {
+            ring.curRegion = (ring.curRegion + RING_REGIONS - 1) % RING_REGIONS;
+            written = false;
+        }
+    }
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    return written;
+}
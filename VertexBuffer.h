@@ -2,8 +2,11 @@
 #define VERTEX_BUFFER_H_INCLUDED
 
 #include <cstdint>
+#include <memory>
 #include <GL/glew.h>
 
+#include "Bounds.h"
+
 struct VertexColored
 {
     float x,y,z;
@@ -18,6 +21,16 @@ struct VertexTextured
     float u,v;
 };
 
+// for GPU skinning; bind pose vertex plus the bones influencing it
+struct VertexSkinned
+{
+    float x,y,z;
+    float nx,ny,nz;
+    float u,v;
+    uint32_t boneIdx[4];
+    float boneWeight[4];
+};
+
 // for ImGUI,
 // matches struct ImDrawVert
 struct VertexTexCol2d
@@ -38,13 +51,24 @@ public:
         POS_COLOR, // data is in format of VertexColored struct
         POS_TEXCOORD, // data is in format of VertexTextured struct
         POS_TEX_COLOR_2D, // data is in format of VertexTexCol2d struct
+        POS_TEXCOORD_SKINNED, // data is in format of VertexSkinned struct
         UNINITIALIZED
     };
 
     enum Usage
     {
         USAGE_STATIC, // this vertex buffer won't often be updated
-        USAGE_DYNAMIC // this vertex buffer will be updated frequently
+        USAGE_DYNAMIC // this vertex buffer will be updated frequently; triple buffered
+    };
+
+    // Per-attribute buffers for multi stream vertex buffers
+    enum Stream
+    {
+        STREAM_POSITION, // float x,y,z
+        STREAM_NORMAL, // float nx,ny,nz
+        STREAM_TEXCOORD, // float u,v
+        STREAM_SKIN, // uint32_t boneIdx[4], float boneWeight[4]; POS_TEXCOORD_SKINNED only
+        NUM_STREAMS
     };
 
     /**
@@ -66,6 +90,44 @@ public:
         size_t indicesSize,
         Usage usage = USAGE_STATIC
     );
+
+    /**
+     * @brief Create a multi stream buffer; each attribute gets its own
+     *      tightly packed buffer so it can be updated on its own
+     * 
+     * @param type POS_TEXCOORD or POS_TEXCOORD_SKINNED
+     * @param vertices pointer array of VertexTextured/VertexSkinned structs;
+     *      split into one stream per attribute
+     * @param verticesSize the number of structs in vertices
+     * @param indices pointer to indices for the buffer, or null
+     * @param indicesSize size of the indices array (0 if none)
+     * @param streamUsage how often each stream will be updated, indexed by Stream
+     */
+    VertexBuffer(
+        Type type,
+        void* vertices,
+        size_t verticesSize,
+        uint32_t* indices,
+        size_t indicesSize,
+        const Usage streamUsage[NUM_STREAMS]
+    );
+    /**
+     * @brief Create a multi stream buffer that reads the static streams
+     *      and indices of another one, with its own dynamic streams
+     * 
+     * For many copies of one CPU skinned mesh: each gets its own skinned
+     * positions while normals, texcoords and indices are stored once.
+     * 
+     * @param source multi stream buffer to share; kept alive by this one
+     * @param streamUsage USAGE_DYNAMIC streams get their own storage,
+     *      starting out as a copy of the source's data; USAGE_STATIC
+     *      streams read the source's buffer
+     */
+    VertexBuffer(
+        const std::shared_ptr<const VertexBuffer>& source,
+        const Usage streamUsage[NUM_STREAMS]
+    );
+
     ~VertexBuffer();
 
     /**
@@ -75,17 +137,126 @@ public:
      * @param verticesSize the number of VertexColored/VertexTextured structs in vertices.
      *      must be same size as what was given in constructor
      * @return true on success, false on failure
+     *
+     * Draws are queued until Renderer::Flush and read the buffer then, so
+     * update a buffer at most once per frame, before drawing it. The same
+     * goes for UpdateStream and BeginStreamWrite.
      */
     bool UpdateVertices( void* vertices, size_t verticesSize );
 
+    /**
+     * @brief store new data for one attribute of a multi stream buffer
+     * 
+     * @param stream which attribute to update
+     * @param data tightly packed attribute data, e.g. 3 floats per vertex
+     *      for STREAM_POSITION
+     * @param verticesSize the number of vertices in data.
+     *      must be same size as what was given in constructor
+     * @return true on success, false if this isn't a multi stream buffer
+     *      or doesn't have the stream
+     */
+    bool UpdateStream( Stream stream, const void* data, size_t verticesSize );
+
+    /**
+     * @brief get memory to write the next frame's data of a USAGE_DYNAMIC
+     *      stream to directly, instead of copying it in with UpdateStream
+     * 
+     * Waits until the GPU has finished with the ring region being handed
+     * out, which is normally immediate as it was last drawn 2 frames ago.
+     * Must be followed by EndStreamWrite before the buffer is drawn, and
+     * not called again until the frame's draws are flushed.
+     * 
+     * @param stream which attribute to write
+     * @return pointer to room for the stream's tightly packed data for all
+     *      vertices, or nullptr if the stream is not dynamic
+     */
+    void* BeginStreamWrite( Stream stream );
+    // Finish writing a stream; following draws use the new data. If the
+    // driver lost the write, they keep using the previous data
+    void EndStreamWrite( Stream stream );
+
+    bool IsMultiStream() const { return mMultiStream; }
+
+    // Bounds of the vertices given at creation, in model space. Later
+    // updates don't change them; pass the real bounds when drawing
+    // dynamic buffers
+    const Aabb& GetBounds() const { return mBounds; }
+    const BoundingSphere& GetBoundingSphere() const { return mBoundingSphere; }
+
 private:
+
+    // number of regions dynamic buffers cycle through, so the CPU can
+    // write one while the GPU may still be reading the others
+    static const int RING_REGIONS = 3;
+
+    // Triple buffered storage for a dynamic buffer. Mapped persistently
+    // when ARB_buffer_storage is available, otherwise mapped per write.
+    struct Ring
+    {
+        GLuint buffer; // not owned; same as mVBO or an mStreamVBOs entry
+        size_t regionSize; // bytes
+        int curRegion; // region the next draw reads from
+        uint8_t* mappedPtr; // start of the persistent mapping, or null
+        mutable GLsync fences[RING_REGIONS]; // signaled when the GPU is done with a region
+    };
+
     Type mType;
     
     GLuint mVAO, mVBO, mEBO;
+
+    // multi stream buffers; mVBO is unused when mMultiStream is set
+    bool mMultiStream;
+    GLuint mStreamVBOs[NUM_STREAMS];
+    size_t mStreamStrides[NUM_STREAMS]; // size of 1 vertex in each stream in bytes
+
+    // ring state for a dynamic interleaved buffer / dynamic streams;
+    // buffer is 0 when not in use
+    Ring mVertexRing;
+    Ring mStreamRings[NUM_STREAMS];
     
     size_t mNumVertices; // number of vertices in the buffer
     size_t mVertexStride; // size of 1 vertex in bytes
     size_t mNumIndices; // number of indices in the buffer
+
+    Aabb mBounds;
+    BoundingSphere mBoundingSphere;
+
+    // buffer whose static streams and indices this one uses, or null
+    std::shared_ptr<const VertexBuffer> mSharedSource;
+
+    // set by the Renderer from queueing a draw of this buffer until Flush;
+    // updates in between would change what the queued draw reads
+    mutable bool mDrawQueued;
+
+    // Create RING_REGIONS * regionSize bytes of storage for the
+    // currently bound GL_ARRAY_BUFFER, with every region set to data
+    // (left uninitialized if data is null)
+    static void createRing( Ring& ring, GLuint buffer, size_t regionSize, const void* data );
+    static void destroyRing( Ring& ring );
+    // advance to the next region and return a pointer to write it
+    static uint8_t* beginRingWrite( Ring& ring );
+    // unmap the region written since beginRingWrite. If the unmap fails
+    // the region is re-uploaded from data, or without data the write is
+    // dropped and draws go back to the previous region. Returns false
+    // if the write was dropped
+    static bool endRingWrite( Ring& ring, const void* data );
+    // EndStreamWrite, with the data to re-upload if the write is lost
+    bool endStreamWrite( Stream stream, const void* data );
+
+    // set mBounds from interleaved vertices of mType; mNumVertices and
+    // mVertexStride must be set
+    void computeBounds( const void* vertices );
+
+    // point a stream's attributes at the given byte offset in its buffer;
+    // the VAO must be bound
+    void setStreamAttribs( Stream stream, size_t offset );
+
+    // first vertex the next draw reads; non-zero for dynamic interleaved buffers
+    GLint getBaseVertex() const;
+
+    // called by the Renderer after a draw is submitted; fences the ring
+    // regions the draw read so they aren't overwritten too early
+    void onDrawn() const;
 };
 
 #endif
@@ -1,3 +1,21 @@
 #!/bin/bash
 #g++ -std=c++11 TestMain.cpp glad.c Display.cpp Shader.cpp Object.cpp -o TestMain -I./ -lglfw -lGLEW -lGLU -lGL -lstdc++ -ldl
-g++ -std=c++11 main.cpp Renderer.cpp Shader.cpp Mesh.cpp cgltfImpl.cpp -o main -I./ -lSDL2 -lGLEW -lGLU -lGL -lstdc++ -ldl
+g++ -std=c++14 -O2 main.cpp Renderer.cpp Shader.cpp Mesh.cpp Texture.cpp VertexBuffer.cpp AssimpMesh.cpp ModelAsset.cpp AnimationSystem.cpp EntityStore.cpp Frustum.cpp OcclusionCuller.cpp SceneGraph.cpp Skinning.cpp ThreadPool.cpp -o main -I./ -lSDL2 -lGLEW -lGLU -lGL -lassimp -lstdc++ -ldl -pthread
+
+# headless tests; no GL or window needed
+g++ -std=c++14 -O2 tests/FrustumTest.cpp Frustum.cpp -o tests/FrustumTest -I./
+g++ -std=c++14 -O2 tests/OcclusionCullerTest.cpp OcclusionCuller.cpp ThreadPool.cpp -o tests/OcclusionCullerTest -I./ -pthread
+g++ -std=c++14 -O2 tests/SceneGraphTest.cpp SceneGraph.cpp -o tests/SceneGraphTest -I./
+g++ -std=c++14 -O2 tests/SkinningTest.cpp Skinning.cpp -o tests/SkinningTest -I./
+g++ -std=c++14 -O2 tests/SkinningBench.cpp Skinning.cpp -o tests/SkinningBench -I./
+g++ -std=c++14 -O2 tests/ThreadPoolTest.cpp ThreadPool.cpp -o tests/ThreadPoolTest -I./ -pthread
+g++ -std=c++14 -O2 tests/ThreadPoolBench.cpp Skinning.cpp ThreadPool.cpp -o tests/ThreadPoolBench -I./ -pthread
+# links the engine like main for EntityStore::Draw, but never opens a window
+g++ -std=c++14 -O2 tests/EntityStoreBench.cpp Renderer.cpp Shader.cpp Mesh.cpp Texture.cpp VertexBuffer.cpp AssimpMesh.cpp ModelAsset.cpp AnimationSystem.cpp EntityStore.cpp Frustum.cpp OcclusionCuller.cpp SceneGraph.cpp Skinning.cpp ThreadPool.cpp -o tests/EntityStoreBench -I./ -lSDL2 -lGLEW -lGLU -lGL -lassimp -lstdc++ -ldl -pthread
+g++ -std=c++14 -O2 tests/EntityStoreTest.cpp Renderer.cpp Shader.cpp Mesh.cpp Texture.cpp VertexBuffer.cpp AssimpMesh.cpp ModelAsset.cpp AnimationSystem.cpp EntityStore.cpp Frustum.cpp OcclusionCuller.cpp SceneGraph.cpp Skinning.cpp ThreadPool.cpp -o tests/EntityStoreTest -I./ -lSDL2 -lGLEW -lGLU -lGL -lassimp -lstdc++ -ldl -pthread
+# no window; engine sources just to link ModelAsset
+g++ -std=c++14 -O2 tests/AnimSampleBench.cpp ModelAsset.cpp Mesh.cpp Texture.cpp VertexBuffer.cpp SceneGraph.cpp Skinning.cpp -o tests/AnimSampleBench -I./ -lGLEW -lGL -lassimp -pthread
+g++ -std=c++14 -O2 tests/QuatPackTest.cpp ModelAsset.cpp Mesh.cpp Texture.cpp VertexBuffer.cpp SceneGraph.cpp Skinning.cpp -o tests/QuatPackTest -I./ -lGLEW -lGL -lassimp -pthread
+# GL benches; open a window, run from the repo root
+g++ -std=c++14 -O2 tests/UniformBench.cpp Renderer.cpp Shader.cpp Mesh.cpp Texture.cpp VertexBuffer.cpp Frustum.cpp OcclusionCuller.cpp Skinning.cpp ThreadPool.cpp -o tests/UniformBench -I./ -lSDL2 -lGLEW -lGLU -lGL -lstdc++ -ldl -pthread
+g++ -std=c++14 -O2 tests/InstanceBench.cpp Renderer.cpp Shader.cpp Mesh.cpp Texture.cpp VertexBuffer.cpp Frustum.cpp OcclusionCuller.cpp Skinning.cpp ThreadPool.cpp -o tests/InstanceBench -I./ -lSDL2 -lGLEW -lGLU -lGL -lstdc++ -ldl -pthread
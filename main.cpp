@@ -12,6 +12,10 @@
 #include "Shader.h"
 #include "AssimpMesh.h"
 #include "GameTimer.h"
+#include "ThreadPool.h"
+#include "AnimationSystem.h"
+#include "OcclusionCuller.h"
+#include "EntityStore.h"
 
 #ifdef WIN32
 #undef main
@@ -21,6 +25,7 @@ int main()
 {
     Renderer& render = *Renderer::GetInstance();
     render.Init( "SDL2 Window", 640, 480 );
+    ThreadPool::GetInstance()->Init( ThreadPool::GetDefaultNumWorkers() );
     GameTimer gameTimer;
     AssimpMesh asmpMesh( "data/Woman.gltf" );
     Texture asmpTex( "data/Woman.png" );
@@ -28,6 +33,49 @@ int main()
     asmpMesh.SetTexture( &asmpTex, 0 );
     asmpMesh.SetPosition( glm::vec3(0.0f,-1.0f,-3.0f) );
     asmpMesh.SetScale( glm::vec3(0.005f,0.005f,0.005f) );
+    // low wall in front of the character; drawn and used as an occluder
+    AssimpMesh wallMesh( "data/Wall.gltf" );
+    Texture wallTex( "data/wall.jpg" );
+    wallMesh.SetTexture( &wallTex, 0 );
+    wallMesh.SetPosition( glm::vec3(0.9f,-1.0f,-2.0f) );
+    wallMesh.SetScale( glm::vec3(0.6f,0.6f,0.6f) );
+
+    // a crowd and rows of walls behind, as lightweight entities
+    AssimpMesh crowdMesh( "data/Woman.gltf", AssimpMesh::SKINNING_GPU );
+    crowdMesh.SetTexture( &asmpTex, 0 );
+    Aabb crowdBounds;
+    for ( const ModelAsset::Mesh& mesh : crowdMesh.GetAsset()->GetMeshes() ) {
+        crowdBounds.Add( mesh.GetBounds() );
+    }
+    // leave room for the poses to reach past the bind pose
+    const glm::vec3 crowdMargin = crowdBounds.GetExtents() * 0.5f;
+    crowdBounds.min -= crowdMargin;
+    crowdBounds.max += crowdMargin;
+    const ModelAsset::Mesh& wallAssetMesh = wallMesh.GetAsset()->GetMeshes()[0];
+
+    EntityStore entities;
+    const EntityStore::RenderHandle crowdRender = { nullptr, nullptr, &crowdMesh };
+    const EntityStore::RenderHandle wallRender = { &wallAssetMesh.GetVertexBuffer(), &wallTex, nullptr };
+    for ( int row=0; row<8; ++row ) {
+        for ( int col=0; col<8; ++col ) {
+            Transform transform;
+            transform.position = glm::vec3( float(col) * 1.5f - 5.25f, -1.0f, -8.0f - float(row) * 1.5f );
+            transform.scale = glm::vec3( 0.005f, 0.005f, 0.005f );
+            const Entity entity = entities.Create( transform, crowdBounds, crowdRender );
+            entities.SetAnimation( entity, float(row * 8 + col) * 0.37f );
+        }
+    }
+    for ( int col=0; col<6; ++col ) {
+        Transform transform;
+        transform.position = glm::vec3( float(col) * 3.0f - 7.5f, -1.0f, -22.0f );
+        transform.scale = glm::vec3( 1.2f, 1.2f, 1.2f );
+        entities.Create( transform, wallAssetMesh.GetBounds(), wallRender );
+    }
+
+    AnimationSystem& animSystem = *AnimationSystem::GetInstance();
+    animSystem.Add( &asmpMesh );
+    OcclusionCuller occlusionCuller;
+    render.SetOcclusionCuller( &occlusionCuller );
 
     Renderer::DirectionalLight dirLight = {
         glm::vec3(0.0f,-1.0f,-0.25f),
@@ -36,10 +84,40 @@ int main()
     render.SetDirLight( dirLight, 0 );
 
     float modelRot = 0.0f;
+    float statsTime = 0.0f;
     while ( !render.ShouldClose() )
     {
         float dt = gameTimer.Update();
-        asmpMesh.Update( dt );
+        occlusionCuller.BeginFrame( render.GetViewProjMatrix() );
+        wallMesh.AddOccluders( occlusionCuller );
+        occlusionCuller.RasterizeOccluders();
+        animSystem.CullInstances( render.GetViewFrustum(), &occlusionCuller );
+        animSystem.Update( dt );
+        entities.UpdateAnimation( dt );
+        entities.UpdateTransforms();
+        const size_t numEntitiesVisible = entities.Cull( render.GetViewFrustum(), &occlusionCuller );
+
+        // print culling and animation stats once a second
+        statsTime += dt;
+        if ( statsTime >= 1.0f ) {
+            const AnimationSystem::Timings& timings = animSystem.GetTimings();
+            const Renderer::QueueStats& queueStats = render.GetQueueStats();
+            std::cout << "Draws: " << queueStats.numDraws << " drawn, "
+                      << queueStats.numCulled << " culled, "
+                      << queueStats.numOccluded << " occluded" << std::endl;
+            std::cout << "Anim: " << timings.numPosed << " posed, "
+                      << timings.numSkinnedVerts << " verts skinned, "
+                      << timings.numSkippedLod + timings.numSkippedBudget << " skipped, "
+                      << timings.numSkippedHidden << " hidden; "
+                      << "pose " << timings.poseMs << "ms, "
+                      << "map " << timings.mapMs << "ms, "
+                      << "skin " << timings.skinMs << "ms, "
+                      << "upload " << timings.uploadMs << "ms" << std::endl;
+            std::cout << "Entities: " << numEntitiesVisible << " of "
+                      << entities.GetNumEntities() << " visible" << std::endl;
+            statsTime = 0.0f;
+        }
+
         modelRot += dt * 90.0f;
         asmpMesh.SetRotation(
             glm::quat( glm::vec3(0.0f,glm::radians(modelRot),0.0f) )
@@ -47,7 +125,9 @@ int main()
 
         glClearColor( 0.2f, 0.3f, 0.3f, 1.0f );
         render.Clear();
+        wallMesh.Draw();
         asmpMesh.Draw();
+        entities.Draw();
         render.Update();
     }
 
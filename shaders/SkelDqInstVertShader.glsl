@@ -0,0 +1,92 @@
+#version 330 core
+
+// attributes
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in uvec4 aBoneIdxs;
+layout (location = 4) in vec4 aBoneWeights;
+// per instance transform and the texel its palette starts at in uBoneDqs;
+// must match Renderer::INSTANCE_ATTRIB_LOCATION
+layout (location = 5) in mat4 aInstModelMatrix;
+layout (location = 9) in mat4 aInstNormalMatrix;
+layout (location = 13) in uint aInstPaletteOffset;
+
+// varyings to be sent to the fragment shader
+out vec2 vTexCoord;
+out vec3 vFragPos;
+out vec3 vFragNorm;
+
+// must match Renderer MAX_POS_LIGHTS/MAX_DIR_LIGHTS
+#define MAX_POS_LIGHTS 1
+#define MAX_DIR_LIGHTS 1
+
+// camera and lighting, updated at most once per frame;
+// must match Renderer::FrameUniforms
+layout (std140) uniform FrameUniforms
+{
+    mat4 uViewProjMatrix;
+    vec4 uAmbient; // xyz = color
+    vec4 uPosLgtPos[MAX_POS_LIGHTS]; // xyz = position
+    vec4 uPosLgtDff[MAX_POS_LIGHTS]; // xyz = diffuse
+    vec4 uDirLgtDir[MAX_DIR_LIGHTS]; // xyz = direction
+    vec4 uDirLgtDff[MAX_DIR_LIGHTS]; // xyz = diffuse
+};
+
+// bone dual quaternions of every instance in the frame, two texels each:
+// the real (rotation) part, then the dual part. xyz = vector, w = scalar
+uniform samplerBuffer uBoneDqs;
+
+vec4 fetchReal( uint boneIdx )
+{
+    return texelFetch( uBoneDqs, int( aInstPaletteOffset + boneIdx * 2u ) );
+}
+
+vec4 fetchDual( uint boneIdx )
+{
+    return texelFetch( uBoneDqs, int( aInstPaletteOffset + boneIdx * 2u + 1u ) );
+}
+
+// rotate v by unit quaternion q
+vec3 quatRotate( vec4 q, vec3 v )
+{
+    return v + 2.0 * cross( q.xyz, cross( q.xyz, v ) + q.w * v );
+}
+
+void main()
+{
+    vec4 real0 = fetchReal( aBoneIdxs.x );
+    vec4 real1 = fetchReal( aBoneIdxs.y );
+    vec4 real2 = fetchReal( aBoneIdxs.z );
+    vec4 real3 = fetchReal( aBoneIdxs.w );
+
+    // q and -q are the same rotation; blend along the shortest path
+    vec4 weights = aBoneWeights;
+    if ( dot( real0, real1 ) < 0.0 ) { weights.y = -weights.y; }
+    if ( dot( real0, real2 ) < 0.0 ) { weights.z = -weights.z; }
+    if ( dot( real0, real3 ) < 0.0 ) { weights.w = -weights.w; }
+
+    vec4 real =
+        real0 * weights.x + real1 * weights.y +
+        real2 * weights.z + real3 * weights.w;
+    vec4 dual =
+        fetchDual( aBoneIdxs.x ) * weights.x +
+        fetchDual( aBoneIdxs.y ) * weights.y +
+        fetchDual( aBoneIdxs.z ) * weights.z +
+        fetchDual( aBoneIdxs.w ) * weights.w;
+    float invLen = 1.0 / length( real );
+    real *= invLen;
+    dual *= invLen;
+
+    vec3 trans = 2.0 * ( real.w * dual.xyz - dual.w * real.xyz + cross( real.xyz, dual.xyz ) );
+    vec4 skinnedPos = vec4( quatRotate( real, aPos ) + trans, 1.0 );
+    vec3 skinnedNorm = quatRotate( real, aNormal );
+
+    vec4 worldPos = aInstModelMatrix * skinnedPos;
+    gl_Position = uViewProjMatrix * worldPos;
+    vTexCoord = aTexCoord;
+    vFragPos = vec3( worldPos );
+    vFragNorm = normalize(
+        vec3( aInstNormalMatrix * vec4( skinnedNorm, 1.0 ) )
+    );
+}
@@ -0,0 +1,90 @@
+#version 330 core
+
+// must match Renderer::MAX_SKINNING_BONES
+#define MAX_BONES 96
+
+// attributes
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in uvec4 aBoneIdxs;
+layout (location = 4) in vec4 aBoneWeights;
+
+// varyings to be sent to the fragment shader
+out vec2 vTexCoord;
+out vec3 vFragPos;
+out vec3 vFragNorm;
+
+// must match Renderer MAX_POS_LIGHTS/MAX_DIR_LIGHTS
+#define MAX_POS_LIGHTS 1
+#define MAX_DIR_LIGHTS 1
+
+// camera and lighting, updated at most once per frame;
+// must match Renderer::FrameUniforms
+layout (std140) uniform FrameUniforms
+{
+    mat4 uViewProjMatrix;
+    vec4 uAmbient; // xyz = color
+    vec4 uPosLgtPos[MAX_POS_LIGHTS]; // xyz = position
+    vec4 uPosLgtDff[MAX_POS_LIGHTS]; // xyz = diffuse
+    vec4 uDirLgtDir[MAX_DIR_LIGHTS]; // xyz = direction
+    vec4 uDirLgtDff[MAX_DIR_LIGHTS]; // xyz = diffuse
+};
+
+// object transform, updated per draw; must match Renderer::DrawUniforms
+layout (std140) uniform DrawUniforms
+{
+    mat4 uModelMatrix;
+    mat4 uNormalMatrix;
+};
+
+// bone dual quaternions, updated per draw;
+// [2*i] is the real (rotation) part, [2*i+1] the dual part. xyz = vector, w = scalar
+layout (std140) uniform BoneDualQuats
+{
+    vec4 uBoneDqs[MAX_BONES*2];
+};
+
+// rotate v by unit quaternion q
+vec3 quatRotate( vec4 q, vec3 v )
+{
+    return v + 2.0 * cross( q.xyz, cross( q.xyz, v ) + q.w * v );
+}
+
+void main()
+{
+    vec4 real0 = uBoneDqs[aBoneIdxs.x*2u];
+    vec4 real1 = uBoneDqs[aBoneIdxs.y*2u];
+    vec4 real2 = uBoneDqs[aBoneIdxs.z*2u];
+    vec4 real3 = uBoneDqs[aBoneIdxs.w*2u];
+
+    // q and -q are the same rotation; blend along the shortest path
+    vec4 weights = aBoneWeights;
+    if ( dot( real0, real1 ) < 0.0 ) { weights.y = -weights.y; }
+    if ( dot( real0, real2 ) < 0.0 ) { weights.z = -weights.z; }
+    if ( dot( real0, real3 ) < 0.0 ) { weights.w = -weights.w; }
+
+    vec4 real =
+        real0 * weights.x + real1 * weights.y +
+        real2 * weights.z + real3 * weights.w;
+    vec4 dual =
+        uBoneDqs[aBoneIdxs.x*2u+1u] * weights.x +
+        uBoneDqs[aBoneIdxs.y*2u+1u] * weights.y +
+        uBoneDqs[aBoneIdxs.z*2u+1u] * weights.z +
+        uBoneDqs[aBoneIdxs.w*2u+1u] * weights.w;
+    float invLen = 1.0 / length( real );
+    real *= invLen;
+    dual *= invLen;
+
+    vec3 trans = 2.0 * ( real.w * dual.xyz - dual.w * real.xyz + cross( real.xyz, dual.xyz ) );
+    vec4 skinnedPos = vec4( quatRotate( real, aPos ) + trans, 1.0 );
+    vec3 skinnedNorm = quatRotate( real, aNormal );
+
+    vec4 worldPos = uModelMatrix * skinnedPos;
+    gl_Position = uViewProjMatrix * worldPos;
+    vTexCoord = aTexCoord;
+    vFragPos = vec3( worldPos );
+    vFragNorm = normalize(
+        vec3( uNormalMatrix * vec4( skinnedNorm, 1.0 ) )
+    );
+}
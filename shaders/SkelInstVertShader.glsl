@@ -0,0 +1,68 @@
+#version 330 core
+
+// attributes
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in uvec4 aBoneIdxs;
+layout (location = 4) in vec4 aBoneWeights;
+// per instance transform and the texel its palette starts at in uBonePalettes;
+// must match Renderer::INSTANCE_ATTRIB_LOCATION
+layout (location = 5) in mat4 aInstModelMatrix;
+layout (location = 9) in mat4 aInstNormalMatrix;
+layout (location = 13) in uint aInstPaletteOffset;
+
+// varyings to be sent to the fragment shader
+out vec2 vTexCoord;
+out vec3 vFragPos;
+out vec3 vFragNorm;
+
+// must match Renderer MAX_POS_LIGHTS/MAX_DIR_LIGHTS
+#define MAX_POS_LIGHTS 1
+#define MAX_DIR_LIGHTS 1
+
+// camera and lighting, updated at most once per frame;
+// must match Renderer::FrameUniforms
+layout (std140) uniform FrameUniforms
+{
+    mat4 uViewProjMatrix;
+    vec4 uAmbient; // xyz = color
+    vec4 uPosLgtPos[MAX_POS_LIGHTS]; // xyz = position
+    vec4 uPosLgtDff[MAX_POS_LIGHTS]; // xyz = diffuse
+    vec4 uDirLgtDir[MAX_DIR_LIGHTS]; // xyz = direction
+    vec4 uDirLgtDff[MAX_DIR_LIGHTS]; // xyz = diffuse
+};
+
+// skinning matrices of every instance in the frame, one texel per column
+uniform samplerBuffer uBonePalettes;
+
+mat4 fetchBone( uint boneIdx )
+{
+    int texel = int( aInstPaletteOffset + boneIdx * 4u );
+    return mat4(
+        texelFetch( uBonePalettes, texel ),
+        texelFetch( uBonePalettes, texel + 1 ),
+        texelFetch( uBonePalettes, texel + 2 ),
+        texelFetch( uBonePalettes, texel + 3 )
+    );
+}
+
+void main()
+{
+    // blend the bone matrices first, then transform once
+    mat4 skinMat =
+        fetchBone( aBoneIdxs.x ) * aBoneWeights.x +
+        fetchBone( aBoneIdxs.y ) * aBoneWeights.y +
+        fetchBone( aBoneIdxs.z ) * aBoneWeights.z +
+        fetchBone( aBoneIdxs.w ) * aBoneWeights.w;
+    vec4 skinnedPos = skinMat * vec4( aPos, 1.0 );
+    vec3 skinnedNorm = mat3( skinMat ) * aNormal;
+
+    vec4 worldPos = aInstModelMatrix * skinnedPos;
+    gl_Position = uViewProjMatrix * worldPos;
+    vTexCoord = aTexCoord;
+    vFragPos = vec3( worldPos );
+    vFragNorm = normalize(
+        vec3( aInstNormalMatrix * vec4( skinnedNorm, 1.0 ) )
+    );
+}
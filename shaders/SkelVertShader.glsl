@@ -1,12 +1,65 @@
 #version 330 core
 
+// must match Renderer::MAX_SKINNING_BONES
+#define MAX_BONES 96
+
+// attributes
 layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in uvec4 aBoneIdxs;
+layout (location = 4) in vec4 aBoneWeights;
+
+// varyings to be sent to the fragment shader
+out vec2 vTexCoord;
+out vec3 vFragPos;
+out vec3 vFragNorm;
+
+// must match Renderer MAX_POS_LIGHTS/MAX_DIR_LIGHTS
+#define MAX_POS_LIGHTS 1
+#define MAX_DIR_LIGHTS 1
+
+// camera and lighting, updated at most once per frame;
+// must match Renderer::FrameUniforms
+layout (std140) uniform FrameUniforms
+{
+    mat4 uViewProjMatrix;
+    vec4 uAmbient; // xyz = color
+    vec4 uPosLgtPos[MAX_POS_LIGHTS]; // xyz = position
+    vec4 uPosLgtDff[MAX_POS_LIGHTS]; // xyz = diffuse
+    vec4 uDirLgtDir[MAX_DIR_LIGHTS]; // xyz = direction
+    vec4 uDirLgtDff[MAX_DIR_LIGHTS]; // xyz = diffuse
+};
 
-// the transformation matrix
-uniform mat4 transform;
+// object transform, updated per draw; must match Renderer::DrawUniforms
+layout (std140) uniform DrawUniforms
+{
+    mat4 uModelMatrix;
+    mat4 uNormalMatrix;
+};
+
+// skinning matrices (current pose * inverse bind pose), updated per draw
+layout (std140) uniform BonePalette
+{
+    mat4 uBones[MAX_BONES];
+};
 
 void main()
 {
-    gl_Position = transform * vec4(aPos.xyz, 1.0);
-}
+    // blend the bone matrices first, then transform once
+    mat4 skinMat =
+        uBones[aBoneIdxs.x] * aBoneWeights.x +
+        uBones[aBoneIdxs.y] * aBoneWeights.y +
+        uBones[aBoneIdxs.z] * aBoneWeights.z +
+        uBones[aBoneIdxs.w] * aBoneWeights.w;
+    vec4 skinnedPos = skinMat * vec4( aPos, 1.0 );
+    vec3 skinnedNorm = mat3( skinMat ) * aNormal;
 
+    vec4 worldPos = uModelMatrix * skinnedPos;
+    gl_Position = uViewProjMatrix * worldPos;
+    vTexCoord = aTexCoord;
+    vFragPos = vec3( worldPos );
+    vFragNorm = normalize(
+        vec3( uNormalMatrix * vec4( skinnedNorm, 1.0 ) )
+    );
+}
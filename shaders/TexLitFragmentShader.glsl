@@ -5,11 +5,22 @@ out vec4 FragColor;
 
 // uniforms
 uniform sampler2D uTexture0;
-uniform vec3 uAmbient;
-uniform vec3 uPosLgtPos0; // position
-uniform vec3 uPosLgtDff0; // diffuse
-uniform vec3 uDirLgtDir0;
-uniform vec3 uDirLgtDff0;
+
+// must match Renderer MAX_POS_LIGHTS/MAX_DIR_LIGHTS
+#define MAX_POS_LIGHTS 1
+#define MAX_DIR_LIGHTS 1
+
+// camera and lighting, updated at most once per frame;
+// must match Renderer::FrameUniforms
+layout (std140) uniform FrameUniforms
+{
+    mat4 uViewProjMatrix;
+    vec4 uAmbient; // xyz = color
+    vec4 uPosLgtPos[MAX_POS_LIGHTS]; // xyz = position
+    vec4 uPosLgtDff[MAX_POS_LIGHTS]; // xyz = diffuse
+    vec4 uDirLgtDir[MAX_DIR_LIGHTS]; // xyz = direction
+    vec4 uDirLgtDff[MAX_DIR_LIGHTS]; // xyz = diffuse
+};
 
 // varyings from the vertex shader
 in vec2 vTexCoord;
@@ -20,10 +31,10 @@ in vec3 vFragNorm;
 vec3 calcPosLgt()
 {
     vec3 norm = normalize( vFragNorm );
-    vec3 lightDir = normalize( uPosLgtPos0 - vFragPos );
+    vec3 lightDir = normalize( uPosLgtPos[0].xyz - vFragPos );
     float nDotL = max( dot( lightDir, norm ), 0.0 );
     vec3 diffuse =
-        uPosLgtDff0 *
+        uPosLgtDff[0].xyz *
         texture( uTexture0, vTexCoord ).rgb *
         nDotL;
     return diffuse;
@@ -33,10 +44,10 @@ vec3 calcPosLgt()
 vec3 calcDirLgt()
 {
     vec3 norm = normalize( vFragNorm );
-    vec3 lightDir = normalize( -uDirLgtDir0 );
+    vec3 lightDir = normalize( -uDirLgtDir[0].xyz );
     float nDotL = max( dot( lightDir, norm ), 0.0 );
     vec3 diffuse = 
-        uDirLgtDff0 *
+        uDirLgtDff[0].xyz *
         texture( uTexture0, vTexCoord ).rgb *
         nDotL;
     return diffuse;
@@ -45,7 +56,7 @@ vec3 calcDirLgt()
 // calculate ambient lighting contribution
 vec3 calcAmbLgt()
 {
-    return uAmbient * texture( uTexture0, vTexCoord ).rgb;
+    return uAmbient.xyz * texture( uTexture0, vTexCoord ).rgb;
 }
 
 void main()
@@ -0,0 +1,42 @@
+#version 330 core
+
+// attributes
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+// per instance transform, one matrix column per location;
+// must match Renderer::INSTANCE_ATTRIB_LOCATION
+layout (location = 5) in mat4 aInstModelMatrix;
+layout (location = 9) in mat4 aInstNormalMatrix;
+
+// varyings to be sent to the fragment shader
+out vec2 vTexCoord;
+out vec3 vFragPos;
+out vec3 vFragNorm;
+
+// must match Renderer MAX_POS_LIGHTS/MAX_DIR_LIGHTS
+#define MAX_POS_LIGHTS 1
+#define MAX_DIR_LIGHTS 1
+
+// camera and lighting, updated at most once per frame;
+// must match Renderer::FrameUniforms
+layout (std140) uniform FrameUniforms
+{
+    mat4 uViewProjMatrix;
+    vec4 uAmbient; // xyz = color
+    vec4 uPosLgtPos[MAX_POS_LIGHTS]; // xyz = position
+    vec4 uPosLgtDff[MAX_POS_LIGHTS]; // xyz = diffuse
+    vec4 uDirLgtDir[MAX_DIR_LIGHTS]; // xyz = direction
+    vec4 uDirLgtDff[MAX_DIR_LIGHTS]; // xyz = diffuse
+};
+
+void main()
+{
+    vec4 worldPos = aInstModelMatrix * vec4( aPos, 1.0 );
+    gl_Position = uViewProjMatrix * worldPos;
+    vTexCoord = aTexCoord;
+    vFragPos = vec3( worldPos );
+    vFragNorm = normalize(
+        vec3( aInstNormalMatrix * vec4( aNormal, 1.0 ) )
+    );
+}
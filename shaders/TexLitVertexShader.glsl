@@ -10,16 +10,35 @@ out vec2 vTexCoord;
 out vec3 vFragPos;
 out vec3 vFragNorm;
 
-// uniforms
-uniform mat4 uMvpMatrix;
-uniform mat4 uModelMatrix;
-uniform mat4 uNormalMatrix;
+// must match Renderer MAX_POS_LIGHTS/MAX_DIR_LIGHTS
+#define MAX_POS_LIGHTS 1
+#define MAX_DIR_LIGHTS 1
+
+// camera and lighting, updated at most once per frame;
+// must match Renderer::FrameUniforms
+layout (std140) uniform FrameUniforms
+{
+    mat4 uViewProjMatrix;
+    vec4 uAmbient; // xyz = color
+    vec4 uPosLgtPos[MAX_POS_LIGHTS]; // xyz = position
+    vec4 uPosLgtDff[MAX_POS_LIGHTS]; // xyz = diffuse
+    vec4 uDirLgtDir[MAX_DIR_LIGHTS]; // xyz = direction
+    vec4 uDirLgtDff[MAX_DIR_LIGHTS]; // xyz = diffuse
+};
+
+// object transform, updated per draw; must match Renderer::DrawUniforms
+layout (std140) uniform DrawUniforms
+{
+    mat4 uModelMatrix;
+    mat4 uNormalMatrix;
+};
 
 void main()
 {
-    gl_Position = uMvpMatrix * vec4( aPos, 1.0 );
+    vec4 worldPos = uModelMatrix * vec4( aPos, 1.0 );
+    gl_Position = uViewProjMatrix * worldPos;
     vTexCoord = aTexCoord;
-    vFragPos = vec3( uModelMatrix * vec4( aPos, 1.0 ) );
+    vFragPos = vec3( worldPos );
     vFragNorm = normalize(
         vec3( uNormalMatrix * vec4( aNormal, 1.0 ) )
     );
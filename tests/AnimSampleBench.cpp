@@ -0,0 +1,196 @@
+// Pose sampling of the compressed per-channel keys against the original
+// layout: one Transform per bone per 24 fps frame, [bone][frame], lerped
+// and multiplied out bone by bone. Reads the file with assimp only; never
+// opens a window or touches GL
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "ModelAsset.h"
+#include "Transform.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const char* MODEL_FILE = "data/Woman.gltf";
+static const float FRAME_DURATION = 1.0f / 24.0f;
+static const float DT = 1.0f / 60.0f;
+static const int NUM_SAMPLES = 2000;
+static const int NUM_RUNS = 20;
+
+// the original Animation: every bone keyed at every frame
+struct AosAnimation
+{
+    std::vector<std::vector<Transform>> tracks; // [bone][frame]
+    size_t numFrames;
+    float duration;
+
+    void GetGlobalPoseAtTime(
+        std::vector<glm::mat4>& outPoses,
+        const ModelAsset::Skeleton* skeleton,
+        const float time ) const
+    {
+        const std::vector<ModelAsset::Skeleton::Bone>& bones = skeleton->GetBones();
+        outPoses.resize( tracks.size() );
+        const size_t frame = static_cast<size_t>( time / FRAME_DURATION );
+        const float pct = time / FRAME_DURATION - frame;
+        for ( size_t bone=0; bone<tracks.size(); ++bone ) {
+            const Transform interp = Lerp( tracks[bone][frame], tracks[bone][frame+1], pct );
+            const glm::mat4 localMat =
+                glm::translate( glm::mat4( 1.0f ), interp.position ) *
+                glm::mat4_cast( interp.rotation ) *
+                glm::scale( glm::mat4( 1.0f ), interp.scale );
+            const int parent = bones[bone].mParent;
+            outPoses[bone] = parent >= 0 ? outPoses[parent] * localMat : localMat;
+        }
+    }
+};
+
+// index of the last key at or before ticks, and the fraction to the next
+template<typename Key>
+static size_t findKey( const Key* keys, const size_t numKeys, const double ticks, float& pct )
+{
+    size_t i = 0;
+    while ( i+1 < numKeys && keys[i+1].mTime <= ticks ) { ++i; }
+    pct = 0.0f;
+    if ( i+1 < numKeys ) {
+        pct = float( (ticks - keys[i].mTime) / (keys[i+1].mTime - keys[i].mTime) );
+    }
+    return i;
+}
+
+static glm::vec3 sampleVec3( const aiVectorKey* keys, const size_t numKeys, const double ticks )
+{
+    float pct;
+    const size_t i = findKey( keys, numKeys, ticks, pct );
+    const aiVector3D& a = keys[i].mValue;
+    const aiVector3D& b = keys[std::min( i+1, numKeys-1 )].mValue;
+    return glm::mix( glm::vec3( a.x, a.y, a.z ), glm::vec3( b.x, b.y, b.z ), pct );
+}
+
+static glm::quat sampleQuat( const aiQuatKey* keys, const size_t numKeys, const double ticks )
+{
+    float pct;
+    const size_t i = findKey( keys, numKeys, ticks, pct );
+    const aiQuaternion& a = keys[i].mValue;
+    const aiQuaternion& b = keys[std::min( i+1, numKeys-1 )].mValue;
+    return glm::slerp( glm::quat( a.w, a.x, a.y, a.z ), glm::quat( b.w, b.x, b.y, b.z ), pct );
+}
+
+// resample every channel at 24 fps, as the original loader expected the
+// file to be keyed
+static void loadAos( AosAnimation& out, const aiAnimation* assimpAnim, const ModelAsset::Skeleton& skeleton )
+{
+    // same default rate as ModelAsset, so both sample the same times
+    const double ticksPerSecond = assimpAnim->mTicksPerSecond > 0.0 ? assimpAnim->mTicksPerSecond : 24.0;
+    out.duration = float( assimpAnim->mDuration / ticksPerSecond );
+    out.numFrames = size_t( std::ceil( out.duration / FRAME_DURATION )) + 1;
+    out.tracks.assign( skeleton.GetNumBones(), std::vector<Transform>( out.numFrames ));
+    for ( size_t i=0; i<assimpAnim->mNumChannels; ++i ) {
+        const aiNodeAnim* channel = assimpAnim->mChannels[i];
+        const int bone = skeleton.FindBone( std::string( channel->mNodeName.C_Str() ));
+        if ( bone < 0 ) { continue; }
+        for ( size_t frame=0; frame<out.numFrames; ++frame ) {
+            const double ticks = frame * FRAME_DURATION * ticksPerSecond;
+            Transform& key = out.tracks[bone][frame];
+            key.position = sampleVec3( channel->mPositionKeys, channel->mNumPositionKeys, ticks );
+            key.rotation = sampleQuat( channel->mRotationKeys, channel->mNumRotationKeys, ticks );
+            key.scale = sampleVec3( channel->mScalingKeys, channel->mNumScalingKeys, ticks );
+        }
+    }
+}
+
+int main()
+{
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile( MODEL_FILE, aiProcess_Triangulate );
+    if ( !scene || !scene->mRootNode || scene->mNumAnimations == 0 ) {
+        std::fprintf( stderr, "failed to load an animation from %s\n", MODEL_FILE );
+        return EXIT_FAILURE;
+    }
+    const aiMesh* skinnedMesh = nullptr;
+    for ( size_t i=0; i<scene->mNumMeshes && !skinnedMesh; ++i ) {
+        if ( scene->mMeshes[i]->mNumBones > 0 ) { skinnedMesh = scene->mMeshes[i]; }
+    }
+    if ( !skinnedMesh ) {
+        std::fprintf( stderr, "%s has no skinned mesh\n", MODEL_FILE );
+        return EXIT_FAILURE;
+    }
+
+    ModelAsset::Skeleton skeleton;
+    ModelAsset::Animation anim;
+    AosAnimation aosAnim;
+    if ( !skeleton.Load( skinnedMesh, scene ) ||
+            !anim.Load( scene->mAnimations[0], scene, &skeleton, ModelAsset::AnimCompression() )) {
+        std::fprintf( stderr, "failed to process the animation of %s\n", MODEL_FILE );
+        return EXIT_FAILURE;
+    }
+    loadAos( aosAnim, scene->mAnimations[0], skeleton );
+
+    // sequential playback at 60 Hz, wrapped inside the range both can sample
+    const float length = std::min( anim.GetDuration(), float( aosAnim.numFrames - 1 ) * FRAME_DURATION );
+    std::vector<float> times( NUM_SAMPLES );
+    for ( int i=0; i<NUM_SAMPLES; ++i ) {
+        times[i] = std::fmod( float( i ) * DT, length * 0.999f );
+    }
+
+    std::vector<glm::mat4> aosPoses, poses, searchPoses;
+    ModelAsset::Animation::Cursor cursor;
+    float maxDiff = 0.0f, maxCursorDiff = 0.0f;
+    for ( int i=0; i<NUM_SAMPLES; ++i ) {
+        aosAnim.GetGlobalPoseAtTime( aosPoses, &skeleton, times[i] );
+        anim.GetGlobalPoseAtTime( poses, &skeleton, times[i], &cursor );
+        anim.GetGlobalPoseAtTime( searchPoses, &skeleton, times[i] );
+        for ( size_t bone=0; bone<poses.size(); ++bone ) {
+            for ( int c=0; c<4; ++c ) {
+                for ( int r=0; r<4; ++r ) {
+                    maxDiff = std::max( maxDiff, std::fabs( poses[bone][c][r] - aosPoses[bone][c][r] ));
+                    maxCursorDiff = std::max( maxCursorDiff, std::fabs( poses[bone][c][r] - searchPoses[bone][c][r] ));
+                }
+            }
+        }
+    }
+
+    float bestAos = 1e30f, bestCursor = 1e30f, bestSearch = 1e30f;
+    for ( int run=0; run<NUM_RUNS; ++run )
+    {
+        Clock::time_point start = Clock::now();
+        for ( int i=0; i<NUM_SAMPLES; ++i ) {
+            aosAnim.GetGlobalPoseAtTime( aosPoses, &skeleton, times[i] );
+        }
+        bestAos = std::min( bestAos, std::chrono::duration<float, std::micro>( Clock::now() - start ).count() );
+
+        start = Clock::now();
+        for ( int i=0; i<NUM_SAMPLES; ++i ) {
+            anim.GetGlobalPoseAtTime( poses, &skeleton, times[i], &cursor );
+        }
+        bestCursor = std::min( bestCursor, std::chrono::duration<float, std::micro>( Clock::now() - start ).count() );
+
+        start = Clock::now();
+        for ( int i=0; i<NUM_SAMPLES; ++i ) {
+            anim.GetGlobalPoseAtTime( poses, &skeleton, times[i] );
+        }
+        bestSearch = std::min( bestSearch, std::chrono::duration<float, std::micro>( Clock::now() - start ).count() );
+    }
+
+    const float n = float( NUM_SAMPLES );
+    std::printf( "%s: %zu bones, %.2f s, %zu AoS frames, %zu compressed keys\n",
+        MODEL_FILE, skeleton.GetNumBones(), anim.GetDuration(), aosAnim.numFrames, anim.GetNumKeys() );
+    std::printf( "max pose difference %g from AoS, %g cursor from search\n", maxDiff, maxCursorDiff );
+    std::printf( "path              us/pose   speedup, best of %d runs of %d poses\n", NUM_RUNS, NUM_SAMPLES );
+    std::printf( "AoS frames      %9.3f\n", bestAos / n );
+    std::printf( "keys, cursor    %9.3f %8.2fx\n", bestCursor / n, bestAos / bestCursor );
+    std::printf( "keys, search    %9.3f %8.2fx\n", bestSearch / n, bestAos / bestSearch );
+    return EXIT_SUCCESS;
+}
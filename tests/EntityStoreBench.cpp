@@ -0,0 +1,165 @@
+// EntityStore's transform, cull and animation systems over 10k entities,
+// compared with the same work on one heap object per instance laid out
+// like AssimpMesh. Never opens a window or touches GL
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "EntityStore.h"
+#include "Frustum.h"
+#include "Transform.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const size_t NUM_ENTITIES = 10000;
+static const size_t GRID_WIDTH = 100;
+static const int NUM_FRAMES = 200;
+static const float DT = 1.0f / 60.0f;
+static const size_t NUM_PALETTE_BONES = 64;
+
+// transform, animation state and render data side by side, each instance
+// its own allocation, as AssimpMesh keeps them
+struct ObjectInstance
+{
+    std::vector<glm::mat4> palette; // per instance render data, like AssimpMesh's
+    std::vector<const Texture*> textures;
+    const VertexBuffer* vertBuf;
+    Aabb localBounds;
+    Transform transform;
+    glm::mat4 modelMat;
+    BoundingSphere worldSphere;
+    float animTime;
+    float animPlayRate;
+    float animLength;
+    bool transformDirty;
+    bool visible;
+
+    void UpdateTransform() {
+        if ( !transformDirty ) { return; }
+        modelMat = transform.ToMat4();
+        worldSphere = BoundingSphere( localBounds ).Transformed( modelMat );
+        transformDirty = false;
+    }
+    void UpdateAnimation( const float dt ) {
+        animTime += dt * animPlayRate;
+        if ( animTime >= animLength ) { animTime -= animLength; }
+    }
+};
+
+static float msSince( const Clock::time_point& start )
+{
+    return std::chrono::duration<float, std::milli>( Clock::now() - start ).count();
+}
+
+static glm::vec3 gridPosition( const size_t i, const float frame )
+{
+    return glm::vec3(
+        float( i % GRID_WIDTH ) * 2.0f - float( GRID_WIDTH ) + frame * 0.01f,
+        0.0f,
+        -float( i / GRID_WIDTH ) * 2.0f
+    );
+}
+
+int main()
+{
+    // half the grid is in view
+    const Frustum frustum( glm::perspective( glm::radians( 60.0f ), 1.0f, 0.1f, 500.0f ));
+    Aabb localBounds;
+    localBounds.Add( glm::vec3( -0.5f, 0.0f, -0.5f ));
+    localBounds.Add( glm::vec3( 0.5f, 2.0f, 0.5f ));
+
+    std::vector<std::unique_ptr<ObjectInstance>> objects;
+    for ( size_t i=0; i<NUM_ENTITIES; ++i ) {
+        std::unique_ptr<ObjectInstance> obj( new ObjectInstance() );
+        obj->palette.assign( NUM_PALETTE_BONES, glm::mat4( 1.0f ));
+        obj->textures.assign( 1, nullptr );
+        obj->vertBuf = nullptr;
+        obj->localBounds = localBounds;
+        obj->transform.position = gridPosition( i, 0.0f );
+        obj->animTime = float( i % 17 ) * 0.1f;
+        obj->animPlayRate = 1.0f;
+        obj->animLength = 2.0f;
+        obj->transformDirty = true;
+        obj->visible = true;
+        objects.push_back( std::move( obj ));
+    }
+
+    EntityStore store;
+    std::vector<Entity> entities;
+    const EntityStore::RenderHandle noRender = { nullptr, nullptr, nullptr };
+    for ( size_t i=0; i<NUM_ENTITIES; ++i ) {
+        Transform transform;
+        transform.position = gridPosition( i, 0.0f );
+        entities.push_back( store.Create( transform, localBounds, noRender ));
+        store.SetAnimation( entities.back(), float( i % 17 ) * 0.1f );
+    }
+
+    // objects are culled with the store's primitive too, so the cull
+    // times differ only by the gather from and scatter to each object
+    std::vector<glm::vec4> objSpheres( NUM_ENTITIES );
+    std::vector<uint8_t> objVisibleFlags( NUM_ENTITIES );
+
+    // every instance moves every frame
+    float objMoveMs = 0.0f, objTransformMs = 0.0f, objCullMs = 0.0f, objAnimMs = 0.0f;
+    float storeMoveMs = 0.0f, storeTransformMs = 0.0f, storeCullMs = 0.0f, storeAnimMs = 0.0f;
+    size_t objVisible = 0, storeVisible = 0;
+    for ( int frame=1; frame<=NUM_FRAMES; ++frame )
+    {
+        Clock::time_point start = Clock::now();
+        for ( size_t i=0; i<objects.size(); ++i ) {
+            objects[i]->transform.position = gridPosition( i, float( frame ));
+            objects[i]->transformDirty = true;
+        }
+        objMoveMs += msSince( start );
+        start = Clock::now();
+        for ( std::unique_ptr<ObjectInstance>& obj : objects ) {
+            obj->UpdateTransform();
+        }
+        objTransformMs += msSince( start );
+        start = Clock::now();
+        for ( size_t i=0; i<objects.size(); ++i ) {
+            const BoundingSphere& sphere = objects[i]->worldSphere;
+            objSpheres[i] = glm::vec4( sphere.center, sphere.radius );
+        }
+        objVisible = frustum.CullSpheres( objSpheres.data(), objSpheres.size(), objVisibleFlags.data() );
+        for ( size_t i=0; i<objects.size(); ++i ) {
+            objects[i]->visible = objVisibleFlags[i] != 0;
+        }
+        objCullMs += msSince( start );
+        start = Clock::now();
+        for ( std::unique_ptr<ObjectInstance>& obj : objects ) {
+            obj->UpdateAnimation( DT );
+        }
+        objAnimMs += msSince( start );
+
+        start = Clock::now();
+        for ( size_t i=0; i<entities.size(); ++i ) {
+            store.SetPosition( entities[i], gridPosition( i, float( frame )));
+        }
+        storeMoveMs += msSince( start );
+        start = Clock::now();
+        store.UpdateTransforms();
+        storeTransformMs += msSince( start );
+        start = Clock::now();
+        storeVisible = store.Cull( frustum );
+        storeCullMs += msSince( start );
+        start = Clock::now();
+        store.UpdateAnimation( DT );
+        storeAnimMs += msSince( start );
+    }
+
+    const float n = float( NUM_FRAMES );
+    std::printf( "%zu entities, %zu visible (objects %zu), mean of %d frames, one thread\n",
+        NUM_ENTITIES, storeVisible, objVisible, NUM_FRAMES );
+    std::printf( "system        objects ms   store ms   speedup\n" );
+    std::printf( "move          %10.3f %10.3f %8.2fx\n", objMoveMs / n, storeMoveMs / n, objMoveMs / storeMoveMs );
+    std::printf( "transforms    %10.3f %10.3f %8.2fx\n", objTransformMs / n, storeTransformMs / n, objTransformMs / storeTransformMs );
+    std::printf( "cull          %10.3f %10.3f %8.2fx\n", objCullMs / n, storeCullMs / n, objCullMs / storeCullMs );
+    std::printf( "animation     %10.3f %10.3f %8.2fx\n", objAnimMs / n, storeAnimMs / n, objAnimMs / storeAnimMs );
+    return 0;
+}
@@ -0,0 +1,86 @@
+// Checks EntityStore rejects stale handles: destroyed entities, and
+// handles whose slot was reused by a newer entity. Never touches GL
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "EntityStore.h"
+#include "Transform.h"
+
+static int sNumFailed = 0;
+
+static void check( const bool ok, const char* what )
+{
+    std::printf( "%s: %s\n", ok ? "PASS" : "FAIL", what );
+    if ( !ok ) { ++sNumFailed; }
+}
+
+static Transform at( const float x )
+{
+    Transform transform;
+    transform.position = glm::vec3( x, 0.0f, 0.0f );
+    return transform;
+}
+
+int main()
+{
+    Aabb localBounds;
+    localBounds.min = glm::vec3( -0.5f );
+    localBounds.max = glm::vec3( 0.5f );
+    const EntityStore::RenderHandle noRender = { nullptr, nullptr, nullptr };
+
+    EntityStore store;
+    check( !store.IsAlive( EntityStore::INVALID_ENTITY ), "INVALID_ENTITY is never alive" );
+
+    std::vector<Entity> entities;
+    for ( int i=0; i<4; ++i ) {
+        entities.push_back( store.Create( at( float( i )), localBounds, noRender ));
+    }
+    const Entity first = entities[0];
+    const Entity last = entities[3];
+    check( store.IsAlive( first ) && store.IsAlive( last ), "new entities are alive" );
+
+    // destroying the first moves the last into its place in the arrays;
+    // the last's handle must still find it
+    store.Destroy( first );
+    check( !store.IsAlive( first ), "destroyed handle is not alive" );
+    check( store.GetNumEntities() == 3, "destroy removes one entity" );
+    check( store.IsAlive( last ) && store.GetTransform( last ).position.x == 3.0f,
+        "handle of the entity moved into the hole still finds it" );
+
+    // setters through the stale handle are ignored and leave the others be
+    store.SetPosition( first, glm::vec3( 100.0f ));
+    store.SetTransform( first, at( 200.0f ));
+    store.SetAnimation( first, 1.0f );
+    bool othersUnchanged = true;
+    for ( size_t i=1; i<entities.size(); ++i ) {
+        othersUnchanged = othersUnchanged && store.GetTransform( entities[i] ).position.x == float( i );
+    }
+    check( othersUnchanged, "setters through a destroyed handle change nothing" );
+    check( store.GetTransform( first ).position == Transform().position, "destroyed handle reads a default transform" );
+    check( !store.IsVisible( first ), "destroyed handle is not visible" );
+    store.Destroy( first );
+    check( store.GetNumEntities() == 3, "destroying twice is a no-op" );
+
+    // the next entity reuses the freed slot with a new generation
+    const Entity reused = store.Create( at( 7.0f ), localBounds, noRender );
+    check( reused.index == first.index && reused.generation != first.generation,
+        "freed slot is reused with a new generation" );
+    check( store.IsAlive( reused ) && !store.IsAlive( first ), "old handle to a reused slot is rejected" );
+    store.SetPosition( first, glm::vec3( 100.0f ));
+    store.Destroy( first );
+    check( store.IsAlive( reused ) && store.GetTransform( reused ).position.x == 7.0f,
+        "old handle can't move or destroy the slot's new entity" );
+    store.SetPosition( reused, glm::vec3( 8.0f ));
+    check( store.GetTransform( reused ).position.x == 8.0f, "new handle to a reused slot works" );
+
+    // a handle from the future, or past the end of the slots
+    const Entity future = { reused.index, reused.generation + 1 };
+    const Entity outOfRange = { 1000, 0 };
+    check( !store.IsAlive( future ) && !store.IsAlive( outOfRange ), "forged handles are rejected" );
+
+    std::printf( "%d failed\n", sNumFailed );
+    return sNumFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,90 @@
+// Checks Frustum::CullSpheres, SSE where available, gives the same answer
+// as scalar Frustum::IsVisible for every sphere
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Frustum.h"
+
+static const size_t NUM_SPHERES = 100003; // not a multiple of 4, so the scalar tail runs too
+
+static int sNumFailed = 0;
+
+static void check( const bool ok, const char* what )
+{
+    std::printf( "%s: %s\n", ok ? "PASS" : "FAIL", what );
+    if ( !ok ) { ++sNumFailed; }
+}
+
+// spheres where CullSpheres and IsVisible disagree
+static size_t countMismatches( const Frustum& frustum, const std::vector<glm::vec4>& spheres, size_t& outNumVisible )
+{
+    std::vector<uint8_t> visible( spheres.size(), 0xFF );
+    outNumVisible = frustum.CullSpheres( spheres.data(), spheres.size(), visible.data() );
+    size_t mismatches = 0;
+    size_t numSet = 0;
+    for ( size_t i=0; i<spheres.size(); ++i ) {
+        const bool expected = frustum.IsVisible( BoundingSphere( glm::vec3( spheres[i] ), spheres[i].w ));
+        if ( visible[i] != (expected ? 1 : 0) ) { ++mismatches; }
+        numSet += visible[i] == 1 ? 1 : 0;
+    }
+    // the returned count must agree with the flags
+    if ( numSet != outNumVisible ) { ++mismatches; }
+    return mismatches;
+}
+
+int main()
+{
+    const glm::mat4 proj = glm::perspective( glm::radians( 60.0f ), 16.0f / 9.0f, 0.1f, 100.0f );
+    const glm::mat4 view = glm::lookAt( glm::vec3( 5.0f, 2.0f, 10.0f ), glm::vec3( 0.0f ), glm::vec3( 0.0f, 1.0f, 0.0f ));
+    const Frustum frustum( proj * view );
+
+    // centers around the camera and well past the far plane, so spheres
+    // land inside, outside and across every plane
+    std::mt19937 rng( 1234 );
+    std::uniform_real_distribution<float> coord( -120.0f, 120.0f );
+    std::uniform_real_distribution<float> radius( 0.0f, 20.0f );
+    std::vector<glm::vec4> spheres( NUM_SPHERES );
+    for ( glm::vec4& sphere : spheres ) {
+        sphere = glm::vec4( coord( rng ), coord( rng ), coord( rng ), radius( rng ));
+    }
+    size_t numVisible = 0;
+    const size_t mismatches = countMismatches( frustum, spheres, numVisible );
+    std::printf( "%zu spheres, %zu visible, %zu mismatches\n", spheres.size(), numVisible, mismatches );
+    check( mismatches == 0, "random spheres match IsVisible" );
+    check( numVisible > 0 && numVisible < spheres.size(), "random spheres are partly culled" );
+
+    // points (radius 0) and spheres that just touch a plane; the lanes of
+    // each group of 4 differ so mixed masks are covered
+    std::vector<glm::vec4> edges;
+    for ( int i=0; i<4003; ++i ) {
+        const glm::vec4 center( coord( rng ), coord( rng ), coord( rng ), 0.0f );
+        edges.push_back( center );
+        edges.push_back( glm::vec4( glm::vec3( center ), std::fabs( center.x ) * 0.5f ));
+    }
+    // an infinite radius is never culled, wherever the center is
+    edges.push_back( glm::vec4( 1000.0f, 1000.0f, 1000.0f, std::numeric_limits<float>::infinity() ));
+    const size_t edgeMismatches = countMismatches( frustum, edges, numVisible );
+    check( edgeMismatches == 0, "points and plane crossing spheres match IsVisible" );
+    std::vector<uint8_t> infVisible( 1 );
+    const glm::vec4 infSphere( 1000.0f, 1000.0f, 1000.0f, std::numeric_limits<float>::infinity() );
+    frustum.CullSpheres( &infSphere, 1, infVisible.data() );
+    check( infVisible[0] == 1, "infinite radius is never culled" );
+
+    // every count from 0 to 9 so each SIMD remainder is covered
+    bool smallOk = true;
+    for ( size_t count=0; count<10; ++count ) {
+        const std::vector<glm::vec4> some( spheres.begin(), spheres.begin() + count );
+        smallOk = smallOk && countMismatches( frustum, some, numVisible ) == 0;
+    }
+    check( smallOk, "counts 0..9 match IsVisible" );
+
+    std::printf( "%d failed\n", sNumFailed );
+    return sNumFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
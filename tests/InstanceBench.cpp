@@ -0,0 +1,123 @@
+// Throughput of one instanced draw against one DrawVertexBuffer per copy
+// of a small prop, from 1 to 10000 copies. Each frame is queued, flushed
+// and finished, so both CPU submission and GPU time count. Opens a
+// window for the GL context; run from the repo root
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Renderer.h"
+#include "VertexBuffer.h"
+
+#ifdef WIN32
+#undef main
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static const size_t INSTANCE_COUNTS[] = { 1, 10, 100, 500, 1000, 5000, 10000 };
+static const int NUM_RUNS = 10;
+static const size_t GRID_WIDTH = 100;
+
+static float msSince( const Clock::time_point& start )
+{
+    return std::chrono::duration<float, std::milli>( Clock::now() - start ).count();
+}
+
+// unit cube, 4 vertices per face so each has its own normal
+static VertexBuffer* createCube()
+{
+    static const float faces[6][3] = {
+        { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f },
+        { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f },
+        { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f }
+    };
+    std::vector<VertexTextured> vertices;
+    std::vector<uint32_t> indices;
+    for ( int face=0; face<6; ++face ) {
+        const glm::vec3 n( faces[face][0], faces[face][1], faces[face][2] );
+        const glm::vec3 u( n.y, n.z, n.x ); // perpendicular to n
+        const glm::vec3 v = glm::cross( n, u );
+        const uint32_t first = (uint32_t)vertices.size();
+        for ( int corner=0; corner<4; ++corner ) {
+            const float su = (corner == 1 || corner == 2) ? 1.0f : -1.0f;
+            const float sv = (corner >= 2) ? 1.0f : -1.0f;
+            const glm::vec3 p = 0.5f * (n + su * u + sv * v);
+            const VertexTextured vert = { p.x, p.y, p.z, n.x, n.y, n.z, su * 0.5f + 0.5f, sv * 0.5f + 0.5f };
+            vertices.push_back( vert );
+        }
+        const uint32_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+        for ( uint32_t idx : quad ) {
+            indices.push_back( first + idx );
+        }
+    }
+    return new VertexBuffer(
+        VertexBuffer::POS_TEXCOORD,
+        vertices.data(),
+        vertices.size(),
+        indices.data(),
+        indices.size()
+    );
+}
+
+int main()
+{
+    Renderer& render = *Renderer::GetInstance();
+    render.Init( "InstanceBench", 640, 480 );
+    render.SetAmbientLight( 0.5f, 0.5f, 0.5f );
+    std::unique_ptr<VertexBuffer> cube( createCube() );
+
+    // a wall of props in front of the camera, all inside the frustum
+    const size_t maxInstances = INSTANCE_COUNTS[sizeof( INSTANCE_COUNTS ) / sizeof( INSTANCE_COUNTS[0] ) - 1];
+    std::vector<glm::mat4> modelMats( maxInstances );
+    for ( size_t i=0; i<maxInstances; ++i ) {
+        const glm::vec3 pos(
+            (float( i % GRID_WIDTH ) - float( GRID_WIDTH ) * 0.5f) * 0.4f,
+            (float( i / GRID_WIDTH ) - float( GRID_WIDTH ) * 0.5f) * 0.3f,
+            -40.0f
+        );
+        modelMats[i] = glm::scale( glm::translate( glm::mat4( 1.0f ), pos ), glm::vec3( 0.2f ));
+    }
+
+    std::printf( "%s\n", (const char*)glGetString( GL_RENDERER ));
+    std::printf( "instances   separate ms  instanced ms   separate inst/ms  instanced inst/ms  speedup\n" );
+    for ( const size_t numInstances : INSTANCE_COUNTS )
+    {
+        float bestSeparate = 1e30f, bestInstanced = 1e30f;
+        for ( int run=0; run<NUM_RUNS; ++run )
+        {
+            render.Clear();
+            glFinish();
+            Clock::time_point start = Clock::now();
+            for ( size_t i=0; i<numInstances; ++i ) {
+                render.DrawVertexBuffer( modelMats[i], *cube );
+            }
+            render.Flush();
+            glFinish();
+            bestSeparate = std::min( bestSeparate, msSince( start ));
+
+            render.Clear();
+            glFinish();
+            start = Clock::now();
+            render.DrawVertexBufferInstanced( modelMats.data(), numInstances, *cube );
+            render.Flush();
+            glFinish();
+            bestInstanced = std::min( bestInstanced, msSince( start ));
+        }
+        std::printf( "%9zu %12.3f %13.3f %18.0f %18.0f %8.2fx\n",
+            numInstances,
+            bestSeparate,
+            bestInstanced,
+            float( numInstances ) / bestSeparate,
+            float( numInstances ) / bestInstanced,
+            bestSeparate / bestInstanced
+        );
+    }
+    return EXIT_SUCCESS;
+}
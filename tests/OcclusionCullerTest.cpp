@@ -0,0 +1,89 @@
+// Headless checks of OcclusionCuller against a single wall quad
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "OcclusionCuller.h"
+#include "ThreadPool.h"
+
+static int sNumFailed = 0;
+
+static void check( const bool ok, const char* what )
+{
+    std::printf( "%s: %s\n", ok ? "PASS" : "FAIL", what );
+    if ( !ok ) { ++sNumFailed; }
+}
+
+static Aabb makeBox( const glm::vec3& center, const glm::vec3& halfSize )
+{
+    Aabb box;
+    box.Add( center - halfSize );
+    box.Add( center + halfSize );
+    return box;
+}
+
+int main()
+{
+    ThreadPool::GetInstance()->Init( ThreadPool::GetDefaultNumWorkers() );
+
+    // camera at the origin looking down -z, wall about 4x2 at z = -5
+    const size_t width = 256;
+    const float aspect = 2.0f;
+    const float fovY = glm::radians( 60.0f );
+    OcclusionCuller culler( width, 128 );
+    culler.BeginFrame( glm::perspective( fovY, aspect, 0.1f, 100.0f ));
+
+    // world x at depth d that projects to buffer column sx
+    const float xScale = 1.0f / (std::tan( fovY * 0.5f ) * aspect);
+    auto worldX = [&]( const float sx, const float d ) {
+        return (sx / float( width ) * 2.0f - 1.0f) * d / xScale;
+    };
+    // the right edge crosses column 172 past its center, so that pixel
+    // is written although its right part isn't covered
+    const float edgeX = worldX( 172.8f, 5.0f );
+    const float wall[] = {
+        -edgeX, -1.0f, -5.0f,
+         edgeX, -1.0f, -5.0f,
+         edgeX,  1.0f, -5.0f,
+        -edgeX,  1.0f, -5.0f
+    };
+    const uint32_t indices[] = { 0,1,2, 0,2,3 };
+    culler.AddOccluder( glm::mat4( 1.0f ), wall, 3 * sizeof( float ), 4, indices, 6 );
+    culler.RasterizeOccluders();
+    check( culler.GetNumOccluderTris() == 2, "both wall triangles kept" );
+
+    const glm::vec3 half( 0.25f );
+    check( !culler.IsVisible( makeBox( glm::vec3( 0.0f, 0.0f, -10.0f ), half )),
+        "box fully behind the wall is hidden" );
+    check( culler.IsVisible( makeBox( glm::vec3( 4.0f, 0.0f, -10.0f ), half )),
+        "box partly behind the wall is visible" );
+    check( culler.IsVisible( makeBox( glm::vec3( 0.0f, 0.0f, -4.0f ), half )),
+        "box in front of the wall is visible" );
+    // behind the wall's plane but just past its edge, inside the
+    // uncovered part of the edge pixel
+    const float besideMinX = worldX( 172.85f, 10.0f );
+    const float besideMaxX = worldX( 172.95f, 10.0f );
+    check( culler.IsVisible( makeBox(
+            glm::vec3( (besideMinX + besideMaxX) * 0.5f, 0.0f, -10.0f ),
+            glm::vec3( (besideMaxX - besideMinX) * 0.5f, 0.01f, 0.01f ))),
+        "box beside the wall's edge is visible" );
+    check( culler.IsVisible( makeBox( glm::vec3( 0.0f, 0.0f, 0.0f ), half )),
+        "box around the camera is visible" );
+
+    // batched test agrees with single tests
+    const Aabb boxes[] = {
+        makeBox( glm::vec3( 0.0f, 0.0f, -10.0f ), half ),
+        makeBox( glm::vec3( 4.0f, 0.0f, -10.0f ), half ),
+        makeBox( glm::vec3( 0.0f, 0.0f, -4.0f ), half )
+    };
+    uint8_t visible[3];
+    const size_t numVisible = culler.CullBoxes( boxes, 3, visible );
+    check( numVisible == 2 && !visible[0] && visible[1] && visible[2], "CullBoxes matches IsVisible" );
+
+    ThreadPool::GetInstance()->Shutdown();
+    std::printf( "%d failed\n", sNumFailed );
+    return sNumFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
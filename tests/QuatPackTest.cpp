@@ -0,0 +1,113 @@
+// Checks smallest-three quaternion packing round-trips within its
+// quantization error, on random rotations and the edge cases of the
+// encoding. Reads no files and never touches GL
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "ModelAsset.h"
+
+typedef ModelAsset::Animation Animation;
+
+static const int NUM_RANDOM = 100000;
+// the 3 stored components span +-1/sqrt(2) in 15 bits, so each is off by
+// at most half a step, 2.2e-5. The rebuilt largest one, at least 1/2,
+// sums their errors: up to 3 * 0.71 * 2.2e-5 / 0.5 = 9.3e-5
+static const float MAX_COMPONENT_ERROR = 1e-4f;
+// rotation angle between the original and the round-tripped quaternion;
+// about twice the length of their difference
+static const float MAX_ANGLE_ERROR = 2e-4f; // radians
+
+static int sNumFailed = 0;
+
+static void check( const bool ok, const char* what )
+{
+    std::printf( "%s: %s\n", ok ? "PASS" : "FAIL", what );
+    if ( !ok ) { ++sNumFailed; }
+}
+
+struct RoundTripError
+{
+    float component;
+    float angle;
+};
+
+// errors of one round trip; q and -q are the same rotation, so the result
+// is compared against whichever of them it is closer to
+static RoundTripError roundTrip( const glm::quat& q )
+{
+    const glm::quat unit = glm::normalize( q );
+    const glm::quat out = Animation::unpackQuat( Animation::packQuat( unit ));
+    const float d = glm::dot( unit, out );
+    const glm::quat ref = d < 0.0f ? -unit : unit;
+    RoundTripError err;
+    err.component = std::max(
+        std::max( std::fabs( out.x - ref.x ), std::fabs( out.y - ref.y )),
+        std::max( std::fabs( out.z - ref.z ), std::fabs( out.w - ref.w ))
+    );
+    // from the chord rather than acos( d ), which loses the small angles
+    // to float rounding near 1
+    const glm::quat diff = out - ref;
+    const float chord = std::sqrt( glm::dot( diff, diff ));
+    err.angle = 4.0f * std::asin( std::min( chord * 0.5f, 1.0f ));
+    return err;
+}
+
+static void merge( RoundTripError& worst, const RoundTripError& err )
+{
+    worst.component = std::max( worst.component, err.component );
+    worst.angle = std::max( worst.angle, err.angle );
+}
+
+static bool withinBounds( const RoundTripError& err )
+{
+    return err.component <= MAX_COMPONENT_ERROR && err.angle <= MAX_ANGLE_ERROR;
+}
+
+int main()
+{
+    // uniform random rotations: normalized 4D gaussians
+    std::mt19937 rng( 1234 );
+    std::normal_distribution<float> gauss( 0.0f, 1.0f );
+    RoundTripError worst = { 0.0f, 0.0f };
+    for ( int i=0; i<NUM_RANDOM; ++i ) {
+        merge( worst, roundTrip( glm::quat( gauss( rng ), gauss( rng ), gauss( rng ), gauss( rng ))));
+    }
+    std::printf( "random: max component error %g, max angle error %g\n", worst.component, worst.angle );
+    check( withinBounds( worst ), "random rotations round-trip within the bound" );
+
+    // each component in turn the largest, with either sign, so every
+    // dropped index and the sign flip are exercised
+    RoundTripError edge = { 0.0f, 0.0f };
+    for ( int largest=0; largest<4; ++largest ) {
+        for ( float sign=-1.0f; sign<=1.0f; sign+=2.0f ) {
+            float comps[4] = { 0.1f, -0.2f, 0.3f, -0.25f };
+            comps[largest] = 0.9f * sign;
+            merge( edge, roundTrip( glm::quat( comps[3], comps[0], comps[1], comps[2] )));
+            // only the largest set: identity and 180 degree turns
+            float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            axis[largest] = sign;
+            merge( edge, roundTrip( glm::quat( axis[3], axis[0], axis[1], axis[2] )));
+        }
+    }
+    // two components tied for largest put the others at the edge of the
+    // stored range
+    merge( edge, roundTrip( glm::quat( 1.0f, 1.0f, 0.0f, 0.0f )));
+    merge( edge, roundTrip( glm::quat( 0.0f, 0.0f, -1.0f, 1.0f )));
+    merge( edge, roundTrip( glm::quat( 1.0f, 1.0f, 1.0f, 1.0f )));
+    merge( edge, roundTrip( glm::quat( -1.0f, 1.0f, -1.0f, 1.0f )));
+    std::printf( "edge cases: max component error %g, max angle error %g\n", edge.component, edge.angle );
+    check( withinBounds( edge ), "edge cases round-trip within the bound" );
+
+    // unnormalized input is packed as its unit quaternion
+    const RoundTripError scaled = roundTrip( glm::quat( 3.0f, -1.0f, 2.0f, 0.5f ));
+    check( withinBounds( scaled ), "unnormalized input round-trips as its unit quaternion" );
+
+    std::printf( "%d failed\n", sNumFailed );
+    return sNumFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,95 @@
+// Checks SceneGraph recomputes exactly the moved nodes and everything
+// below them, and that the recomputed world transforms are right
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "SceneGraph.h"
+#include "Transform.h"
+
+static const float TOLERANCE = 1e-5f;
+
+static int sNumFailed = 0;
+
+static void check( const bool ok, const char* what )
+{
+    std::printf( "%s: %s\n", ok ? "PASS" : "FAIL", what );
+    if ( !ok ) { ++sNumFailed; }
+}
+
+static Affine translation( const float x, const float y, const float z )
+{
+    return Affine( glm::translate( glm::mat4( 1.0f ), glm::vec3( x, y, z )));
+}
+
+static bool nearlyEqual( const Affine& a, const glm::mat4& b )
+{
+    const glm::mat4 am = a.ToMat4();
+    for ( int c=0; c<4; ++c ) {
+        for ( int r=0; r<4; ++r ) {
+            if ( std::fabs( am[c][r] - b[c][r] ) > TOLERANCE ) { return false; }
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    //  root
+    //  +- parent
+    //  |  +- child
+    //  |     +- grandchild
+    //  +- sibling
+    SceneGraph graph;
+    const size_t root = graph.AddNode( SceneGraph::NO_PARENT, translation( 1.0f, 0.0f, 0.0f ), "root" );
+    const size_t parent = graph.AddNode( int( root ), translation( 0.0f, 2.0f, 0.0f ), "parent" );
+    const size_t child = graph.AddNode( int( parent ), translation( 0.0f, 0.0f, 3.0f ), "child" );
+    const size_t grandchild = graph.AddNode( int( child ), translation( 4.0f, 0.0f, 0.0f ), "grandchild" );
+    const size_t sibling = graph.AddNode( int( root ), translation( 0.0f, 5.0f, 0.0f ), "sibling" );
+
+    check( graph.UpdateWorldTransforms() == graph.GetNumNodes(), "first update computes every node" );
+    check( graph.UpdateWorldTransforms() == 0, "update without changes computes nothing" );
+
+    // move the parent: it and its whole subtree go stale, nothing else
+    const glm::mat4 parentLocal =
+        glm::translate( glm::mat4( 1.0f ), glm::vec3( 0.0f, 2.0f, 1.0f )) *
+        glm::rotate( glm::mat4( 1.0f ), glm::radians( 90.0f ), glm::vec3( 0.0f, 1.0f, 0.0f ));
+    graph.SetLocal( parent, Affine( parentLocal ));
+    const Affine siblingBefore = graph.GetWorld( sibling );
+    check( graph.UpdateWorldTransforms() == 3, "moving a parent recomputes it, its child and grandchild" );
+
+    const glm::mat4 rootWorld = translation( 1.0f, 0.0f, 0.0f ).ToMat4();
+    const glm::mat4 parentWorld = rootWorld * parentLocal;
+    const glm::mat4 childWorld = parentWorld * translation( 0.0f, 0.0f, 3.0f ).ToMat4();
+    const glm::mat4 grandchildWorld = childWorld * translation( 4.0f, 0.0f, 0.0f ).ToMat4();
+    check( nearlyEqual( graph.GetWorld( parent ), parentWorld ), "parent world follows its new local" );
+    check( nearlyEqual( graph.GetWorld( child ), childWorld ), "child world follows the moved parent" );
+    check( nearlyEqual( graph.GetWorld( grandchild ), grandchildWorld ), "grandchild world follows the moved parent" );
+    check( nearlyEqual( graph.GetWorld( sibling ), siblingBefore.ToMat4() ), "sibling of the moved parent is untouched" );
+    check( graph.UpdateWorldTransforms() == 0, "dirty flags are cleared after the update" );
+
+    // moving a leaf recomputes only the leaf
+    graph.SetLocal( grandchild, translation( 0.0f, 0.0f, 0.0f ));
+    check( graph.UpdateWorldTransforms() == 1, "moving a leaf recomputes only it" );
+    check( nearlyEqual( graph.GetWorld( grandchild ), childWorld ), "leaf world follows its new local" );
+
+    // a node and its ancestor both moved: each node is recomputed once
+    graph.SetLocal( child, translation( 0.0f, 0.0f, 6.0f ));
+    graph.SetLocal( root, translation( -1.0f, 0.0f, 0.0f ));
+    check( graph.UpdateWorldTransforms() == graph.GetNumNodes(), "moving the root and a child recomputes each node once" );
+    const glm::mat4 newChildWorld =
+        translation( -1.0f, 0.0f, 0.0f ).ToMat4() * parentLocal * translation( 0.0f, 0.0f, 6.0f ).ToMat4();
+    check( nearlyEqual( graph.GetWorld( grandchild ), newChildWorld ), "grandchild follows both moves" );
+
+    // nodes added under an existing parent start dirty
+    const size_t late = graph.AddNode( int( child ), translation( 0.0f, 1.0f, 0.0f ), "late" );
+    check( graph.UpdateWorldTransforms() == 1, "a new node is computed on the next update" );
+    check( nearlyEqual( graph.GetWorld( late ), newChildWorld * translation( 0.0f, 1.0f, 0.0f ).ToMat4() ),
+        "a new node's world includes its parent" );
+
+    std::printf( "%d failed\n", sNumFailed );
+    return sNumFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,91 @@
+// Cost of dual quaternion skinning compared to linear blend skinning
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Skinning.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const size_t NUM_VERTS = 100000;
+static const size_t NUM_BONES = 64;
+static const int NUM_RUNS = 50;
+
+// fastest of NUM_RUNS runs, in ms
+static float timeBest( const std::function<void()>& func )
+{
+    float best = 1e30f;
+    for ( int run=0; run<NUM_RUNS; ++run ) {
+        const Clock::time_point start = Clock::now();
+        func();
+        best = std::min( best, std::chrono::duration<float, std::milli>( Clock::now() - start ).count() );
+    }
+    return best;
+}
+
+int main()
+{
+    std::mt19937 rng( 1234 );
+    std::uniform_real_distribution<float> unit( -1.0f, 1.0f );
+    std::uniform_real_distribution<float> positive( 0.05f, 1.0f );
+    std::uniform_int_distribution<uint32_t> bone( 0, NUM_BONES - 1 );
+
+    std::vector<glm::mat4> palette( NUM_BONES );
+    for ( glm::mat4& mat : palette ) {
+        const glm::quat rot = glm::normalize( glm::quat( unit( rng ), unit( rng ), unit( rng ), unit( rng )));
+        mat = glm::translate( glm::mat4( 1.0f ), glm::vec3( unit( rng ), unit( rng ), unit( rng ))) * glm::mat4_cast( rot );
+    }
+    std::vector<VertexTextured> verts( NUM_VERTS );
+    std::vector<VertBoneIndices> idxs( NUM_VERTS );
+    std::vector<VertBoneWeights> weights( NUM_VERTS );
+    for ( size_t i=0; i<NUM_VERTS; ++i ) {
+        verts[i].x = unit( rng );
+        verts[i].y = unit( rng );
+        verts[i].z = unit( rng );
+        uint32_t* idx = &idxs[i].idx0;
+        float* weight = &weights[i].weight0;
+        float sum = 0.0f;
+        for ( int slot=0; slot<MAX_BONE_INFLUENCES; ++slot ) {
+            idx[slot] = bone( rng );
+            weight[slot] = positive( rng );
+            sum += weight[slot];
+        }
+        for ( int slot=0; slot<MAX_BONE_INFLUENCES; ++slot ) {
+            weight[slot] /= sum;
+        }
+    }
+    std::vector<glm::vec3> out( NUM_VERTS );
+    std::vector<DualQuat> dualQuats( NUM_BONES );
+
+    std::printf( "%zu verts, %zu bones, %d influences, best of %d runs\n",
+        NUM_VERTS, NUM_BONES, MAX_BONE_INFLUENCES, NUM_RUNS );
+    auto skinLbs = [&]() {
+        Skinning::SkinPositions( verts.data(), out.data(), idxs.data(), weights.data(),
+            NUM_VERTS, palette.data() );
+    };
+    const Skinning::Isa bestIsa = Skinning::GetSupportedIsa();
+    if ( bestIsa != Skinning::ISA_SCALAR ) {
+        Skinning::SetIsa( bestIsa );
+        std::printf( "LBS %-7s %8.3f ms\n", Skinning::GetIsaName( bestIsa ), timeBest( skinLbs ));
+    }
+    // the dual quaternion kernel is scalar, so compare like with like
+    Skinning::SetIsa( Skinning::ISA_SCALAR );
+    const float lbsScalarMs = timeBest( skinLbs );
+    std::printf( "LBS %-7s %8.3f ms\n", Skinning::GetIsaName( Skinning::ISA_SCALAR ), lbsScalarMs );
+    // the palette conversion is part of a frame's DQ cost
+    const float dqMs = timeBest( [&]() {
+        Skinning::PaletteToDualQuats( palette.data(), dualQuats.data(), NUM_BONES );
+        Skinning::SkinPositionsDualQuat( verts.data(), out.data(), idxs.data(), weights.data(),
+            NUM_VERTS, dualQuats.data() );
+    });
+    std::printf( "DQ  %-7s %8.3f ms (%.2fx scalar LBS)\n",
+        Skinning::GetIsaName( Skinning::ISA_SCALAR ), dqMs, dqMs / lbsScalarMs );
+    return 0;
+}
@@ -0,0 +1,110 @@
+// Checks every skinning kernel against the original per bone loop
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Skinning.h"
+
+static const size_t NUM_BONES = 32;
+static const float TOLERANCE = 1e-4f; // relative to the position's magnitude
+
+// the skinning loop from before the SIMD kernels: every slot's bone
+// transforms the position, weighted, summed
+static glm::vec3 skinReference(
+    const VertexTextured& vert,
+    const VertBoneIndices& idxs,
+    const VertBoneWeights& weights,
+    const glm::mat4* palette )
+{
+    const glm::vec4 pos( vert.x, vert.y, vert.z, 1.0f );
+    glm::vec4 skinnedPos = palette[idxs.idx0] * pos * weights.weight0;
+    skinnedPos += palette[idxs.idx1] * pos * weights.weight1;
+    skinnedPos += palette[idxs.idx2] * pos * weights.weight2;
+    skinnedPos += palette[idxs.idx3] * pos * weights.weight3;
+    return glm::vec3( skinnedPos );
+}
+
+int main()
+{
+    std::mt19937 rng( 1234 );
+    std::uniform_real_distribution<float> unit( -1.0f, 1.0f );
+    std::uniform_real_distribution<float> positive( 0.05f, 1.0f );
+    std::uniform_int_distribution<uint32_t> bone( 0, NUM_BONES - 1 );
+
+    // rigid bones with some scale, like a real palette
+    std::vector<glm::mat4> palette( NUM_BONES );
+    for ( glm::mat4& mat : palette ) {
+        const glm::quat rot = glm::normalize( glm::quat( unit( rng ), unit( rng ), unit( rng ), unit( rng )));
+        mat = glm::translate( glm::mat4( 1.0f ), glm::vec3( unit( rng ), unit( rng ), unit( rng )) * 10.0f ) *
+              glm::mat4_cast( rot ) *
+              glm::scale( glm::mat4( 1.0f ), glm::vec3( 1.0f + 0.1f * unit( rng )));
+    }
+
+    const Skinning::Isa isas[] = { Skinning::ISA_SCALAR, Skinning::ISA_SSE41, Skinning::ISA_AVX2 };
+    // not multiples of 4 or 2, so the kernels' tails run
+    const size_t vertCounts[] = { 1, 2, 3, 5, 7, 9, 13, 1001 };
+    int numFailed = 0;
+    for ( const Skinning::Isa isa : isas )
+    {
+        if ( !Skinning::SetIsa( isa )) {
+            std::printf( "SKIP: %s not supported\n", Skinning::GetIsaName( isa ));
+            continue;
+        }
+        for ( int numInfluences=1; numInfluences<=MAX_BONE_INFLUENCES; ++numInfluences ) {
+            for ( const size_t numVerts : vertCounts )
+            {
+                std::vector<VertexTextured> verts( numVerts );
+                std::vector<VertBoneIndices> idxs( numVerts );
+                std::vector<VertBoneWeights> weights( numVerts );
+                for ( size_t i=0; i<numVerts; ++i ) {
+                    verts[i].x = unit( rng ) * 5.0f;
+                    verts[i].y = unit( rng ) * 5.0f;
+                    verts[i].z = unit( rng ) * 5.0f;
+                    verts[i].nx = verts[i].ny = verts[i].nz = 0.0f;
+                    verts[i].u = verts[i].v = 0.0f;
+                    // used slots first with normalized random weights
+                    uint32_t* idx = &idxs[i].idx0;
+                    float* weight = &weights[i].weight0;
+                    float sum = 0.0f;
+                    for ( int slot=0; slot<MAX_BONE_INFLUENCES; ++slot ) {
+                        idx[slot] = slot < numInfluences ? bone( rng ) : 0;
+                        weight[slot] = slot < numInfluences ? positive( rng ) : 0.0f;
+                        sum += weight[slot];
+                    }
+                    for ( int slot=0; slot<numInfluences; ++slot ) {
+                        weight[slot] /= sum;
+                    }
+                }
+
+                std::vector<glm::vec3> out( numVerts, glm::vec3( NAN ));
+                Skinning::SkinPositions(
+                    verts.data(), out.data(), idxs.data(), weights.data(),
+                    numVerts, palette.data(), numInfluences
+                );
+                float maxError = 0.0f;
+                for ( size_t i=0; i<numVerts; ++i ) {
+                    const glm::vec3 expected = skinReference( verts[i], idxs[i], weights[i], palette.data() );
+                    const float error = glm::length( out[i] - expected ) / std::max( 1.0f, glm::length( expected ));
+                    // an unwritten tail stays NaN, which must fail too
+                    if ( std::isnan( error ) || error > maxError ) { maxError = error; }
+                }
+                const bool ok = maxError <= TOLERANCE;
+                if ( !ok ) {
+                    ++numFailed;
+                    std::printf( "FAIL: %s, %d influences, %zu verts: max error %g\n",
+                        Skinning::GetIsaName( isa ), numInfluences, numVerts, maxError );
+                }
+            }
+        }
+        std::printf( "done: %s\n", Skinning::GetIsaName( isa ));
+    }
+
+    std::printf( "%d failed\n", numFailed );
+    return numFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
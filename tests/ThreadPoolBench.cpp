@@ -0,0 +1,104 @@
+// How ParallelFor scales from 1 to N threads when skinning a character
+// sized mesh, the job the pool runs every frame
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Skinning.h"
+#include "ThreadPool.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const size_t NUM_VERTS = 32768;
+static const size_t NUM_BONES = 64;
+static const size_t MIN_CHUNK_SIZE = 1024;
+static const size_t DYNAMIC_CHUNK_SIZE = 2048;
+static const int NUM_RUNS = 50;
+
+int main()
+{
+    std::mt19937 rng( 1234 );
+    std::uniform_real_distribution<float> unit( -1.0f, 1.0f );
+    std::uniform_real_distribution<float> positive( 0.05f, 1.0f );
+    std::uniform_int_distribution<uint32_t> bone( 0, NUM_BONES - 1 );
+
+    std::vector<glm::mat4> palette( NUM_BONES );
+    for ( glm::mat4& mat : palette ) {
+        const glm::quat rot = glm::normalize( glm::quat( unit( rng ), unit( rng ), unit( rng ), unit( rng )));
+        mat = glm::translate( glm::mat4( 1.0f ), glm::vec3( unit( rng ), unit( rng ), unit( rng ))) * glm::mat4_cast( rot );
+    }
+    std::vector<VertexTextured> verts( NUM_VERTS );
+    std::vector<VertBoneIndices> idxs( NUM_VERTS );
+    std::vector<VertBoneWeights> weights( NUM_VERTS );
+    for ( size_t i=0; i<NUM_VERTS; ++i ) {
+        verts[i].x = unit( rng );
+        verts[i].y = unit( rng );
+        verts[i].z = unit( rng );
+        uint32_t* idx = &idxs[i].idx0;
+        float* weight = &weights[i].weight0;
+        float sum = 0.0f;
+        for ( int slot=0; slot<MAX_BONE_INFLUENCES; ++slot ) {
+            idx[slot] = bone( rng );
+            weight[slot] = positive( rng );
+            sum += weight[slot];
+        }
+        for ( int slot=0; slot<MAX_BONE_INFLUENCES; ++slot ) {
+            weight[slot] /= sum;
+        }
+    }
+    std::vector<glm::vec3> out( NUM_VERTS );
+    std::vector<glm::vec3> expected( NUM_VERTS );
+    Skinning::SkinPositions( verts.data(), expected.data(), idxs.data(), weights.data(),
+        NUM_VERTS, palette.data() );
+
+    auto skinRange = [&]( size_t begin, size_t end ) {
+        Skinning::SkinPositions( &verts[begin], &out[begin], &idxs[begin], &weights[begin],
+            end - begin, palette.data() );
+    };
+
+    ThreadPool& pool = *ThreadPool::GetInstance();
+    const size_t maxThreads = std::max( 1u, std::thread::hardware_concurrency() );
+    std::printf( "%zu verts, %zu bones, %s kernel, best of %d runs\n",
+        NUM_VERTS, NUM_BONES, Skinning::GetIsaName( Skinning::GetIsa() ), NUM_RUNS );
+    std::printf( "threads   static ms  speedup   dynamic ms  speedup\n" );
+    float baseStatic = 0.0f;
+    float baseDynamic = 0.0f;
+    bool matches = true;
+    for ( size_t numThreads=1; numThreads<=maxThreads; ++numThreads )
+    {
+        // the calling thread is one of them
+        pool.Init( numThreads - 1 );
+        float bestStatic = 1e30f;
+        float bestDynamic = 1e30f;
+        for ( int run=0; run<NUM_RUNS; ++run ) {
+            Clock::time_point start = Clock::now();
+            pool.ParallelFor( NUM_VERTS, MIN_CHUNK_SIZE, skinRange );
+            bestStatic = std::min( bestStatic, std::chrono::duration<float, std::milli>( Clock::now() - start ).count() );
+            start = Clock::now();
+            pool.ParallelForDynamic( NUM_VERTS, DYNAMIC_CHUNK_SIZE, skinRange );
+            bestDynamic = std::min( bestDynamic, std::chrono::duration<float, std::milli>( Clock::now() - start ).count() );
+        }
+        // every chunk has to land where one call over the whole mesh would
+        matches = matches && std::equal( out.begin(), out.end(), expected.begin() );
+        if ( numThreads == 1 ) {
+            baseStatic = bestStatic;
+            baseDynamic = bestDynamic;
+        }
+        std::printf( "%7zu %11.3f %8.2fx %12.3f %8.2fx\n",
+            numThreads, bestStatic, baseStatic / bestStatic, bestDynamic, baseDynamic / bestDynamic );
+    }
+    pool.Shutdown();
+    if ( !matches ) {
+        std::printf( "FAIL: parallel skinning differs from one call\n" );
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+// Checks ThreadPool covers every item once, including nested calls
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "ThreadPool.h"
+
+static int sNumFailed = 0;
+
+static void check( const bool ok, const char* what )
+{
+    std::printf( "%s: %s\n", ok ? "PASS" : "FAIL", what );
+    if ( !ok ) { ++sNumFailed; }
+}
+
+// every item of [0,count) visited exactly once
+static bool allOnce( const std::vector<std::atomic<int>>& visits )
+{
+    for ( const std::atomic<int>& v : visits ) {
+        if ( v.load() != 1 ) { return false; }
+    }
+    return true;
+}
+
+int main()
+{
+    ThreadPool& pool = *ThreadPool::GetInstance();
+    pool.Init( 3 );
+
+    const size_t count = 10007;
+    std::vector<std::atomic<int>> visits( count );
+    for ( std::atomic<int>& v : visits ) { v = 0; }
+    pool.ParallelFor( count, 16, [&]( size_t begin, size_t end ) {
+        for ( size_t i=begin; i<end; ++i ) { ++visits[i]; }
+    });
+    check( allOnce( visits ), "ParallelFor visits every item once" );
+
+    for ( std::atomic<int>& v : visits ) { v = 0; }
+    pool.ParallelForDynamic( count, 7, [&]( size_t begin, size_t end ) {
+        for ( size_t i=begin; i<end; ++i ) { ++visits[i]; }
+    });
+    check( allOnce( visits ), "ParallelForDynamic visits every item once" );
+
+    // every chunk, including the ones the submitting thread runs, starts
+    // another ParallelFor; these used to deadlock on the caller
+    const size_t outer = 64;
+    const size_t inner = 100;
+    std::vector<std::atomic<int>> nestedVisits( outer * inner );
+    for ( std::atomic<int>& v : nestedVisits ) { v = 0; }
+    pool.ParallelForDynamic( outer, 1, [&]( size_t begin, size_t end ) {
+        for ( size_t o=begin; o<end; ++o ) {
+            pool.ParallelFor( inner, 1, [&]( size_t innerBegin, size_t innerEnd ) {
+                for ( size_t i=innerBegin; i<innerEnd; ++i ) { ++nestedVisits[o * inner + i]; }
+            });
+        }
+    });
+    check( allOnce( nestedVisits ), "nested ParallelFor runs inline" );
+
+    // the caller is back to submitting jobs afterwards
+    for ( std::atomic<int>& v : visits ) { v = 0; }
+    pool.ParallelFor( count, 16, [&]( size_t begin, size_t end ) {
+        for ( size_t i=begin; i<end; ++i ) { ++visits[i]; }
+    });
+    check( allOnce( visits ), "ParallelFor after a nested job" );
+
+    pool.Shutdown();
+    std::printf( "%d failed\n", sNumFailed );
+    return sNumFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,217 @@
+// CPU cost of submitting a lit draw with the uniforms set three ways:
+// looked up with glGetUniformLocation per draw as Renderer used to, by
+// name through Shader's location table, and through locations resolved
+// once. Opens a window for the GL context; run from the repo root
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Renderer.h"
+#include "Shader.h"
+
+#ifdef WIN32
+#undef main
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static const int NUM_DRAWS = 10000;
+static const int NUM_RUNS = 20;
+
+struct Lights
+{
+    glm::vec3 ambient;
+    glm::vec3 posLgtPos[MAX_POS_LIGHTS];
+    glm::vec3 posLgtDff[MAX_POS_LIGHTS];
+    glm::vec3 dirLgtDir[MAX_DIR_LIGHTS];
+    glm::vec3 dirLgtDff[MAX_DIR_LIGHTS];
+};
+
+// Renderer::setLitUniforms before the location table
+static void setUniformsLookup( GLuint progID, const Lights& lights, const glm::mat4& viewProj, const glm::mat4& modelMat )
+{
+    const glm::mat4 mvpMat = viewProj * modelMat;
+    const glm::mat4 normalMat = glm::inverse( glm::transpose( modelMat ));
+    glUniform3fv( glGetUniformLocation( progID, std::string( "uAmbient" ).c_str() ), 1, glm::value_ptr( lights.ambient ));
+    for ( int i=0; i<MAX_POS_LIGHTS; ++i ) {
+        char ufrmName[256];
+        sprintf( ufrmName, "uPosLgtPos%d", i );
+        glUniform3fv( glGetUniformLocation( progID, std::string( ufrmName ).c_str() ), 1, glm::value_ptr( lights.posLgtPos[i] ));
+        sprintf( ufrmName, "uPosLgtDff%d", i );
+        glUniform3fv( glGetUniformLocation( progID, std::string( ufrmName ).c_str() ), 1, glm::value_ptr( lights.posLgtDff[i] ));
+    }
+    for ( int i=0; i<MAX_DIR_LIGHTS; ++i ) {
+        char ufrmName[256];
+        sprintf( ufrmName, "uDirLgtDir%d", i );
+        glUniform3fv( glGetUniformLocation( progID, std::string( ufrmName ).c_str() ), 1, glm::value_ptr( lights.dirLgtDir[i] ));
+        sprintf( ufrmName, "uDirLgtDff%d", i );
+        glUniform3fv( glGetUniformLocation( progID, std::string( ufrmName ).c_str() ), 1, glm::value_ptr( lights.dirLgtDff[i] ));
+    }
+    glUniformMatrix4fv( glGetUniformLocation( progID, std::string( "uMvpMatrix" ).c_str() ), 1, GL_FALSE, glm::value_ptr( mvpMat ));
+    glUniformMatrix4fv( glGetUniformLocation( progID, std::string( "uModelMatrix" ).c_str() ), 1, GL_FALSE, glm::value_ptr( modelMat ));
+    glUniformMatrix4fv( glGetUniformLocation( progID, std::string( "uNormalMatrix" ).c_str() ), 1, GL_FALSE, glm::value_ptr( normalMat ));
+}
+
+// the name setters, which now read Shader's table
+static void setUniformsByName( Shader& shader, const Lights& lights, const glm::mat4& viewProj, const glm::mat4& modelMat )
+{
+    const glm::mat4 mvpMat = viewProj * modelMat;
+    const glm::mat4 normalMat = glm::inverse( glm::transpose( modelMat ));
+    shader.SetVec3( "uAmbient", lights.ambient );
+    for ( int i=0; i<MAX_POS_LIGHTS; ++i ) {
+        char ufrmName[256];
+        sprintf( ufrmName, "uPosLgtPos%d", i );
+        shader.SetVec3( ufrmName, lights.posLgtPos[i] );
+        sprintf( ufrmName, "uPosLgtDff%d", i );
+        shader.SetVec3( ufrmName, lights.posLgtDff[i] );
+    }
+    for ( int i=0; i<MAX_DIR_LIGHTS; ++i ) {
+        char ufrmName[256];
+        sprintf( ufrmName, "uDirLgtDir%d", i );
+        shader.SetVec3( ufrmName, lights.dirLgtDir[i] );
+        sprintf( ufrmName, "uDirLgtDff%d", i );
+        shader.SetVec3( ufrmName, lights.dirLgtDff[i] );
+    }
+    shader.SetMat4( "uMvpMatrix", mvpMat );
+    shader.SetMat4( "uModelMatrix", modelMat );
+    shader.SetMat4( "uNormalMatrix", normalMat );
+}
+
+// locations resolved once, like Renderer's LitUniforms
+struct Handles
+{
+    GLint ambient;
+    GLint posLgtPos[MAX_POS_LIGHTS];
+    GLint posLgtDff[MAX_POS_LIGHTS];
+    GLint dirLgtDir[MAX_DIR_LIGHTS];
+    GLint dirLgtDff[MAX_DIR_LIGHTS];
+    GLint mvpMatrix;
+    GLint modelMatrix;
+    GLint normalMatrix;
+};
+
+static void setUniformsByHandle( Shader& shader, const Handles& handles, const Lights& lights, const glm::mat4& viewProj, const glm::mat4& modelMat )
+{
+    const glm::mat4 mvpMat = viewProj * modelMat;
+    const glm::mat4 normalMat = glm::inverse( glm::transpose( modelMat ));
+    shader.SetVec3( handles.ambient, lights.ambient );
+    for ( int i=0; i<MAX_POS_LIGHTS; ++i ) {
+        shader.SetVec3( handles.posLgtPos[i], lights.posLgtPos[i] );
+        shader.SetVec3( handles.posLgtDff[i], lights.posLgtDff[i] );
+    }
+    for ( int i=0; i<MAX_DIR_LIGHTS; ++i ) {
+        shader.SetVec3( handles.dirLgtDir[i], lights.dirLgtDir[i] );
+        shader.SetVec3( handles.dirLgtDff[i], lights.dirLgtDff[i] );
+    }
+    shader.SetMat4( handles.mvpMatrix, mvpMat );
+    shader.SetMat4( handles.modelMatrix, modelMat );
+    shader.SetMat4( handles.normalMatrix, normalMat );
+}
+
+static float usSince( const Clock::time_point& start )
+{
+    return std::chrono::duration<float, std::micro>( Clock::now() - start ).count();
+}
+
+int main()
+{
+    Renderer::GetInstance()->Init( "UniformBench", 64, 64 );
+    Shader shader( "tests/UniformBenchVertShader.glsl", "tests/UniformBenchFragShader.glsl" );
+    shader.Use();
+    shader.SetInt( "uTexture0", 0 );
+    const GLuint progID = shader.GetProgID();
+
+    Handles handles;
+    handles.ambient = shader.GetUniformLocation( "uAmbient" );
+    for ( int i=0; i<MAX_POS_LIGHTS; ++i ) {
+        handles.posLgtPos[i] = shader.GetUniformLocation( "uPosLgtPos" + std::to_string( i ));
+        handles.posLgtDff[i] = shader.GetUniformLocation( "uPosLgtDff" + std::to_string( i ));
+    }
+    for ( int i=0; i<MAX_DIR_LIGHTS; ++i ) {
+        handles.dirLgtDir[i] = shader.GetUniformLocation( "uDirLgtDir" + std::to_string( i ));
+        handles.dirLgtDff[i] = shader.GetUniformLocation( "uDirLgtDff" + std::to_string( i ));
+    }
+    handles.mvpMatrix = shader.GetUniformLocation( "uMvpMatrix" );
+    handles.modelMatrix = shader.GetUniformLocation( "uModelMatrix" );
+    handles.normalMatrix = shader.GetUniformLocation( "uNormalMatrix" );
+
+    // one small triangle, so the draw itself costs next to nothing
+    const VertexTextured verts[3] = {
+        { -0.01f, -0.01f, 0.0f,  0.0f, 0.0f, 1.0f,  0.0f, 0.0f },
+        {  0.01f, -0.01f, 0.0f,  0.0f, 0.0f, 1.0f,  1.0f, 0.0f },
+        {  0.0f,   0.01f, 0.0f,  0.0f, 0.0f, 1.0f,  0.5f, 1.0f }
+    };
+    GLuint vao, vbo;
+    glGenVertexArrays( 1, &vao );
+    glGenBuffers( 1, &vbo );
+    glBindVertexArray( vao );
+    glBindBuffer( GL_ARRAY_BUFFER, vbo );
+    glBufferData( GL_ARRAY_BUFFER, sizeof( verts ), verts, GL_STATIC_DRAW );
+    glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, sizeof( VertexTextured ), (void*)0 ); // aPos
+    glEnableVertexAttribArray( 0 );
+    glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, sizeof( VertexTextured ), (void*)( 3 * sizeof( float ))); // aNormal
+    glEnableVertexAttribArray( 1 );
+    glVertexAttribPointer( 2, 2, GL_FLOAT, GL_FALSE, sizeof( VertexTextured ), (void*)( 6 * sizeof( float ))); // aTexCoord
+    glEnableVertexAttribArray( 2 );
+
+    Lights lights;
+    lights.ambient = glm::vec3( 0.2f, 0.2f, 0.2f );
+    for ( int i=0; i<MAX_POS_LIGHTS; ++i ) {
+        lights.posLgtPos[i] = glm::vec3( 0.0f, 2.0f, 0.0f );
+        lights.posLgtDff[i] = glm::vec3( 1.0f, 1.0f, 1.0f );
+    }
+    for ( int i=0; i<MAX_DIR_LIGHTS; ++i ) {
+        lights.dirLgtDir[i] = glm::vec3( 0.0f, -1.0f, 0.0f );
+        lights.dirLgtDff[i] = glm::vec3( 0.5f, 0.5f, 0.5f );
+    }
+    const glm::mat4 viewProj = glm::perspective( glm::radians( 60.0f ), 1.0f, 0.1f, 1000.0f );
+
+    // submission only; the GPU is drained between runs, outside the timing
+    float bestLookup = 1e30f, bestByName = 1e30f, bestByHandle = 1e30f;
+    for ( int run=0; run<NUM_RUNS; ++run )
+    {
+        Clock::time_point start = Clock::now();
+        for ( int i=0; i<NUM_DRAWS; ++i ) {
+            const glm::mat4 modelMat = glm::translate( glm::mat4( 1.0f ), glm::vec3( 0.0f, 0.0f, -1.0f - float( i % 100 ) * 0.01f ));
+            setUniformsLookup( progID, lights, viewProj, modelMat );
+            glDrawArrays( GL_TRIANGLES, 0, 3 );
+        }
+        bestLookup = std::min( bestLookup, usSince( start ));
+        glFinish();
+
+        start = Clock::now();
+        for ( int i=0; i<NUM_DRAWS; ++i ) {
+            const glm::mat4 modelMat = glm::translate( glm::mat4( 1.0f ), glm::vec3( 0.0f, 0.0f, -1.0f - float( i % 100 ) * 0.01f ));
+            setUniformsByName( shader, lights, viewProj, modelMat );
+            glDrawArrays( GL_TRIANGLES, 0, 3 );
+        }
+        bestByName = std::min( bestByName, usSince( start ));
+        glFinish();
+
+        start = Clock::now();
+        for ( int i=0; i<NUM_DRAWS; ++i ) {
+            const glm::mat4 modelMat = glm::translate( glm::mat4( 1.0f ), glm::vec3( 0.0f, 0.0f, -1.0f - float( i % 100 ) * 0.01f ));
+            setUniformsByHandle( shader, handles, lights, viewProj, modelMat );
+            glDrawArrays( GL_TRIANGLES, 0, 3 );
+        }
+        bestByHandle = std::min( bestByHandle, usSince( start ));
+        glFinish();
+    }
+
+    glDeleteBuffers( 1, &vbo );
+    glDeleteVertexArrays( 1, &vao );
+
+    const float n = float( NUM_DRAWS );
+    std::printf( "%s\n", (const char*)glGetString( GL_RENDERER ));
+    std::printf( "uniforms set by      us/draw   speedup, best of %d runs of %d draws\n", NUM_RUNS, NUM_DRAWS );
+    std::printf( "glGetUniformLocation %8.3f\n", bestLookup / n );
+    std::printf( "name, table          %8.3f %8.2fx\n", bestByName / n, bestLookup / bestByName );
+    std::printf( "handle               %8.3f %8.2fx\n", bestByHandle / n, bestLookup / bestByHandle );
+    return EXIT_SUCCESS;
+}